@@ -0,0 +1,37 @@
+// Timing helpers shared by the demos and benchmarks, independent of any of the vectors
+
+#pragma once
+
+#include <chrono>
+
+
+namespace cpplab::bench
+{
+	using clock = std::chrono::steady_clock;
+
+	/* Milliseconds elapsed since start (taken with clock::now()). */
+	inline double ms_since(clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(clock::now() - start).count();
+	}
+
+	/* Runs the function a few times and returns the fastest run in nanoseconds. */
+	template <typename F>
+	double min_time_ns(F&& f, int repeats = 5)
+	{
+		double best = 0;
+
+		for (int r = 0; r < repeats; r++)
+		{
+			auto start = clock::now();
+			f();
+			auto stop = clock::now();
+
+			double ns = std::chrono::duration<double, std::nano>(stop - start).count();
+			if (r == 0 || ns < best)
+				best = ns;
+		}
+
+		return best;
+	}
+}
@@ -1,15 +1,34 @@
 #pragma once
 
 #include <iostream>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
 #include <vector>
 #include <type_traits>
+#include <new>
+
+#include "Zeroed_memory.h"
+#include "../Common/Bench_timer.h"
 
 
 namespace cpplab {
 
+	// A type is zero-fillable if an object whose bytes are all zero equals T() (0 for numbers, nullptr for pointers).
+	// Vectors of such types take their memory from cpplab::zeroed, which the system fills with zeros lazily,
+	// so new elements need no initialization. Other types can opt in by specializing this trait.
+	template <typename T>
+	struct is_zero_fillable : std::bool_constant<(std::is_arithmetic_v<T> || std::is_enum_v<T> || std::is_pointer_v<T>)
+		&& alignof(T) <= alignof(std::max_align_t)> {};
+
+	template <typename T>
+	inline constexpr bool is_zero_fillable_v = is_zero_fillable<T>::value;
+
 	template <typename T>
 	class vector
 	{
+		static constexpr bool lazy_zero = is_zero_fillable_v<T>;
+
 	public:
 		// Default constructor
 		vector() {}
@@ -18,23 +37,30 @@ namespace cpplab {
 		vector(std::initializer_list<T> list)
 			: _size(list.size()), _capacity(list.size())
 		{
-			data = new T[_capacity];
+			data = allocate(_capacity);
 
 			size_t idx = 0;
 			for (const T& elem : list)
 			{
-				data[idx++] = elem;
+				new (&data[idx++]) T(elem);
 			}
+			_dirty = _size;
 		}
 
 		vector(size_t size, T default_value)
 			: _size(size), _capacity(size)
 		{
-			data = new T[_capacity];
+			data = allocate(_capacity);
+			// The elements may be written even when they start as zeros, so all of them count as used
+			_dirty = _size;
+
+			// Zeros are already there, the pages are only touched when the elements are used
+			if (lazy_zero && is_zero(default_value))
+				return;
 
 			for (size_t i = 0; i < _size; i++)
 			{
-				data[i] = default_value;
+				new (&data[i]) T(default_value);
 			}
 		}
 
@@ -44,12 +70,13 @@ namespace cpplab {
 		{
 			std::cout << "Used my copy constructor\n";
 
-			data = new T[_capacity];
+			data = allocate(_capacity);
 
 			for (size_t i = 0; i < _size; i++)
 			{
-				data[i] = vec[i];
+				new (&data[i]) T(vec.data[i]);
 			}
+			_dirty = _size;
 		}
 
 		// Move constructor
@@ -59,14 +86,20 @@ namespace cpplab {
 
 			_size = vec._size;
 			_capacity = vec._capacity;
+			_dirty = vec._dirty;
 			data = vec.data;
 
 			vec._size = 0;
 			vec._capacity = 0;
+			vec._dirty = 0;
 			vec.data = nullptr;
 		}
 
-		~vector() { delete[] data; }
+		~vector()
+		{
+			destroy(0, _size);
+			deallocate(data, _capacity);
+		}
 
 
 		using value_type = T;
@@ -89,45 +122,58 @@ namespace cpplab {
 
 		void resize(size_t new_size)
 		{
-			if (new_size < _capacity)
+			if (new_size <= _size)
 			{
-				if (new_size <= _size)
-				{
-					_size = new_size;
-					return;
-				}
-
-				for (size_t i = _size; i < new_size; i++)
-				{
-					data[i] = 0;
-				}
+				destroy(new_size, _size);
 				_size = new_size;
 				return;
 			}
+
+			if (new_size > _capacity)
+				reserve(new_size);
+
+			if constexpr (lazy_zero)
+			{
+				// Slots from _dirty on still hold the zeros they were allocated with, only the ones used before are cleared
+				if (_dirty > _size)
+					std::memset(static_cast<void*>(data + _size), 0, (std::min(new_size, _dirty) - _size) * sizeof(T));
+				_dirty = std::max(_dirty, new_size);
+			}
 			else
 			{
-				reserve(new_size);
-				_size = new_size;
+				// Only the new elements are initialized (T() is 0 for numeric types)
+				for (size_t i = _size; i < new_size; i++)
+				{
+					new (&data[i]) T();
+				}
 			}
+			_size = new_size;
 		}
 
 		void reserve(size_t new_capacity)
 		{
 			if (new_capacity < _capacity) throw std::invalid_argument("Cannot reserve a smaller amount than already reserved");
 
-			T* tmp = new T[new_capacity];
+			if constexpr (lazy_zero)
+			{
+				// Grown in place when possible (mremap or realloc), the contents stay where they are and the new slots are zero
+				data = static_cast<T*>(zeroed::grow(data, _capacity * sizeof(T), new_capacity * sizeof(T)));
+				_capacity = new_capacity;
+				return;
+			}
+
+			// The slots past _size stay uninitialized until resize() or push_back() constructs something in them
+			T* tmp = allocate(new_capacity);
 
-			for (size_t i = 0; i < new_capacity; i++)
+			for (size_t i = 0; i < _size; i++)
 			{
-				if (i < _size)
-					tmp[i] = data[i];
-				else
-					tmp[i] = 0;
+				new (&tmp[i]) T(std::move(data[i]));
+				data[i].~T();
 			}
 
-			_capacity = new_capacity;
+			deallocate(data, _capacity);
 
-			delete[] data;
+			_capacity = new_capacity;
 			data = tmp;
 		}
 
@@ -142,23 +188,14 @@ namespace cpplab {
 		{
 			if (_size == _capacity)
 			{
-				if (empty())
-				{
-					resize(1);
-					data[0] = value;
-				}
-				else
-				{
-					reserve(2 * _size);
-					data[_size] = value;
-					_size++;
-				}
-			}
-			else
-			{
-				data[_size] = value;
-				_size++;
+				reserve(empty() ? 1 : 2 * _size);
 			}
+
+			new (&data[_size]) T(value);
+			_size++;
+
+			if constexpr (lazy_zero)
+				_dirty = std::max(_dirty, _size);
 		}
 
 		void append(T value) { push_back(value); }  // A push_back alias, because I prefer the name append :)
@@ -176,16 +213,19 @@ namespace cpplab {
 				return *this;
 			}
 
+			destroy(0, _size);
+			deallocate(data, _capacity);
+
 			_size = vec._size;
 			_capacity = vec._capacity;
 
-			delete[] data;
-			data = new T[_capacity];
+			data = allocate(_capacity);
 
 			for (size_t i = 0; i < _size; i++)
 			{
-				data[i] = vec[i];
+				new (&data[i]) T(vec.data[i]);
 			}
+			_dirty = _size;
 
 			return *this;
 		}
@@ -200,14 +240,18 @@ namespace cpplab {
 				return *this;
 			}
 
+			destroy(0, _size);
+			deallocate(data, _capacity);
+
 			_size = vec._size;
 			_capacity = vec._capacity;
+			_dirty = vec._dirty;
 
-			delete[] data;
 			data = vec.data;
 
 			vec._size = 0;
 			vec._capacity = 0;
+			vec._dirty = 0;
 			vec.data = nullptr;
 
 			return *this;
@@ -238,8 +282,43 @@ namespace cpplab {
 		}
 
 	private:
+		/* Allocates raw memory for n elements (nothing is constructed), respecting the alignment of T.
+		   For zero-fillable types the memory is zeros, provided lazily by the system. */
+		static T* allocate(size_t n)
+		{
+			if (n == 0) return nullptr;
+
+			if constexpr (lazy_zero)
+				return static_cast<T*>(zeroed::allocate(n * sizeof(T)));
+			else
+				return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(alignof(T))));
+		}
+
+		/* n is the capacity the memory was allocated (or grown) with. */
+		static void deallocate(T* ptr, size_t n)
+		{
+			if constexpr (lazy_zero)
+				zeroed::deallocate(ptr, n * sizeof(T));
+			else
+				::operator delete(ptr, std::align_val_t(alignof(T)));
+		}
+
+		static bool is_zero(const T& value)
+		{
+			const T zero{};
+			return std::memcmp(&value, &zero, sizeof(T)) == 0;
+		}
+
+		/* Calls destructors of elements in the range [from, to). */
+		void destroy(size_t from, size_t to)
+		{
+			for (size_t i = from; i < to; i++)
+				data[i].~T();
+		}
+
 		size_t _size = 0;
 		size_t _capacity = 0;
+		size_t _dirty = 0;  // Zero-fillable types only: the slots from here to the capacity have never been written
 		T* data = nullptr;
 	};
 
@@ -354,3 +433,45 @@ int main1_3()
 
 	return 0;
 }
+
+
+/// <summary>
+/// Grows a vector of doubles to 100 million elements: the memory comes from the system as untouched zero pages,
+/// so resize() returns at once and the cost is paid (page by page) by the first pass that writes the elements.
+/// </summary>
+int lazy_resize_demo()
+{
+	using clock = cpplab::bench::clock;
+	using cpplab::bench::ms_since;
+
+	const size_t count = 100'000'000;
+
+	cpplab::vector<double> values;
+	auto start = clock::now();
+	values.resize(count);
+	double resize_ms = ms_since(start);
+
+	start = clock::now();
+	cpplab::vector<double> filled(count, 0.0);
+	double construct_ms = ms_since(start);
+
+	start = clock::now();
+	for (size_t i = 0; i < count; i += 1000)
+		values[i] = 1.0;
+	double touch_ms = ms_since(start);
+
+	start = clock::now();
+	values.reserve(count + count / 2);
+	double grow_ms = ms_since(start);
+
+	double sum = 0;
+	for (size_t i = 0; i < count; i += 1000)
+		sum += values[i] + filled[i];
+
+	std::cout << "resize(" << count << ") " << resize_ms << " ms, vector(" << count << ", 0.0) " << construct_ms << " ms\n";
+	std::cout << "first write to every page " << touch_ms << " ms, reserve to 1.5x (remapped, nothing copied) " << grow_ms
+		<< " ms, sum " << sum << "\n";
+
+
+	return 0;
+}
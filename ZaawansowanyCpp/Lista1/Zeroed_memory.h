@@ -0,0 +1,121 @@
+// Zero-filled memory that the operating system hands out lazily: calloc for small blocks, anonymous mmap for large ones
+
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+// Also detected in Lista4/Mapped_file.h, whichever is included first defines it
+#ifndef CPPLAB_HAS_MMAP
+	#if defined(__unix__) || defined(__APPLE__)
+		#define CPPLAB_HAS_MMAP 1
+	#else
+		#define CPPLAB_HAS_MMAP 0
+	#endif
+#endif
+
+#if CPPLAB_HAS_MMAP
+	#include <sys/mman.h>
+#endif
+
+
+/*
+ * A fresh anonymous mapping is backed by the kernel's shared zero page until it is written, so a block of any size
+ * costs nothing until its pages are touched, and then only the touched pages are faulted in (already zeroed).
+ * calloc does the same for the large blocks it gets from mmap (and on Windows from VirtualAlloc), but it would have to
+ * memset blocks it recycles from its free lists, so small blocks come from calloc and large ones are mapped directly.
+ */
+namespace cpplab::zeroed
+{
+	constexpr size_t map_threshold = 1 << 20;      // Blocks of at least 1 MiB are mapped
+	constexpr size_t huge_page_size = 2 << 20;     // Mappings of at least one huge page ask for transparent huge pages
+
+	inline bool is_mapped(size_t bytes) { return CPPLAB_HAS_MMAP && bytes >= map_threshold; }
+
+	/* Returns bytes of zeros (nullptr for 0 bytes), aligned at least like std::max_align_t. */
+	inline void* allocate(size_t bytes)
+	{
+		if (bytes == 0)
+			return nullptr;
+
+#if CPPLAB_HAS_MMAP
+		if (is_mapped(bytes))
+		{
+			void* p = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (p == MAP_FAILED) throw std::bad_alloc();
+
+	#if defined(MADV_HUGEPAGE)
+			// Fewer page faults and TLB misses once the block is used, each first touch zeroes a 2 MiB page instead of 4 KiB
+			if (bytes >= huge_page_size)
+				::madvise(p, bytes, MADV_HUGEPAGE);
+	#endif
+			return p;
+		}
+#endif
+
+		void* p = std::calloc(bytes, 1);
+		if (!p) throw std::bad_alloc();
+		return p;
+	}
+
+	/* Frees a block from allocate() or grow(), bytes is the size it was requested with. */
+	inline void deallocate(void* p, size_t bytes)
+	{
+		if (!p)
+			return;
+
+#if CPPLAB_HAS_MMAP
+		if (is_mapped(bytes))
+		{
+			::munmap(p, bytes);
+			return;
+		}
+#endif
+
+		std::free(p);
+	}
+
+	/// <summary>
+	/// Grows a block to new_bytes, keeping its contents and returning the new bytes as zeros. A mapped block is grown
+	/// with mremap, which moves the page table entries instead of copying the pages, a small one with realloc, which
+	/// often extends it in place. On failure std::bad_alloc is thrown and the old block is left untouched.
+	/// </summary>
+	inline void* grow(void* p, size_t old_bytes, size_t new_bytes)
+	{
+		if (!p)
+			return allocate(new_bytes);
+		if (new_bytes <= old_bytes)
+			return p;
+
+#if CPPLAB_HAS_MMAP && defined(__linux__)
+		if (is_mapped(old_bytes))
+		{
+			void* q = ::mremap(p, old_bytes, new_bytes, MREMAP_MAYMOVE);
+			if (q == MAP_FAILED) throw std::bad_alloc();
+
+	#if defined(MADV_HUGEPAGE)
+			if (new_bytes >= huge_page_size)
+				::madvise(q, new_bytes, MADV_HUGEPAGE);
+	#endif
+			return q;
+		}
+#endif
+
+		if (!is_mapped(new_bytes))
+		{
+			void* q = std::realloc(p, new_bytes);
+			if (!q) throw std::bad_alloc();
+
+			std::memset(static_cast<char*>(q) + old_bytes, 0, new_bytes - old_bytes);
+			return q;
+		}
+
+		// The block moves from calloc to a mapping (or mremap is not available)
+		void* q = allocate(new_bytes);
+		std::memcpy(q, p, old_bytes);
+		deallocate(p, old_bytes);
+		return q;
+	}
+}
@@ -0,0 +1,91 @@
+// Accumulator policies for dot products. A policy decides in which type the products are summed and what is returned,
+// it is a template parameter, so every policy gets its own (SIMD) inner loop and there are no runtime branches.
+
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <utility>
+
+
+namespace cpplab::accumulate
+{
+	template <typename A, typename B>
+	using product_t = decltype(std::declval<A>() * std::declval<B>());
+
+	namespace detail
+	{
+		template <typename T>
+		struct wider { using type = T; };
+
+		template <> struct wider<int> { using type = std::int64_t; };
+		template <> struct wider<unsigned> { using type = std::uint64_t; };
+		template <> struct wider<float> { using type = double; };
+
+#if defined(__SIZEOF_INT128__)
+		template <> struct wider<long> { using type = std::conditional_t<sizeof(long) == 8, __int128, std::int64_t>; };
+		template <> struct wider<unsigned long> { using type = std::conditional_t<sizeof(unsigned long) == 8, unsigned __int128, std::uint64_t>; };
+		template <> struct wider<long long> { using type = __int128; };
+		template <> struct wider<unsigned long long> { using type = unsigned __int128; };
+#else
+		// No 128-bit integers (MSVC): 64-bit products are accumulated in 64 bits
+		template <> struct wider<long> { using type = std::int64_t; };
+		template <> struct wider<unsigned long> { using type = std::uint64_t; };
+#endif
+	}
+
+	/* Type with twice the bits of an integer product (int32 -> int64, int64 -> __int128), float -> double. */
+	template <typename T>
+	using wider_t = typename detail::wider<T>::type;
+
+	/// <summary>
+	/// Sums in the type of a[i] * b[i], as the plain loop does. The fastest policy, but vector<int> * vector<int>
+	/// overflows as soon as the sum does not fit into an int.
+	/// </summary>
+	struct natural
+	{
+		template <typename A, typename B> using accumulator = product_t<A, B>;
+		template <typename A, typename B> using result = product_t<A, B>;
+
+		template <typename A, typename B>
+		static result<A, B> finish(accumulator<A, B> acc) { return acc; }
+	};
+
+	/// <summary>
+	/// Sums and returns the result in a wider type: int32 in int64, int64 in __int128 and float in double.
+	/// The elements are converted before they are multiplied, so the products cannot overflow either.
+	/// </summary>
+	struct widen
+	{
+		template <typename A, typename B> using accumulator = wider_t<product_t<A, B>>;
+		template <typename A, typename B> using result = accumulator<A, B>;
+
+		template <typename A, typename B>
+		static result<A, B> finish(accumulator<A, B> acc) { return acc; }
+	};
+
+	/// <summary>
+	/// Sums in the wider type like widen, but returns the type of a[i] * b[i]: a result that does not fit is clamped
+	/// to the largest (or smallest) value of that type instead of wrapping around.
+	/// </summary>
+	struct saturate
+	{
+		template <typename A, typename B> using accumulator = wider_t<product_t<A, B>>;
+		template <typename A, typename B> using result = product_t<A, B>;
+
+		template <typename A, typename B>
+		static result<A, B> finish(accumulator<A, B> acc)
+		{
+			using R = result<A, B>;
+
+			if constexpr (!std::is_same_v<R, accumulator<A, B>>)
+			{
+				if (acc > static_cast<accumulator<A, B>>(std::numeric_limits<R>::max())) return std::numeric_limits<R>::max();
+				if (acc < static_cast<accumulator<A, B>>(std::numeric_limits<R>::lowest())) return std::numeric_limits<R>::lowest();
+			}
+
+			return static_cast<R>(acc);
+		}
+	};
+}
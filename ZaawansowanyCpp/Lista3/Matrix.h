@@ -0,0 +1,362 @@
+// Dense row-major matrix stored in one contiguous block, with cache-blocked, SIMD and multithreaded
+// matrix-vector (GEMV) and matrix-matrix (GEMM) products and batched dot products
+
+#pragma once
+
+#include <iostream>
+#include <algorithm>
+#include <initializer_list>
+#include <iterator>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "Zadanie3_1.h"
+#include "Parallel_reduce.h"
+
+
+namespace cpplab
+{
+	template <typename T>
+	class matrix
+	{
+		static_assert(std::is_arithmetic_v<T>, "matrix elements must be numbers");
+
+	  public:
+		using value_type = T;
+
+		// Default constructor
+		matrix() {}
+
+		matrix(size_t rows, size_t cols, T default_value = T())
+			: _rows(rows), _cols(cols), _data(rows * cols, default_value)
+		{}
+
+		// Initializer list constructor, every inner list is one row
+		matrix(std::initializer_list<std::initializer_list<T>> list)
+			: _rows(list.size()), _cols(list.size() > 0 ? list.begin()->size() : 0), _data(_rows * _cols, T())
+		{
+			T* out = _data.data();
+			for (const auto& row : list)
+			{
+				if (row.size() != _cols) throw std::invalid_argument("All rows of a matrix must have the same length");
+				out = std::copy(row.begin(), row.end(), out);
+			}
+		}
+
+		size_t rows() const { return _rows; }
+		size_t cols() const { return _cols; }
+		size_t size() const { return _rows * _cols; }
+
+		T* data() { return _data.data(); }
+		const T* data() const { return _data.data(); }
+
+		std::span<T> row(size_t r) { return { data() + r * _cols, _cols }; }
+		std::span<const T> row(size_t r) const { return { data() + r * _cols, _cols }; }
+
+		// Unchecked access (use at() for bounds checking)
+		T& operator()(size_t r, size_t c) { return data()[r * _cols + c]; }
+		T operator()(size_t r, size_t c) const { return data()[r * _cols + c]; }
+
+		T& at(size_t r, size_t c)
+		{
+			if (r >= _rows || c >= _cols) throw std::range_error("Provided index is out of bounds");
+			return (*this)(r, c);
+		}
+
+		T at(size_t r, size_t c) const
+		{
+			if (r >= _rows || c >= _cols) throw std::range_error("Provided index is out of bounds");
+			return (*this)(r, c);
+		}
+
+		/* Transposed copy, made in square tiles so that both the reads and the writes stay in cache. */
+		matrix transposed() const
+		{
+			constexpr size_t tile = 32;
+			matrix result(_cols, _rows);
+
+			for (size_t r0 = 0; r0 < _rows; r0 += tile)
+			{
+				for (size_t c0 = 0; c0 < _cols; c0 += tile)
+				{
+					for (size_t r = r0; r < std::min(r0 + tile, _rows); r++)
+					{
+						for (size_t c = c0; c < std::min(c0 + tile, _cols); c++)
+							result(c, r) = (*this)(r, c);
+					}
+				}
+			}
+
+			return result;
+		}
+
+		friend std::ostream& operator<<(std::ostream& out, const matrix& m)
+		{
+			out << "[";
+			for (size_t r = 0; r < m._rows; r++)
+			{
+				out << (r > 0 ? ",\n [" : "[");
+				for (size_t c = 0; c < m._cols; c++)
+					out << (c > 0 ? ", " : "") << m(r, c);
+				out << "]";
+			}
+			out << "]";
+
+			return out;
+		}
+
+	  private:
+		size_t _rows = 0;
+		size_t _cols = 0;
+		std::vector<T> _data;  // Not a cpplab::vector, which reports every copy and move
+	};
+
+	namespace detail
+	{
+		constexpr size_t gemv_block_bytes = 32 * 1024;  // Part of x that is reused by all rows before moving on, about the size of L1
+		constexpr size_t gemm_rows_block = 64;          // Rows of A handled by one task
+		constexpr size_t gemm_cols_block = 128;         // Columns of B whose (transposed) k-slice is kept in L2
+		constexpr size_t gemm_depth_block = 512;        // Length of the slices of A rows and B columns multiplied at once
+
+		/// <summary>
+		/// Adds dot(row_at(i) + k0, x + k0) over [k0, k1) to out[i - first] for rows i in [first, last).
+		/// Rows go in groups of four, so that every load of x is shared by four rows.
+		/// </summary>
+		template <typename Acc, typename A, typename B, typename RowAt>
+		void dot_rows(size_t first, size_t last, const RowAt& row_at, const B* x, size_t k0, size_t k1, Acc* out)
+		{
+			auto dot4 = [&](const A* const* rows, Acc* result)
+				{
+					if constexpr (simd::HasAccumulateKernel<Acc, A, B>)
+						simd::dot4_as<Acc>(rows, x + k0, k1 - k0, result);
+					else
+						simd::dot4_scalar<Acc>(rows, x + k0, k1 - k0, result);
+				};
+
+			size_t i = first;
+			for (; i + 4 <= last; i += 4)
+			{
+				const A* rows[4] = { row_at(i) + k0, row_at(i + 1) + k0, row_at(i + 2) + k0, row_at(i + 3) + k0 };
+				dot4(rows, out + (i - first));
+			}
+
+			if (i < last)
+			{
+				// Leftover rows are padded with copies of the last one, whose results are thrown away
+				const A* rows[4];
+				Acc padded[4] = { Acc(), Acc(), Acc(), Acc() };
+				for (size_t r = 0; r < 4; r++)
+				{
+					rows[r] = row_at(std::min(i + r, last - 1)) + k0;
+					padded[r] = i + r < last ? out[i + r - first] : Acc();
+				}
+
+				dot4(rows, padded);
+				for (size_t r = 0; i + r < last; r++)
+					out[i + r - first] = padded[r];
+			}
+		}
+
+		/// <summary>out[i] = dot(row_at(i), x) for every i in [0, count), with x split into blocks that stay in cache
+		/// and the rows split between the threads of the pool when there is enough work.</summary>
+		template <typename Acc, typename A, typename B, typename RowAt>
+		void dot_many(size_t count, const RowAt& row_at, const B* x, size_t n, Acc* out, thread_pool& pool)
+		{
+			size_t block = std::max<size_t>(gemv_block_bytes / sizeof(B), 64);
+
+			auto run = [&](size_t first, size_t last)
+				{
+					std::fill(out + first, out + last, Acc());
+					for (size_t k0 = 0; k0 < n; k0 += block)
+						dot_rows<Acc, A>(first, last, row_at, x, k0, std::min(n, k0 + block), out + first);
+				};
+
+			if (count * n < parallel_threshold || count < 8)
+			{
+				run(0, count);
+				return;
+			}
+
+			// A few tasks per thread, each a multiple of four rows
+			size_t per_task = (count + 4 * (pool.size() + 1) - 1) / (4 * (pool.size() + 1));
+			per_task = std::max<size_t>(4, (per_task + 3) / 4 * 4);
+			size_t tasks = (count + per_task - 1) / per_task;
+
+			pool.parallel_for(tasks, [&](size_t t)
+				{
+					run(t * per_task, std::min(count, (t + 1) * per_task));
+				});
+		}
+
+		/* Turns the accumulators into the results of the policy. */
+		template <typename Policy, typename A, typename B, typename Acc>
+		auto finish_all(const Acc* acc, size_t count)
+		{
+			using Result = typename Policy::template result<A, B>;
+
+			vector<Result> result(count, Result());
+			Result* out = result.data();
+			for (size_t i = 0; i < count; i++)
+				out[i] = Policy::template finish<A, B>(acc[i]);
+
+			return result;
+		}
+	}
+
+	/// <summary>Matrix-vector product y = a * x. Returns a cpplab::vector with a.rows() elements.</summary>
+	/// <typeparam name="Policy">Accumulator policy, see Accumulators.h</typeparam>
+	template <typename Policy = accumulate::natural, typename T, IsVector V>
+	auto gemv(const matrix<T>& a, const V& x, thread_pool& pool = thread_pool::shared())
+	{
+		if (a.cols() != x.size()) throw std::runtime_error("Matrix columns and vector size must be equal");
+
+		using B = typename V::value_type;
+		using Acc = typename Policy::template accumulator<T, B>;
+
+		auto product = [&](const auto* xs)
+			{
+				std::vector<Acc> acc(a.rows());
+				auto row_at = [&](size_t r) { return a.data() + r * a.cols(); };
+				detail::dot_many<Acc, T>(a.rows(), row_at, xs, x.size(), acc.data(), pool);
+
+				return detail::finish_all<Policy, T, B>(acc.data(), acc.size());
+			};
+
+		if constexpr (IsContiguousVector<V>)
+		{
+			return product(x.data());
+		}
+		else
+		{
+			// Expressions and other vectors without data() are evaluated once into a plain buffer (bits of a vector<bool> as Acc)
+			using Element = std::conditional_t<std::is_same_v<B, bool>, Acc, B>;
+			std::vector<Element> buffer(x.size());
+			for (size_t i = 0; i < buffer.size(); i++)
+				buffer[i] = static_cast<Element>(x[i]);
+
+			return product(buffer.data());
+		}
+	}
+
+	/// <summary>
+	/// Dot products of x with every vector of rows (e.g. a std::vector of cpplab::vector), computed together
+	/// like the rows of a matrix. Returns a cpplab::vector with one result per row.
+	/// </summary>
+	template <typename Policy = accumulate::natural, std::ranges::random_access_range Rows, IsContiguousVector V>
+		requires IsContiguousVector<std::ranges::range_value_t<Rows>>
+	auto batched_dot(const Rows& rows, const V& x, thread_pool& pool = thread_pool::shared())
+	{
+		using A = typename std::ranges::range_value_t<Rows>::value_type;
+		using B = typename V::value_type;
+		using Acc = typename Policy::template accumulator<A, B>;
+
+		auto first = std::ranges::begin(rows);
+		size_t count = std::ranges::size(rows);
+		for (size_t i = 0; i < count; i++)
+		{
+			if (first[i].size() != x.size()) throw std::runtime_error("Vectors must be the same size");
+		}
+
+		std::vector<Acc> acc(count);
+		auto row_at = [&](size_t r) { return first[r].data(); };
+		detail::dot_many<Acc, A>(count, row_at, x.data(), x.size(), acc.data(), pool);
+
+		return detail::finish_all<Policy, A, B>(acc.data(), acc.size());
+	}
+
+	/// <summary>
+	/// Matrix product a * b. b is transposed first, so every element of the result is a dot product of two contiguous rows.
+	/// The rows of a are split between threads, the columns of b and the common dimension into blocks that stay in cache.
+	/// </summary>
+	template <typename Policy = accumulate::natural, typename T, typename U>
+	auto gemm(const matrix<T>& a, const matrix<U>& b, thread_pool& pool = thread_pool::shared())
+	{
+		if (a.cols() != b.rows()) throw std::runtime_error("Matrix dimensions do not match");
+
+		using Acc = typename Policy::template accumulator<T, U>;
+		using Result = typename Policy::template result<T, U>;
+
+		const size_t m = a.rows(), n = b.cols(), depth = a.cols();
+		const matrix<U> bt = b.transposed();
+		std::vector<Acc> acc(m * n);
+
+		auto row_at = [&](size_t r) { return a.data() + r * depth; };
+		auto run = [&](size_t i0, size_t i1)
+			{
+				std::vector<Acc> column(i1 - i0);
+
+				for (size_t j0 = 0; j0 < n; j0 += detail::gemm_cols_block)
+				{
+					for (size_t k0 = 0; k0 < depth; k0 += detail::gemm_depth_block)
+					{
+						size_t k1 = std::min(depth, k0 + detail::gemm_depth_block);
+
+						for (size_t j = j0; j < std::min(n, j0 + detail::gemm_cols_block); j++)
+						{
+							// Column j of the result for rows [i0, i1), one slice of the common dimension at a time
+							for (size_t i = i0; i < i1; i++)
+								column[i - i0] = acc[i * n + j];
+
+							detail::dot_rows<Acc, T>(i0, i1, row_at, bt.data() + j * depth, k0, k1, column.data());
+
+							for (size_t i = i0; i < i1; i++)
+								acc[i * n + j] = column[i - i0];
+						}
+					}
+				}
+			};
+
+		size_t tasks = (m + detail::gemm_rows_block - 1) / detail::gemm_rows_block;
+		if (m * n * depth < parallel_threshold || tasks < 2)
+		{
+			run(0, m);
+		}
+		else
+		{
+			pool.parallel_for(tasks, [&](size_t t)
+				{
+					run(t * detail::gemm_rows_block, std::min(m, (t + 1) * detail::gemm_rows_block));
+				});
+		}
+
+		matrix<Result> result(m, n);
+		for (size_t i = 0; i < m * n; i++)
+			result.data()[i] = Policy::template finish<T, U>(acc[i]);
+
+		return result;
+	}
+
+	template <typename T, IsVector V>
+	auto operator*(const matrix<T>& a, const V& x)
+	{
+		return gemv(a, x);
+	}
+
+	template <typename T, typename U>
+	auto operator*(const matrix<T>& a, const matrix<U>& b)
+	{
+		return gemm(a, b);
+	}
+}
+
+
+int matrix_demo()
+{
+	cpplab::matrix<double> a = { { 1, 2, 3 }, { 4, 5, 6 } };
+	cpplab::matrix<int> b = { { 1, 0 }, { 0, 1 }, { 2, 2 } };
+	cpplab::vector<int> x = { 1, 1, 1 };
+
+	std::cout << "a =\n" << a << "\n";
+	std::cout << "a * x = " << a * x << "\n";
+	std::cout << "a * b =\n" << a * b << "\n";
+
+	std::vector<cpplab::vector<float>> rows = { { 1, 0, 0 }, { 0, 2, 0 }, { 1, 1, 1 } };
+	cpplab::vector<float> y = { 3, 4, 5 };
+	std::cout << "batched_dot(rows, y) = " << cpplab::batched_dot(rows, y) << "\n";
+
+
+	return 0;
+}
@@ -0,0 +1,135 @@
+// Multithreaded dot product and sum for large IsVector inputs, with pairwise summation and a fixed reduction order
+
+#pragma once
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <stdexcept>
+
+#include "Zadanie3_1.h"
+#include "Thread_pool.h"
+
+
+namespace cpplab
+{
+	constexpr size_t parallel_threshold = 1 << 18;  // Inputs shorter than this are reduced on the calling thread
+	constexpr size_t reduction_chunk = 1 << 15;     // Work unit of a parallel reduction, it does not depend on the number of threads
+	constexpr size_t pairwise_block = 256;          // Blocks this short are summed directly
+
+	namespace detail
+	{
+		/// <summary>
+		/// Pairwise summation over [first, last): the range is halved until the pieces are short enough for block_sum(first, last).
+		/// The rounding error grows with log(n) instead of n as in a plain loop.
+		/// </summary>
+		template <typename R, typename BlockSum>
+		R pairwise_sum(size_t first, size_t last, const BlockSum& block_sum)
+		{
+			if (last - first <= pairwise_block)
+				return block_sum(first, last);
+
+			size_t mid = first + (last - first) / 2;
+			return pairwise_sum<R>(first, mid, block_sum) + pairwise_sum<R>(mid, last, block_sum);
+		}
+
+		/// <summary>
+		/// Splits [0, n) into chunks of a fixed size, sums every chunk pairwise (in parallel) and then sums the partial results pairwise.
+		/// Neither the chunk boundaries nor the order of the final additions depend on scheduling, so the result is reproducible.
+		/// </summary>
+		template <typename R, typename BlockSum>
+		R chunked_reduce(size_t n, const BlockSum& block_sum, thread_pool& pool)
+		{
+			if (n < parallel_threshold)
+				return pairwise_sum<R>(0, n, block_sum);
+
+			size_t chunks = (n + reduction_chunk - 1) / reduction_chunk;
+			std::vector<R> partial(chunks);
+
+			pool.parallel_for(chunks, [&](size_t c)
+				{
+					size_t first = c * reduction_chunk;
+					size_t last = std::min(n, first + reduction_chunk);
+					partial[c] = pairwise_sum<R>(first, last, block_sum);
+				});
+
+			return pairwise_sum<R>(0, chunks, [&](size_t first, size_t last)
+				{
+					R result = R();
+					for (size_t i = first; i < last; i++)
+						result += partial[i];
+					return result;
+				});
+		}
+	}
+
+	/// <summary>Dot product for long vectors, split across the threads of the pool.</summary>
+	/// <returns>Same type as dot&lt;Policy&gt;() (by default the type of v[i] * u[i], like operator*)</returns>
+	template <typename Policy = accumulate::natural, IsVector V, IsVector U>
+	auto parallel_dot(const V& v, const U& u, thread_pool& pool = thread_pool::shared())
+	{
+		if (v.size() != u.size()) throw std::runtime_error("Vectors must be the same size");
+
+		using A = typename V::value_type;
+		using B = typename U::value_type;
+		using Accumulator = typename Policy::template accumulator<A, B>;
+
+		auto block_sum = [&](size_t first, size_t last)
+			{
+				if constexpr (IsContiguousVector<V> && IsContiguousVector<U> && simd::HasAccumulateKernel<Accumulator, A, B>)
+				{
+					return simd::dot_as<Accumulator>(v.data() + first, u.data() + first, last - first);
+				}
+				else
+				{
+					Accumulator result = Accumulator();
+					for (size_t i = first; i < last; i++)
+						result += static_cast<Accumulator>(v[i]) * static_cast<Accumulator>(u[i]);
+					return result;
+				}
+			};
+
+		return Policy::template finish<A, B>(detail::chunked_reduce<Accumulator>(v.size(), block_sum, pool));
+	}
+
+	/// <summary>Sum of all elements for long vectors, split across the threads of the pool.</summary>
+	template <IsVector V>
+	auto parallel_sum(const V& v, thread_pool& pool = thread_pool::shared())
+	{
+		using ResultType = decltype(std::declval<typename V::value_type>() + std::declval<typename V::value_type>());
+
+		auto block_sum = [&](size_t first, size_t last)
+			{
+				ResultType result = ResultType();
+				for (size_t i = first; i < last; i++)
+					result += v[i];
+				return result;
+			};
+
+		return detail::chunked_reduce<ResultType>(v.size(), block_sum, pool);
+	}
+}
+
+
+int parallel_reduce_demo()
+{
+	using cpplab::operator*;
+
+	const size_t n = 20'000'000;
+	std::vector<float> values(n, 0.1f);
+	std::vector<float> ones(n, 1.0f);
+
+	float naive = 0;
+	for (float x : values)
+		naive += x;
+
+	std::cout << std::setprecision(10);
+	std::cout << "Sum of " << n << " times 0.1f (exact: " << n * 0.1 << ")\n";
+	std::cout << "naive loop:    " << naive << "\n";
+	std::cout << "parallel_sum:  " << cpplab::parallel_sum(values) << "\n";
+	std::cout << "parallel_dot:  " << cpplab::parallel_dot(values, ones) << "\n";
+	std::cout << "operator*:     " << values * ones << "\n";
+
+
+	return 0;
+}
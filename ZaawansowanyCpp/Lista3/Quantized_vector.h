@@ -0,0 +1,222 @@
+// Vectors of floats kept in a compressed form: int8 with one scale per vector (4x less memory than float),
+// or IEEE half precision / bfloat16 (2x less). The dot product of two vectors of the same kind is computed
+// on the compressed data (see Simd_quantized.h), without decompressing the vectors first.
+
+#pragma once
+
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <initializer_list>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "Zadanie3_1.h"
+#include "Simd_quantized.h"
+#include "../Common/Bench_timer.h"
+
+
+namespace cpplab
+{
+	enum class quantization { int8, fp16, bf16 };
+
+	/// <summary>
+	/// Approximate copy of a vector of floats. Reading an element decodes it, so it satisfies IsVector (with value_type float)
+	/// and works everywhere a cpplab::vector does, only the dot product with the same kind of vector has its own kernels.
+	/// </summary>
+	template <quantization Q>
+	class quantized_vector
+	{
+	  public:
+		using value_type = float;
+		using storage_type = std::conditional_t<Q == quantization::int8, std::int8_t, std::uint16_t>;
+
+		// Default constructor
+		quantized_vector() {}
+
+		// Initializer list constructor
+		quantized_vector(std::initializer_list<float> list)
+			: quantized_vector(std::vector<float>(list))
+		{}
+
+		/* Compressed copy of any vector. int8 maps the largest absolute value to 127 and rounds everything else to the nearest step. */
+		template <typename V> requires (!std::is_same_v<V, quantized_vector<Q>>) && IsVector<V>
+		explicit quantized_vector(const V& vec)
+			: _codes(vec.size())
+		{
+			if constexpr (Q == quantization::int8)
+			{
+				float max_abs = 0;
+				for (size_t i = 0; i < vec.size(); i++)
+					max_abs = std::max(max_abs, std::abs(static_cast<float>(vec[i])));
+
+				_scale = max_abs > 0 ? max_abs / 127 : 1.0f;
+				for (size_t i = 0; i < vec.size(); i++)
+					_codes[i] = static_cast<std::int8_t>(std::lround(std::clamp(static_cast<float>(vec[i]) / _scale, -127.0f, 127.0f)));
+			}
+			else if constexpr (Q == quantization::fp16)
+			{
+				for (size_t i = 0; i < vec.size(); i++)
+					_codes[i] = simd::float_to_half(static_cast<float>(vec[i]));
+			}
+			else
+			{
+				for (size_t i = 0; i < vec.size(); i++)
+					_codes[i] = simd::float_to_bf16(static_cast<float>(vec[i]));
+			}
+		}
+
+
+		size_t size() const { return _codes.size(); }
+		bool empty() const { return _codes.empty(); }
+
+		/* Memory taken by the elements. */
+		size_t bytes() const { return _codes.size() * sizeof(storage_type); }
+
+		/* Value of one step of the int8 codes (always 1 for fp16 and bf16). */
+		float scale() const { return _scale; }
+
+		/* The compressed elements. */
+		const storage_type* codes() const { return _codes.data(); }
+
+		float operator[](size_t idx) const { return decode(_codes[idx]); }
+
+		float at(size_t idx) const
+		{
+			if (idx >= _codes.size()) throw std::range_error("Provided index is out of bounds");
+			return decode(_codes[idx]);
+		}
+
+		/* Decompressed copy of the vector. */
+		vector<float> to_dense() const
+		{
+			vector<float> result(size(), 0.0f);
+			float* out = result.data();
+			for (size_t i = 0; i < size(); i++)
+				out[i] = decode(_codes[i]);
+
+			return result;
+		}
+
+		friend std::ostream& operator<<(std::ostream& out, const quantized_vector& vec)
+		{
+			out << "[";
+			for (size_t i = 0; i < vec.size(); i++)
+				out << (i > 0 ? ", " : "") << vec[i];
+			out << "]";
+
+			return out;
+		}
+
+	  private:
+		float decode(storage_type code) const
+		{
+			if constexpr (Q == quantization::int8)
+				return code * _scale;
+			else if constexpr (Q == quantization::fp16)
+				return simd::half_to_float(code);
+			else
+				return simd::bf16_to_float(code);
+		}
+
+		std::vector<storage_type> _codes;
+		float _scale = 1.0f;
+	};
+
+	using int8_vector = quantized_vector<quantization::int8>;
+	using fp16_vector = quantized_vector<quantization::fp16>;
+	using bf16_vector = quantized_vector<quantization::bf16>;
+
+	/// <summary>
+	/// Dot product of two compressed vectors of the same kind, computed on the compressed elements.
+	/// int8 codes are multiplied and summed exactly in integers and scaled once at the end, in the accumulator type of the policy.
+	/// fp16 and bf16 are summed in float by the SIMD kernels; with widen or saturate they are summed in double instead
+	/// (the product of two 16-bit floats is exact in float, so only the sum needs the wider type).
+	/// </summary>
+	/// <returns>float, or double with accumulate::widen</returns>
+	template <typename Policy = accumulate::natural, quantization Q>
+	auto dot(const quantized_vector<Q>& a, const quantized_vector<Q>& b)
+	{
+		if (a.size() != b.size()) throw std::runtime_error("Vectors must be the same size");
+
+		using Acc = typename Policy::template accumulator<float, float>;
+		Acc acc = Acc();
+
+		if constexpr (Q == quantization::int8)
+		{
+			acc = static_cast<Acc>(static_cast<double>(simd::dot_i8(a.codes(), b.codes(), a.size())) * a.scale() * b.scale());
+		}
+		else if constexpr (std::is_same_v<Acc, float>)
+		{
+			if constexpr (Q == quantization::fp16)
+				acc = simd::dot_f16(a.codes(), b.codes(), a.size());
+			else
+				acc = simd::dot_bf16(a.codes(), b.codes(), a.size());
+		}
+		else
+		{
+			for (size_t i = 0; i < a.size(); i++)
+				acc += static_cast<Acc>(a[i] * b[i]);
+		}
+
+		return Policy::template finish<float, float>(acc);
+	}
+}
+
+
+int quantized_vector_demo()
+{
+	using cpplab::operator*;
+
+	const size_t count = 10'000, dimensions = 512;
+	std::mt19937 generator(2024);
+	std::normal_distribution<float> normal(0.0f, 1.0f);
+
+	std::vector<std::vector<float>> embeddings(count, std::vector<float>(dimensions));
+	for (auto& embedding : embeddings)
+		std::generate(embedding.begin(), embedding.end(), [&]() { return normal(generator); });
+	const std::vector<float>& query = embeddings[0];
+
+	// Scores the query against the whole collection, prints the time, the memory and the largest error of a score
+	auto scan = [&](const char* name, const auto& collection, const auto& q, size_t bytes)
+		{
+			std::vector<float> scores(count);
+			auto start = cpplab::bench::clock::now();
+			for (size_t i = 0; i < count; i++)
+				scores[i] = q * collection[i];
+			double ms = cpplab::bench::ms_since(start);
+
+			float max_error = 0;
+			for (size_t i = 0; i < count; i++)
+				max_error = std::max(max_error, std::abs(scores[i] - query * embeddings[i]));
+
+			std::cout << name << ": " << bytes / 1024 << " KiB, " << ms << " ms, largest error " << max_error << "\n";
+		};
+
+	auto compress = [&](auto kind)
+		{
+			using Vector = decltype(kind);
+			std::vector<Vector> collection;
+			for (const auto& embedding : embeddings)
+				collection.emplace_back(embedding);
+			return collection;
+		};
+
+	auto int8s = compress(cpplab::int8_vector());
+	auto fp16s = compress(cpplab::fp16_vector());
+	auto bf16s = compress(cpplab::bf16_vector());
+
+	std::cout << "Scoring " << count << " vectors of " << dimensions << " elements (SIMD: " << cpplab::simd::level_name(cpplab::simd::active_level()) << ")\n";
+	scan("float", embeddings, query, count * dimensions * sizeof(float));
+	scan("int8 ", int8s, int8s[0], count * int8s[0].bytes());
+	scan("fp16 ", fp16s, fp16s[0], count * fp16s[0].bytes());
+	scan("bf16 ", bf16s, bf16s[0], count * bf16s[0].bytes());
+
+	std::cout << "int8 query * query: " << int8s[0] * int8s[0] << " (natural), " << cpplab::dot<cpplab::accumulate::widen>(int8s[0], int8s[0])
+		<< " (widen), float " << query * query << "\n";
+
+
+	return 0;
+}
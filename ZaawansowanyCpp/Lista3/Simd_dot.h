@@ -0,0 +1,943 @@
+// Dot product kernels for contiguous arrays of float, double, int32 and int64 (and mixed pairs of them),
+// written with SSE4.2, AVX2 and AVX-512 intrinsics and picked at runtime depending on what the CPU supports
+
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+	#define CPPLAB_SIMD_X86 1
+	#include <immintrin.h>
+	#if defined(_MSC_VER) && !defined(__clang__)
+		#include <intrin.h>
+	#endif
+#else
+	#define CPPLAB_SIMD_X86 0
+#endif
+
+// GCC and Clang only let a function use intrinsics of the instruction sets it was compiled for,
+// so every kernel is marked with its target. MSVC allows all intrinsics everywhere.
+#if defined(__GNUC__) || defined(__clang__)
+	#define CPPLAB_TARGET_SSE42 __attribute__((target("sse4.2,popcnt")))
+	#define CPPLAB_TARGET_AVX2 __attribute__((target("avx2,fma,f16c")))
+	#define CPPLAB_TARGET_AVX512 __attribute__((target("avx512f,avx512dq,avx512bw,avx512vl,avx2,fma,f16c")))
+#else
+	#define CPPLAB_TARGET_SSE42
+	#define CPPLAB_TARGET_AVX2
+	#define CPPLAB_TARGET_AVX512
+#endif
+
+
+namespace cpplab::simd
+{
+	enum class level { scalar, sse42, avx2, avx512 };
+
+	inline const char* level_name(level l)
+	{
+		switch (l)
+		{
+			case level::sse42: return "SSE4.2";
+			case level::avx2: return "AVX2";
+			case level::avx512: return "AVX-512";
+			default: return "scalar";
+		}
+	}
+
+	/* Best instruction set supported by the CPU (and the operating system, which must save the wide registers). */
+	inline level detect_level()
+	{
+#if CPPLAB_SIMD_X86
+	#if defined(_MSC_VER) && !defined(__clang__)
+		int info[4];
+		__cpuid(info, 0);
+		int max_leaf = info[0];
+
+		__cpuid(info, 1);
+		bool sse42 = (info[2] >> 20) & 1;
+		bool fma = (info[2] >> 12) & 1;
+		bool f16c = (info[2] >> 29) & 1;
+		bool osxsave = (info[2] >> 27) & 1;
+		unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+		bool os_avx = (xcr0 & 0x6) == 0x6;
+		bool os_avx512 = (xcr0 & 0xe6) == 0xe6;
+
+		bool avx2 = false, avx512 = false;
+		if (max_leaf >= 7)
+		{
+			__cpuidex(info, 7, 0);
+			avx2 = (info[1] >> 5) & 1;
+			// F, DQ, BW and VL
+			avx512 = ((info[1] >> 16) & 1) && ((info[1] >> 17) & 1) && ((info[1] >> 30) & 1) && ((info[1] >> 31) & 1);
+		}
+
+		if (avx512 && avx2 && fma && f16c && os_avx512) return level::avx512;
+		if (avx2 && fma && f16c && os_avx) return level::avx2;
+		if (sse42) return level::sse42;
+	#else
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq") && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vl")
+			&& __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") && __builtin_cpu_supports("f16c"))
+			return level::avx512;
+		if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") && __builtin_cpu_supports("f16c"))
+			return level::avx2;
+		if (__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt"))
+			return level::sse42;
+	#endif
+#endif
+		return level::scalar;
+	}
+
+	namespace detail
+	{
+		inline level& active_level_ref()
+		{
+			static level active = detect_level();
+			return active;
+		}
+	}
+
+	/* Instruction set used by the kernels. Detected once, can be lowered with force_level() (e.g. for benchmarks). */
+	inline level active_level() { return detail::active_level_ref(); }
+
+	/* Makes the kernels use the given instruction set, but never one the CPU does not support. */
+	inline void force_level(level l)
+	{
+		level detected = detect_level();
+		detail::active_level_ref() = static_cast<int>(l) <= static_cast<int>(detected) ? l : detected;
+	}
+
+	// Element types the kernels can read
+	template <typename T>
+	concept KernelElement = std::is_same_v<T, float> || std::is_same_v<T, double> || std::is_same_v<T, std::int32_t> || std::is_same_v<T, std::int64_t>;
+
+	// Element types the kernels can convert to the accumulator type R while loading: int32 and float go up to
+	// any wider floating type, int32 is sign-extended to int64
+	template <typename R, typename A>
+	concept LoadsInto = KernelElement<R> && KernelElement<A> &&
+		(std::is_same_v<R, A> ||
+		 (std::is_floating_point_v<R> && std::is_same_v<A, std::int32_t>) ||
+		 (std::is_same_v<R, double> && std::is_same_v<A, float>) ||
+		 (std::is_same_v<R, std::int64_t> && std::is_same_v<A, std::int32_t>));
+
+	// Accumulator types with a SIMD kernel for elements of types A and B
+	template <typename R, typename A, typename B>
+	concept HasAccumulateKernel = LoadsInto<R, A> && LoadsInto<R, B>;
+
+	// Pairs of element types with a SIMD kernel that accumulates in the type of a[i] * b[i]
+	template <typename A, typename B>
+	concept HasDotKernel = KernelElement<A> && KernelElement<B> && HasAccumulateKernel<decltype(std::declval<A>() * std::declval<B>()), A, B>;
+
+	/* Plain loop with several independent accumulators, used when no SIMD instruction set is available. */
+	template <typename R, typename A, typename B>
+	R dot_scalar(const A* a, const B* b, size_t n)
+	{
+		R acc[4] = { R(), R(), R(), R() };
+		size_t i = 0;
+
+		// Elements are converted before multiplying, so a wider R also protects the products from overflow
+		for (; i + 4 <= n; i += 4)
+		{
+			acc[0] += static_cast<R>(a[i]) * static_cast<R>(b[i]);
+			acc[1] += static_cast<R>(a[i + 1]) * static_cast<R>(b[i + 1]);
+			acc[2] += static_cast<R>(a[i + 2]) * static_cast<R>(b[i + 2]);
+			acc[3] += static_cast<R>(a[i + 3]) * static_cast<R>(b[i + 3]);
+		}
+
+		// The tail counts the n - i remaining elements, so the compiler knows it is shorter than four
+		R result = (acc[0] + acc[1]) + (acc[2] + acc[3]);
+		for (size_t k = 0, rest = n - i; k < rest; k++)
+			result += static_cast<R>(a[i + k]) * static_cast<R>(b[i + k]);
+
+		return result;
+	}
+
+	/* Dot products of four rows with the same vector x, added to out[0..3] (plain loop, works for any arithmetic types). */
+	template <typename R, typename A, typename B>
+	void dot4_scalar(const A* const* rows, const B* x, size_t n, R* out)
+	{
+		R result[4] = { R(), R(), R(), R() };
+
+		for (size_t i = 0; i < n; i++)
+		{
+			R xi = static_cast<R>(x[i]);
+			result[0] += static_cast<R>(rows[0][i]) * xi;
+			result[1] += static_cast<R>(rows[1][i]) * xi;
+			result[2] += static_cast<R>(rows[2][i]) * xi;
+			result[3] += static_cast<R>(rows[3][i]) * xi;
+		}
+
+		for (size_t r = 0; r < 4; r++)
+			out[r] += result[r];
+	}
+
+	/* Sum of values[k] * dense[indices[k]] for k in [0, n) (plain loop, works for any arithmetic types). */
+	template <typename R, typename A, typename B>
+	R dot_gather_scalar(const A* values, const std::uint32_t* indices, const B* dense, size_t n)
+	{
+		R acc[4] = { R(), R(), R(), R() };
+		size_t k = 0;
+
+		for (; k + 4 <= n; k += 4)
+		{
+			acc[0] += static_cast<R>(values[k]) * static_cast<R>(dense[indices[k]]);
+			acc[1] += static_cast<R>(values[k + 1]) * static_cast<R>(dense[indices[k + 1]]);
+			acc[2] += static_cast<R>(values[k + 2]) * static_cast<R>(dense[indices[k + 2]]);
+			acc[3] += static_cast<R>(values[k + 3]) * static_cast<R>(dense[indices[k + 3]]);
+		}
+
+		R result = (acc[0] + acc[1]) + (acc[2] + acc[3]);
+		for (; k < n; k++)
+			result += static_cast<R>(values[k]) * static_cast<R>(dense[indices[k]]);
+
+		return result;
+	}
+
+	/* Sum of the values whose bits are set in mask, visiting only the set bits (plain loop, works for any arithmetic types). */
+	template <typename R, typename B>
+	R masked_sum_scalar(const std::uint64_t* mask, const B* values, size_t n)
+	{
+		R result = R();
+
+		for (size_t w = 0; w * 64 < n; w++)
+		{
+			std::uint64_t bits = mask[w];
+			// Bits past n in the last word have no value
+			if (n - w * 64 < 64)
+				bits &= (std::uint64_t(1) << (n % 64)) - 1;
+
+			for (; bits != 0; bits &= bits - 1)
+				result += static_cast<R>(values[w * 64 + std::countr_zero(bits)]);
+		}
+
+		return result;
+	}
+
+#if CPPLAB_SIMD_X86
+	// Every instruction set provides ops<R> with a register type for accumulating R values and the operations
+	// the kernel needs: load (converting the element type to R), multiply-add, add, select (zeroes the lanes
+	// whose bit in a mask is clear) and horizontal sum.
+
+	namespace sse42
+	{
+		// Lane i is all ones when bit i of bits is set, zero otherwise (used by select)
+		CPPLAB_TARGET_SSE42 inline __m128i lanes32(std::uint64_t bits)
+		{
+			const __m128i lane_bits = _mm_setr_epi32(1, 2, 4, 8);
+			return _mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(static_cast<int>(bits)), lane_bits), lane_bits);
+		}
+
+		CPPLAB_TARGET_SSE42 inline __m128i lanes64(std::uint64_t bits)
+		{
+			const __m128i lane_bits = _mm_set_epi64x(2, 1);
+			return _mm_cmpeq_epi64(_mm_and_si128(_mm_set1_epi64x(static_cast<long long>(bits)), lane_bits), lane_bits);
+		}
+
+		template <typename R> struct ops;
+
+		template <> struct ops<float>
+		{
+			using reg = __m128;
+			static constexpr size_t width = 4;
+			CPPLAB_TARGET_SSE42 static reg zero() { return _mm_setzero_ps(); }
+			CPPLAB_TARGET_SSE42 static reg load(const float* p) { return _mm_loadu_ps(p); }
+			CPPLAB_TARGET_SSE42 static reg load(const std::int32_t* p) { return _mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))); }
+			CPPLAB_TARGET_SSE42 static reg madd(reg acc, reg a, reg b) { return _mm_add_ps(acc, _mm_mul_ps(a, b)); }
+			CPPLAB_TARGET_SSE42 static reg add(reg a, reg b) { return _mm_add_ps(a, b); }
+			CPPLAB_TARGET_SSE42 static reg select(std::uint64_t bits, reg v) { return _mm_and_ps(v, _mm_castsi128_ps(lanes32(bits))); }
+			CPPLAB_TARGET_SSE42 static float sum(reg v)
+			{
+				__m128 shuf = _mm_movehdup_ps(v);
+				__m128 sums = _mm_add_ps(v, shuf);
+				return _mm_cvtss_f32(_mm_add_ss(sums, _mm_movehl_ps(shuf, sums)));
+			}
+		};
+
+		template <> struct ops<double>
+		{
+			using reg = __m128d;
+			static constexpr size_t width = 2;
+			CPPLAB_TARGET_SSE42 static reg zero() { return _mm_setzero_pd(); }
+			CPPLAB_TARGET_SSE42 static reg load(const double* p) { return _mm_loadu_pd(p); }
+			CPPLAB_TARGET_SSE42 static reg load(const float* p) { return _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)))); }
+			CPPLAB_TARGET_SSE42 static reg load(const std::int32_t* p) { return _mm_cvtepi32_pd(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p))); }
+			CPPLAB_TARGET_SSE42 static reg madd(reg acc, reg a, reg b) { return _mm_add_pd(acc, _mm_mul_pd(a, b)); }
+			CPPLAB_TARGET_SSE42 static reg add(reg a, reg b) { return _mm_add_pd(a, b); }
+			CPPLAB_TARGET_SSE42 static reg select(std::uint64_t bits, reg v) { return _mm_and_pd(v, _mm_castsi128_pd(lanes64(bits))); }
+			CPPLAB_TARGET_SSE42 static double sum(reg v) { return _mm_cvtsd_f64(_mm_add_sd(v, _mm_unpackhi_pd(v, v))); }
+		};
+
+		template <> struct ops<std::int32_t>
+		{
+			using reg = __m128i;
+			static constexpr size_t width = 4;
+			CPPLAB_TARGET_SSE42 static reg zero() { return _mm_setzero_si128(); }
+			CPPLAB_TARGET_SSE42 static reg load(const std::int32_t* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+			CPPLAB_TARGET_SSE42 static reg madd(reg acc, reg a, reg b) { return _mm_add_epi32(acc, _mm_mullo_epi32(a, b)); }
+			CPPLAB_TARGET_SSE42 static reg add(reg a, reg b) { return _mm_add_epi32(a, b); }
+			CPPLAB_TARGET_SSE42 static reg select(std::uint64_t bits, reg v) { return _mm_and_si128(v, lanes32(bits)); }
+			CPPLAB_TARGET_SSE42 static std::int32_t sum(reg v)
+			{
+				v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+				v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+				return _mm_cvtsi128_si32(v);
+			}
+		};
+
+		template <> struct ops<std::int64_t>
+		{
+			using reg = __m128i;
+			static constexpr size_t width = 2;
+			CPPLAB_TARGET_SSE42 static reg zero() { return _mm_setzero_si128(); }
+			CPPLAB_TARGET_SSE42 static reg load(const std::int64_t* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+			CPPLAB_TARGET_SSE42 static reg load(const std::int32_t* p) { return _mm_cvtepi32_epi64(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p))); }
+			CPPLAB_TARGET_SSE42 static reg madd(reg acc, reg a, reg b)
+			{
+				// There is no 64-bit multiplication, it is put together from 32x32->64 bit products (modulo 2^64)
+				reg cross = _mm_add_epi64(_mm_mul_epu32(a, _mm_srli_epi64(b, 32)), _mm_mul_epu32(_mm_srli_epi64(a, 32), b));
+				reg product = _mm_add_epi64(_mm_mul_epu32(a, b), _mm_slli_epi64(cross, 32));
+				return _mm_add_epi64(acc, product);
+			}
+			CPPLAB_TARGET_SSE42 static reg add(reg a, reg b) { return _mm_add_epi64(a, b); }
+			CPPLAB_TARGET_SSE42 static reg select(std::uint64_t bits, reg v) { return _mm_and_si128(v, lanes64(bits)); }
+			CPPLAB_TARGET_SSE42 static std::int64_t sum(reg v)
+			{
+				alignas(16) std::int64_t lanes[2];
+				_mm_store_si128(reinterpret_cast<__m128i*>(lanes), v);
+				return lanes[0] + lanes[1];
+			}
+		};
+
+		// int32 elements summed in int64: the loads sign-extend them, so the 32x32->64 bit multiplication is exact
+		struct widening_ops : ops<std::int64_t>
+		{
+			CPPLAB_TARGET_SSE42 static reg madd(reg acc, reg a, reg b) { return _mm_add_epi64(acc, _mm_mul_epi32(a, b)); }
+		};
+
+		template <typename R, typename A, typename B> struct select_ops { using type = ops<R>; };
+		template <> struct select_ops<std::int64_t, std::int32_t, std::int32_t> { using type = widening_ops; };
+
+		template <typename R, typename A, typename B>
+		CPPLAB_TARGET_SSE42 R dot(const A* a, const B* b, size_t n)
+		{
+			using op = typename select_ops<R, A, B>::type;
+			constexpr size_t w = op::width;
+
+			// Four independent accumulators hide the latency of the additions
+			typename op::reg acc0 = op::zero(), acc1 = op::zero(), acc2 = op::zero(), acc3 = op::zero();
+			size_t i = 0;
+
+			for (; i + 4 * w <= n; i += 4 * w)
+			{
+				acc0 = op::madd(acc0, op::load(a + i), op::load(b + i));
+				acc1 = op::madd(acc1, op::load(a + i + w), op::load(b + i + w));
+				acc2 = op::madd(acc2, op::load(a + i + 2 * w), op::load(b + i + 2 * w));
+				acc3 = op::madd(acc3, op::load(a + i + 3 * w), op::load(b + i + 3 * w));
+			}
+			for (; i + w <= n; i += w)
+				acc0 = op::madd(acc0, op::load(a + i), op::load(b + i));
+
+			R result = op::sum(op::add(op::add(acc0, acc1), op::add(acc2, acc3)));
+			for (; i < n; i++)
+				result += static_cast<R>(a[i]) * static_cast<R>(b[i]);
+
+			return result;
+		}
+
+		/* Dot products of four rows with the same vector x, added to out[0..3]. Every load of x is shared by the four rows. */
+		template <typename R, typename A, typename B>
+		CPPLAB_TARGET_SSE42 void dot4(const A* const* rows, const B* x, size_t n, R* out)
+		{
+			using op = typename select_ops<R, A, B>::type;
+			constexpr size_t w = op::width;
+
+			typename op::reg acc0 = op::zero(), acc1 = op::zero(), acc2 = op::zero(), acc3 = op::zero();
+			size_t i = 0;
+
+			for (; i + w <= n; i += w)
+			{
+				typename op::reg xv = op::load(x + i);
+				acc0 = op::madd(acc0, op::load(rows[0] + i), xv);
+				acc1 = op::madd(acc1, op::load(rows[1] + i), xv);
+				acc2 = op::madd(acc2, op::load(rows[2] + i), xv);
+				acc3 = op::madd(acc3, op::load(rows[3] + i), xv);
+			}
+
+			R result[4] = { op::sum(acc0), op::sum(acc1), op::sum(acc2), op::sum(acc3) };
+			for (; i < n; i++)
+			{
+				for (size_t r = 0; r < 4; r++)
+					result[r] += static_cast<R>(rows[r][i]) * static_cast<R>(x[i]);
+			}
+
+			for (size_t r = 0; r < 4; r++)
+				out[r] += result[r];
+		}
+
+		/* Sum of the values whose bits are set in mask (bit i of word i / 64 belongs to values[i]). */
+		template <typename R, typename B>
+		CPPLAB_TARGET_SSE42 R masked_sum(const std::uint64_t* mask, const B* values, size_t n)
+		{
+			using op = ops<R>;
+			constexpr size_t w = op::width;  // 4 * w divides 64, so the bits of one step never cross a word
+
+			typename op::reg acc0 = op::zero(), acc1 = op::zero(), acc2 = op::zero(), acc3 = op::zero();
+			size_t i = 0;
+
+			for (; i + 4 * w <= n; i += 4 * w)
+			{
+				std::uint64_t bits = mask[i / 64] >> (i % 64);
+				acc0 = op::add(acc0, op::select(bits, op::load(values + i)));
+				acc1 = op::add(acc1, op::select(bits >> w, op::load(values + i + w)));
+				acc2 = op::add(acc2, op::select(bits >> (2 * w), op::load(values + i + 2 * w)));
+				acc3 = op::add(acc3, op::select(bits >> (3 * w), op::load(values + i + 3 * w)));
+			}
+
+			R result = op::sum(op::add(op::add(acc0, acc1), op::add(acc2, acc3)));
+			for (; i < n; i++)
+			{
+				if ((mask[i / 64] >> (i % 64)) & 1)
+					result += static_cast<R>(values[i]);
+			}
+
+			return result;
+		}
+
+		/* Number of bits set in both a and b (n words), four words per step so the popcnt instructions overlap. */
+		CPPLAB_TARGET_SSE42 inline size_t popcount_and(const std::uint64_t* a, const std::uint64_t* b, size_t n)
+		{
+			size_t acc[4] = { 0, 0, 0, 0 };
+			size_t i = 0;
+
+			for (; i + 4 <= n; i += 4)
+			{
+				acc[0] += std::popcount(a[i] & b[i]);
+				acc[1] += std::popcount(a[i + 1] & b[i + 1]);
+				acc[2] += std::popcount(a[i + 2] & b[i + 2]);
+				acc[3] += std::popcount(a[i + 3] & b[i + 3]);
+			}
+
+			size_t result = (acc[0] + acc[1]) + (acc[2] + acc[3]);
+			for (; i < n; i++)
+				result += std::popcount(a[i] & b[i]);
+
+			return result;
+		}
+
+		CPPLAB_TARGET_SSE42 inline size_t popcount(const std::uint64_t* a, size_t n)
+		{
+			size_t acc[4] = { 0, 0, 0, 0 };
+			size_t i = 0;
+
+			for (; i + 4 <= n; i += 4)
+			{
+				acc[0] += std::popcount(a[i]);
+				acc[1] += std::popcount(a[i + 1]);
+				acc[2] += std::popcount(a[i + 2]);
+				acc[3] += std::popcount(a[i + 3]);
+			}
+
+			size_t result = (acc[0] + acc[1]) + (acc[2] + acc[3]);
+			for (; i < n; i++)
+				result += std::popcount(a[i]);
+
+			return result;
+		}
+	}
+
+	namespace avx2
+	{
+		CPPLAB_TARGET_AVX2 inline __m256i lanes32(std::uint64_t bits)
+		{
+			const __m256i lane_bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+			return _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(static_cast<int>(bits)), lane_bits), lane_bits);
+		}
+
+		CPPLAB_TARGET_AVX2 inline __m256i lanes64(std::uint64_t bits)
+		{
+			const __m256i lane_bits = _mm256_setr_epi64x(1, 2, 4, 8);
+			return _mm256_cmpeq_epi64(_mm256_and_si256(_mm256_set1_epi64x(static_cast<long long>(bits)), lane_bits), lane_bits);
+		}
+
+		template <typename R> struct ops;
+
+		template <> struct ops<float>
+		{
+			using reg = __m256;
+			static constexpr size_t width = 8;
+			CPPLAB_TARGET_AVX2 static reg zero() { return _mm256_setzero_ps(); }
+			CPPLAB_TARGET_AVX2 static reg load(const float* p) { return _mm256_loadu_ps(p); }
+			CPPLAB_TARGET_AVX2 static reg load(const std::int32_t* p) { return _mm256_cvtepi32_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p))); }
+			CPPLAB_TARGET_AVX2 static reg madd(reg acc, reg a, reg b) { return _mm256_fmadd_ps(a, b, acc); }
+			CPPLAB_TARGET_AVX2 static reg add(reg a, reg b) { return _mm256_add_ps(a, b); }
+			CPPLAB_TARGET_AVX2 static reg select(std::uint64_t bits, reg v) { return _mm256_and_ps(v, _mm256_castsi256_ps(lanes32(bits))); }
+			CPPLAB_TARGET_AVX2 static float sum(reg v)
+			{
+				return sse42::ops<float>::sum(_mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1)));
+			}
+		};
+
+		template <> struct ops<double>
+		{
+			using reg = __m256d;
+			static constexpr size_t width = 4;
+			CPPLAB_TARGET_AVX2 static reg zero() { return _mm256_setzero_pd(); }
+			CPPLAB_TARGET_AVX2 static reg load(const double* p) { return _mm256_loadu_pd(p); }
+			CPPLAB_TARGET_AVX2 static reg load(const float* p) { return _mm256_cvtps_pd(_mm_loadu_ps(p)); }
+			CPPLAB_TARGET_AVX2 static reg load(const std::int32_t* p) { return _mm256_cvtepi32_pd(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))); }
+			CPPLAB_TARGET_AVX2 static reg madd(reg acc, reg a, reg b) { return _mm256_fmadd_pd(a, b, acc); }
+			CPPLAB_TARGET_AVX2 static reg add(reg a, reg b) { return _mm256_add_pd(a, b); }
+			CPPLAB_TARGET_AVX2 static reg select(std::uint64_t bits, reg v) { return _mm256_and_pd(v, _mm256_castsi256_pd(lanes64(bits))); }
+			CPPLAB_TARGET_AVX2 static double sum(reg v)
+			{
+				return sse42::ops<double>::sum(_mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1)));
+			}
+		};
+
+		template <> struct ops<std::int32_t>
+		{
+			using reg = __m256i;
+			static constexpr size_t width = 8;
+			CPPLAB_TARGET_AVX2 static reg zero() { return _mm256_setzero_si256(); }
+			CPPLAB_TARGET_AVX2 static reg load(const std::int32_t* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+			CPPLAB_TARGET_AVX2 static reg madd(reg acc, reg a, reg b) { return _mm256_add_epi32(acc, _mm256_mullo_epi32(a, b)); }
+			CPPLAB_TARGET_AVX2 static reg add(reg a, reg b) { return _mm256_add_epi32(a, b); }
+			CPPLAB_TARGET_AVX2 static reg select(std::uint64_t bits, reg v) { return _mm256_and_si256(v, lanes32(bits)); }
+			CPPLAB_TARGET_AVX2 static std::int32_t sum(reg v)
+			{
+				return sse42::ops<std::int32_t>::sum(_mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1)));
+			}
+		};
+
+		template <> struct ops<std::int64_t>
+		{
+			using reg = __m256i;
+			static constexpr size_t width = 4;
+			CPPLAB_TARGET_AVX2 static reg zero() { return _mm256_setzero_si256(); }
+			CPPLAB_TARGET_AVX2 static reg load(const std::int64_t* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+			CPPLAB_TARGET_AVX2 static reg load(const std::int32_t* p) { return _mm256_cvtepi32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))); }
+			CPPLAB_TARGET_AVX2 static reg madd(reg acc, reg a, reg b)
+			{
+				reg cross = _mm256_add_epi64(_mm256_mul_epu32(a, _mm256_srli_epi64(b, 32)), _mm256_mul_epu32(_mm256_srli_epi64(a, 32), b));
+				reg product = _mm256_add_epi64(_mm256_mul_epu32(a, b), _mm256_slli_epi64(cross, 32));
+				return _mm256_add_epi64(acc, product);
+			}
+			CPPLAB_TARGET_AVX2 static reg add(reg a, reg b) { return _mm256_add_epi64(a, b); }
+			CPPLAB_TARGET_AVX2 static reg select(std::uint64_t bits, reg v) { return _mm256_and_si256(v, lanes64(bits)); }
+			CPPLAB_TARGET_AVX2 static std::int64_t sum(reg v)
+			{
+				return sse42::ops<std::int64_t>::sum(_mm_add_epi64(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1)));
+			}
+		};
+
+		// int32 elements summed in int64: the loads sign-extend them, so the 32x32->64 bit multiplication is exact
+		struct widening_ops : ops<std::int64_t>
+		{
+			CPPLAB_TARGET_AVX2 static reg madd(reg acc, reg a, reg b) { return _mm256_add_epi64(acc, _mm256_mul_epi32(a, b)); }
+		};
+
+		template <typename R, typename A, typename B> struct select_ops { using type = ops<R>; };
+		template <> struct select_ops<std::int64_t, std::int32_t, std::int32_t> { using type = widening_ops; };
+
+		template <typename R, typename A, typename B>
+		CPPLAB_TARGET_AVX2 R dot(const A* a, const B* b, size_t n)
+		{
+			using op = typename select_ops<R, A, B>::type;
+			constexpr size_t w = op::width;
+
+			typename op::reg acc0 = op::zero(), acc1 = op::zero(), acc2 = op::zero(), acc3 = op::zero();
+			size_t i = 0;
+
+			for (; i + 4 * w <= n; i += 4 * w)
+			{
+				acc0 = op::madd(acc0, op::load(a + i), op::load(b + i));
+				acc1 = op::madd(acc1, op::load(a + i + w), op::load(b + i + w));
+				acc2 = op::madd(acc2, op::load(a + i + 2 * w), op::load(b + i + 2 * w));
+				acc3 = op::madd(acc3, op::load(a + i + 3 * w), op::load(b + i + 3 * w));
+			}
+			for (; i + w <= n; i += w)
+				acc0 = op::madd(acc0, op::load(a + i), op::load(b + i));
+
+			R result = op::sum(op::add(op::add(acc0, acc1), op::add(acc2, acc3)));
+			for (; i < n; i++)
+				result += static_cast<R>(a[i]) * static_cast<R>(b[i]);
+
+			return result;
+		}
+
+		/* Dot products of four rows with the same vector x, added to out[0..3]. Every load of x is shared by the four rows. */
+		template <typename R, typename A, typename B>
+		CPPLAB_TARGET_AVX2 void dot4(const A* const* rows, const B* x, size_t n, R* out)
+		{
+			using op = typename select_ops<R, A, B>::type;
+			constexpr size_t w = op::width;
+
+			typename op::reg acc0 = op::zero(), acc1 = op::zero(), acc2 = op::zero(), acc3 = op::zero();
+			size_t i = 0;
+
+			for (; i + w <= n; i += w)
+			{
+				typename op::reg xv = op::load(x + i);
+				acc0 = op::madd(acc0, op::load(rows[0] + i), xv);
+				acc1 = op::madd(acc1, op::load(rows[1] + i), xv);
+				acc2 = op::madd(acc2, op::load(rows[2] + i), xv);
+				acc3 = op::madd(acc3, op::load(rows[3] + i), xv);
+			}
+
+			R result[4] = { op::sum(acc0), op::sum(acc1), op::sum(acc2), op::sum(acc3) };
+			for (; i < n; i++)
+			{
+				for (size_t r = 0; r < 4; r++)
+					result[r] += static_cast<R>(rows[r][i]) * static_cast<R>(x[i]);
+			}
+
+			for (size_t r = 0; r < 4; r++)
+				out[r] += result[r];
+		}
+
+		/* Sum of the values whose bits are set in mask (bit i of word i / 64 belongs to values[i]). */
+		template <typename R, typename B>
+		CPPLAB_TARGET_AVX2 R masked_sum(const std::uint64_t* mask, const B* values, size_t n)
+		{
+			using op = ops<R>;
+			constexpr size_t w = op::width;  // 4 * w divides 64, so the bits of one step never cross a word
+
+			typename op::reg acc0 = op::zero(), acc1 = op::zero(), acc2 = op::zero(), acc3 = op::zero();
+			size_t i = 0;
+
+			for (; i + 4 * w <= n; i += 4 * w)
+			{
+				std::uint64_t bits = mask[i / 64] >> (i % 64);
+				acc0 = op::add(acc0, op::select(bits, op::load(values + i)));
+				acc1 = op::add(acc1, op::select(bits >> w, op::load(values + i + w)));
+				acc2 = op::add(acc2, op::select(bits >> (2 * w), op::load(values + i + 2 * w)));
+				acc3 = op::add(acc3, op::select(bits >> (3 * w), op::load(values + i + 3 * w)));
+			}
+
+			R result = op::sum(op::add(op::add(acc0, acc1), op::add(acc2, acc3)));
+			for (; i < n; i++)
+			{
+				if ((mask[i / 64] >> (i % 64)) & 1)
+					result += static_cast<R>(values[i]);
+			}
+
+			return result;
+		}
+
+		// Sparse-dense dot products: the dense elements at the given indices are fetched with gather instructions.
+		// Gather indices are signed, so every index must be below 2^31.
+
+		CPPLAB_TARGET_AVX2 inline float dot_gather(const float* values, const std::uint32_t* indices, const float* dense, size_t n)
+		{
+			// The masked form with a zero source has no dependency on the old contents of the register
+			const __m256 all = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+			__m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+			size_t k = 0;
+
+			for (; k + 16 <= n; k += 16)
+			{
+				__m256i idx0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(indices + k));
+				__m256i idx1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(indices + k + 8));
+				acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(values + k), _mm256_mask_i32gather_ps(_mm256_setzero_ps(), dense, idx0, all, 4), acc0);
+				acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(values + k + 8), _mm256_mask_i32gather_ps(_mm256_setzero_ps(), dense, idx1, all, 4), acc1);
+			}
+
+			float result = ops<float>::sum(_mm256_add_ps(acc0, acc1));
+			for (; k < n; k++)
+				result += values[k] * dense[indices[k]];
+
+			return result;
+		}
+
+		CPPLAB_TARGET_AVX2 inline double dot_gather(const double* values, const std::uint32_t* indices, const double* dense, size_t n)
+		{
+			const __m256d all = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+			__m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+			size_t k = 0;
+
+			for (; k + 8 <= n; k += 8)
+			{
+				__m128i idx0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(indices + k));
+				__m128i idx1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(indices + k + 4));
+				acc0 = _mm256_fmadd_pd(_mm256_loadu_pd(values + k), _mm256_mask_i32gather_pd(_mm256_setzero_pd(), dense, idx0, all, 8), acc0);
+				acc1 = _mm256_fmadd_pd(_mm256_loadu_pd(values + k + 4), _mm256_mask_i32gather_pd(_mm256_setzero_pd(), dense, idx1, all, 8), acc1);
+			}
+
+			double result = ops<double>::sum(_mm256_add_pd(acc0, acc1));
+			for (; k < n; k++)
+				result += values[k] * dense[indices[k]];
+
+			return result;
+		}
+	}
+
+	// GCC 12 warns about the placeholder operand inside some of its own AVX-512 intrinsics, the warnings are bogus
+#if defined(__GNUC__) && !defined(__clang__)
+	#pragma GCC diagnostic push
+	#pragma GCC diagnostic ignored "-Wuninitialized"
+	#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+	namespace avx512
+	{
+		template <typename R> struct ops;
+
+		template <> struct ops<float>
+		{
+			using reg = __m512;
+			static constexpr size_t width = 16;
+			CPPLAB_TARGET_AVX512 static reg zero() { return _mm512_setzero_ps(); }
+			CPPLAB_TARGET_AVX512 static reg load(const float* p) { return _mm512_loadu_ps(p); }
+			CPPLAB_TARGET_AVX512 static reg load(const std::int32_t* p) { return _mm512_cvtepi32_ps(_mm512_loadu_si512(p)); }
+			CPPLAB_TARGET_AVX512 static reg madd(reg acc, reg a, reg b) { return _mm512_fmadd_ps(a, b, acc); }
+			CPPLAB_TARGET_AVX512 static reg add(reg a, reg b) { return _mm512_add_ps(a, b); }
+			CPPLAB_TARGET_AVX512 static reg select(std::uint64_t bits, reg v) { return _mm512_maskz_mov_ps(static_cast<__mmask16>(bits), v); }
+			CPPLAB_TARGET_AVX512 static float sum(reg v) { return avx2::ops<float>::sum(_mm256_add_ps(_mm512_castps512_ps256(v), _mm512_extractf32x8_ps(v, 1))); }
+		};
+
+		template <> struct ops<double>
+		{
+			using reg = __m512d;
+			static constexpr size_t width = 8;
+			CPPLAB_TARGET_AVX512 static reg zero() { return _mm512_setzero_pd(); }
+			CPPLAB_TARGET_AVX512 static reg load(const double* p) { return _mm512_loadu_pd(p); }
+			CPPLAB_TARGET_AVX512 static reg load(const float* p) { return _mm512_cvtps_pd(_mm256_loadu_ps(p)); }
+			CPPLAB_TARGET_AVX512 static reg load(const std::int32_t* p) { return _mm512_cvtepi32_pd(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p))); }
+			CPPLAB_TARGET_AVX512 static reg madd(reg acc, reg a, reg b) { return _mm512_fmadd_pd(a, b, acc); }
+			CPPLAB_TARGET_AVX512 static reg add(reg a, reg b) { return _mm512_add_pd(a, b); }
+			CPPLAB_TARGET_AVX512 static reg select(std::uint64_t bits, reg v) { return _mm512_maskz_mov_pd(static_cast<__mmask8>(bits), v); }
+			CPPLAB_TARGET_AVX512 static double sum(reg v) { return avx2::ops<double>::sum(_mm256_add_pd(_mm512_castpd512_pd256(v), _mm512_extractf64x4_pd(v, 1))); }
+		};
+
+		template <> struct ops<std::int32_t>
+		{
+			using reg = __m512i;
+			static constexpr size_t width = 16;
+			CPPLAB_TARGET_AVX512 static reg zero() { return _mm512_setzero_si512(); }
+			CPPLAB_TARGET_AVX512 static reg load(const std::int32_t* p) { return _mm512_loadu_si512(p); }
+			CPPLAB_TARGET_AVX512 static reg madd(reg acc, reg a, reg b) { return _mm512_add_epi32(acc, _mm512_mullo_epi32(a, b)); }
+			CPPLAB_TARGET_AVX512 static reg add(reg a, reg b) { return _mm512_add_epi32(a, b); }
+			CPPLAB_TARGET_AVX512 static reg select(std::uint64_t bits, reg v) { return _mm512_maskz_mov_epi32(static_cast<__mmask16>(bits), v); }
+			CPPLAB_TARGET_AVX512 static std::int32_t sum(reg v) { return avx2::ops<std::int32_t>::sum(_mm256_add_epi32(_mm512_castsi512_si256(v), _mm512_extracti64x4_epi64(v, 1))); }
+		};
+
+		template <> struct ops<std::int64_t>
+		{
+			using reg = __m512i;
+			static constexpr size_t width = 8;
+			CPPLAB_TARGET_AVX512 static reg zero() { return _mm512_setzero_si512(); }
+			CPPLAB_TARGET_AVX512 static reg load(const std::int64_t* p) { return _mm512_loadu_si512(p); }
+			CPPLAB_TARGET_AVX512 static reg load(const std::int32_t* p) { return _mm512_cvtepi32_epi64(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p))); }
+			CPPLAB_TARGET_AVX512 static reg madd(reg acc, reg a, reg b) { return _mm512_add_epi64(acc, _mm512_mullo_epi64(a, b)); }
+			CPPLAB_TARGET_AVX512 static reg add(reg a, reg b) { return _mm512_add_epi64(a, b); }
+			CPPLAB_TARGET_AVX512 static reg select(std::uint64_t bits, reg v) { return _mm512_maskz_mov_epi64(static_cast<__mmask8>(bits), v); }
+			CPPLAB_TARGET_AVX512 static std::int64_t sum(reg v) { return avx2::ops<std::int64_t>::sum(_mm256_add_epi64(_mm512_castsi512_si256(v), _mm512_extracti64x4_epi64(v, 1))); }
+		};
+
+		// int32 elements summed in int64: the loads sign-extend them, so the 32x32->64 bit multiplication is exact
+		struct widening_ops : ops<std::int64_t>
+		{
+			CPPLAB_TARGET_AVX512 static reg madd(reg acc, reg a, reg b) { return _mm512_add_epi64(acc, _mm512_mul_epi32(a, b)); }
+		};
+
+		template <typename R, typename A, typename B> struct select_ops { using type = ops<R>; };
+		template <> struct select_ops<std::int64_t, std::int32_t, std::int32_t> { using type = widening_ops; };
+
+		template <typename R, typename A, typename B>
+		CPPLAB_TARGET_AVX512 R dot(const A* a, const B* b, size_t n)
+		{
+			using op = typename select_ops<R, A, B>::type;
+			constexpr size_t w = op::width;
+
+			typename op::reg acc0 = op::zero(), acc1 = op::zero(), acc2 = op::zero(), acc3 = op::zero();
+			size_t i = 0;
+
+			for (; i + 4 * w <= n; i += 4 * w)
+			{
+				acc0 = op::madd(acc0, op::load(a + i), op::load(b + i));
+				acc1 = op::madd(acc1, op::load(a + i + w), op::load(b + i + w));
+				acc2 = op::madd(acc2, op::load(a + i + 2 * w), op::load(b + i + 2 * w));
+				acc3 = op::madd(acc3, op::load(a + i + 3 * w), op::load(b + i + 3 * w));
+			}
+			for (; i + w <= n; i += w)
+				acc0 = op::madd(acc0, op::load(a + i), op::load(b + i));
+
+			R result = op::sum(op::add(op::add(acc0, acc1), op::add(acc2, acc3)));
+			for (; i < n; i++)
+				result += static_cast<R>(a[i]) * static_cast<R>(b[i]);
+
+			return result;
+		}
+
+		/* Dot products of four rows with the same vector x, added to out[0..3]. Every load of x is shared by the four rows. */
+		template <typename R, typename A, typename B>
+		CPPLAB_TARGET_AVX512 void dot4(const A* const* rows, const B* x, size_t n, R* out)
+		{
+			using op = typename select_ops<R, A, B>::type;
+			constexpr size_t w = op::width;
+
+			typename op::reg acc0 = op::zero(), acc1 = op::zero(), acc2 = op::zero(), acc3 = op::zero();
+			size_t i = 0;
+
+			for (; i + w <= n; i += w)
+			{
+				typename op::reg xv = op::load(x + i);
+				acc0 = op::madd(acc0, op::load(rows[0] + i), xv);
+				acc1 = op::madd(acc1, op::load(rows[1] + i), xv);
+				acc2 = op::madd(acc2, op::load(rows[2] + i), xv);
+				acc3 = op::madd(acc3, op::load(rows[3] + i), xv);
+			}
+
+			R result[4] = { op::sum(acc0), op::sum(acc1), op::sum(acc2), op::sum(acc3) };
+			for (; i < n; i++)
+			{
+				for (size_t r = 0; r < 4; r++)
+					result[r] += static_cast<R>(rows[r][i]) * static_cast<R>(x[i]);
+			}
+
+			for (size_t r = 0; r < 4; r++)
+				out[r] += result[r];
+		}
+
+		/* Sum of the values whose bits are set in mask (bit i of word i / 64 belongs to values[i]). */
+		template <typename R, typename B>
+		CPPLAB_TARGET_AVX512 R masked_sum(const std::uint64_t* mask, const B* values, size_t n)
+		{
+			using op = ops<R>;
+			constexpr size_t w = op::width;  // 4 * w divides 64, so the bits of one step never cross a word
+
+			typename op::reg acc0 = op::zero(), acc1 = op::zero(), acc2 = op::zero(), acc3 = op::zero();
+			size_t i = 0;
+
+			for (; i + 4 * w <= n; i += 4 * w)
+			{
+				std::uint64_t bits = mask[i / 64] >> (i % 64);
+				acc0 = op::add(acc0, op::select(bits, op::load(values + i)));
+				acc1 = op::add(acc1, op::select(bits >> w, op::load(values + i + w)));
+				acc2 = op::add(acc2, op::select(bits >> (2 * w), op::load(values + i + 2 * w)));
+				acc3 = op::add(acc3, op::select(bits >> (3 * w), op::load(values + i + 3 * w)));
+			}
+
+			R result = op::sum(op::add(op::add(acc0, acc1), op::add(acc2, acc3)));
+			for (; i < n; i++)
+			{
+				if ((mask[i / 64] >> (i % 64)) & 1)
+					result += static_cast<R>(values[i]);
+			}
+
+			return result;
+		}
+	}
+#if defined(__GNUC__) && !defined(__clang__)
+	#pragma GCC diagnostic pop
+#endif
+#endif
+
+	/// <summary>Dot product of two contiguous arrays accumulated in R, computed by the best kernel the CPU supports.</summary>
+	template <typename R, typename A, typename B> requires HasAccumulateKernel<R, A, B>
+	R dot_as(const A* a, const B* b, size_t n)
+	{
+		// Loads convert the elements up to R, so mixed pairs and widened accumulators need no extra pass
+#if CPPLAB_SIMD_X86
+		switch (active_level())
+		{
+			case level::avx512: return avx512::dot<R>(a, b, n);
+			case level::avx2: return avx2::dot<R>(a, b, n);
+			case level::sse42: return sse42::dot<R>(a, b, n);
+			default: break;
+		}
+#endif
+		return dot_scalar<R>(a, b, n);
+	}
+
+	/// <summary>Adds the dot products of rows[0..3] with x (all of length n) to out[0..3], accumulating in R.</summary>
+	template <typename R, typename A, typename B> requires HasAccumulateKernel<R, A, B>
+	void dot4_as(const A* const* rows, const B* x, size_t n, R* out)
+	{
+#if CPPLAB_SIMD_X86
+		switch (active_level())
+		{
+			case level::avx512: return avx512::dot4<R>(rows, x, n, out);
+			case level::avx2: return avx2::dot4<R>(rows, x, n, out);
+			case level::sse42: return sse42::dot4<R>(rows, x, n, out);
+			default: break;
+		}
+#endif
+		dot4_scalar<R>(rows, x, n, out);
+	}
+
+	/// <summary>
+	/// Sum of values[k] * dense[indices[k]] for k in [0, n), accumulated in R. Indices must be below 2^31.
+	/// float and double use gather instructions (AVX-512 gathers are no faster than AVX2 ones, so AVX2 is used for both).
+	/// </summary>
+	template <typename R, typename A, typename B>
+	R dot_gather_as(const A* values, const std::uint32_t* indices, const B* dense, size_t n)
+	{
+#if CPPLAB_SIMD_X86
+		if constexpr ((std::is_same_v<R, float> || std::is_same_v<R, double>) && std::is_same_v<R, A> && std::is_same_v<R, B>)
+		{
+			if (active_level() >= level::avx2)
+				return avx2::dot_gather(values, indices, dense, n);
+		}
+#endif
+		return dot_gather_scalar<R>(values, indices, dense, n);
+	}
+
+	/// <summary>
+	/// Sum of values[i] for the i in [0, n) whose bit is set in mask (bit i % 64 of mask[i / 64]), accumulated in R.
+	/// This is the dot product of a bit vector with a vector of numbers: the kernels zero the lanes of the cleared bits
+	/// instead of branching on every bit, so the time does not depend on how many bits are set.
+	/// </summary>
+	template <typename R, typename B> requires LoadsInto<R, B>
+	R masked_sum_as(const std::uint64_t* mask, const B* values, size_t n)
+	{
+#if CPPLAB_SIMD_X86
+		switch (active_level())
+		{
+			case level::avx512: return avx512::masked_sum<R>(mask, values, n);
+			case level::avx2: return avx2::masked_sum<R>(mask, values, n);
+			case level::sse42: return sse42::masked_sum<R>(mask, values, n);
+			default: break;
+		}
+#endif
+		return masked_sum_scalar<R>(mask, values, n);
+	}
+
+	/// <summary>Number of set bits in n words.</summary>
+	inline size_t popcount(const std::uint64_t* a, size_t n)
+	{
+#if CPPLAB_SIMD_X86
+		if (active_level() >= level::sse42)
+			return sse42::popcount(a, n);
+#endif
+		size_t result = 0;
+		for (size_t i = 0; i < n; i++)
+			result += std::popcount(a[i]);
+
+		return result;
+	}
+
+	/// <summary>Number of bits set in both a and b (n words each), i.e. the dot product of two bit vectors.</summary>
+	inline size_t popcount_and(const std::uint64_t* a, const std::uint64_t* b, size_t n)
+	{
+#if CPPLAB_SIMD_X86
+		if (active_level() >= level::sse42)
+			return sse42::popcount_and(a, b, n);
+#endif
+		size_t result = 0;
+		for (size_t i = 0; i < n; i++)
+			result += std::popcount(a[i] & b[i]);
+
+		return result;
+	}
+
+	/// <summary>Dot product of two contiguous arrays, computed by the best kernel the CPU supports.</summary>
+	/// <returns>Result of the same type as a[i] * b[i] would have</returns>
+	template <typename A, typename B> requires HasDotKernel<A, B>
+	auto dot(const A* a, const B* b, size_t n)
+	{
+		return dot_as<decltype(a[0] * b[0])>(a, b, n);
+	}
+}
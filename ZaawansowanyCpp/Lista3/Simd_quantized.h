@@ -0,0 +1,323 @@
+// Dot product kernels working directly on compressed elements: int8 (multiplied in 16 bits and summed pairwise into 32 bits),
+// IEEE half precision (fp16) and bfloat16 (bf16), which are widened to float only inside the registers
+
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#include "Simd_dot.h"
+
+#if defined(__GNUC__) || defined(__clang__)
+	#define CPPLAB_TARGET_AVX512_BF16 __attribute__((target("avx512f,avx512dq,avx512bw,avx512vl,avx2,fma,f16c,avx512bf16")))
+#endif
+
+
+namespace cpplab::simd
+{
+	/* IEEE 754 half precision to float, every half is exactly representable. */
+	inline float half_to_float(std::uint16_t h)
+	{
+		std::uint32_t sign = static_cast<std::uint32_t>(h & 0x8000) << 16;
+		std::uint32_t exponent = (h >> 10) & 0x1f;
+		std::uint32_t mantissa = h & 0x3ff;
+
+		if (exponent == 0)  // Zero or subnormal: mantissa * 2^-24
+		{
+			float value = std::ldexp(static_cast<float>(mantissa), -24);
+			return sign ? -value : value;
+		}
+		if (exponent == 31)  // Infinity or NaN
+			return std::bit_cast<float>(sign | 0x7f800000u | (mantissa << 13));
+
+		return std::bit_cast<float>(sign | ((exponent + 112) << 23) | (mantissa << 13));
+	}
+
+	/* Float to IEEE 754 half precision, rounded to nearest even. Values above the half range become infinity. */
+	inline std::uint16_t float_to_half(float f)
+	{
+		std::uint32_t bits = std::bit_cast<std::uint32_t>(f);
+		std::uint16_t sign = static_cast<std::uint16_t>((bits >> 16) & 0x8000);
+		std::uint32_t abs = bits & 0x7fffffff;
+
+		if (abs > 0x7f800000)  // NaN stays a (quiet) NaN
+			return sign | 0x7e00;
+		if (abs >= 0x477ff000)  // 65520 and more rounds to infinity
+			return sign | 0x7c00;
+		if (abs < 0x38800000)  // Below 2^-14 the result is subnormal, its mantissa counts units of 2^-24
+			return sign | static_cast<std::uint16_t>(std::nearbyint(std::bit_cast<float>(abs) * 16777216.0f));
+
+		// Rebias the exponent and drop 13 mantissa bits, a carry out of the mantissa correctly bumps the exponent
+		abs -= 112u << 23;
+		return sign | static_cast<std::uint16_t>((abs + 0xfff + ((abs >> 13) & 1)) >> 13);
+	}
+
+	/* bfloat16 is the upper half of a float. */
+	inline float bf16_to_float(std::uint16_t b)
+	{
+		return std::bit_cast<float>(static_cast<std::uint32_t>(b) << 16);
+	}
+
+	/* Float to bfloat16, rounded to nearest even. */
+	inline std::uint16_t float_to_bf16(float f)
+	{
+		std::uint32_t bits = std::bit_cast<std::uint32_t>(f);
+		if ((bits & 0x7fffffff) > 0x7f800000)
+			return static_cast<std::uint16_t>((bits >> 16) | 0x40);
+
+		return static_cast<std::uint16_t>((bits + 0x7fff + ((bits >> 16) & 1)) >> 16);
+	}
+
+	/* True when the CPU has the AVX-512 bf16 dot product instruction (vdpbf16ps). */
+	inline bool has_avx512_bf16()
+	{
+#if CPPLAB_SIMD_X86 && defined(CPPLAB_TARGET_AVX512_BF16)
+		static bool supported = []()
+			{
+				__builtin_cpu_init();
+				return __builtin_cpu_supports("avx512bf16") != 0;
+			}();
+		return supported;
+#else
+		return false;
+#endif
+	}
+
+	constexpr size_t int8_block = 1 << 16;  // The 32-bit partial sums of int8 products are moved to 64 bits this often
+
+	inline std::int64_t dot_i8_scalar(const std::int8_t* a, const std::int8_t* b, size_t n)
+	{
+		std::int64_t result = 0;
+		for (size_t i = 0; i < n; i++)
+			result += static_cast<std::int32_t>(a[i]) * b[i];
+
+		return result;
+	}
+
+	inline float dot_f16_scalar(const std::uint16_t* a, const std::uint16_t* b, size_t n)
+	{
+		float result = 0;
+		for (size_t i = 0; i < n; i++)
+			result += half_to_float(a[i]) * half_to_float(b[i]);
+
+		return result;
+	}
+
+	inline float dot_bf16_scalar(const std::uint16_t* a, const std::uint16_t* b, size_t n)
+	{
+		float result = 0;
+		for (size_t i = 0; i < n; i++)
+			result += bf16_to_float(a[i]) * bf16_to_float(b[i]);
+
+		return result;
+	}
+
+#if CPPLAB_SIMD_X86
+	namespace avx2
+	{
+		/* Bytes are sign-extended to 16 bits, madd multiplies them and adds neighbouring products into 32 bits. */
+		CPPLAB_TARGET_AVX2 inline std::int64_t dot_i8(const std::int8_t* a, const std::int8_t* b, size_t n)
+		{
+			std::int64_t result = 0;
+			size_t i = 0;
+
+			while (i + 32 <= n)
+			{
+				// At most 2^11 iterations per block, so the eight 32-bit lanes of both accumulators cannot overflow
+				size_t block_end = std::min(n, i + int8_block);
+				__m256i acc0 = _mm256_setzero_si256(), acc1 = _mm256_setzero_si256();
+
+				for (; i + 32 <= block_end; i += 32)
+				{
+					__m256i a0 = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)));
+					__m256i b0 = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+					__m256i a1 = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i + 16)));
+					__m256i b1 = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i + 16)));
+					acc0 = _mm256_add_epi32(acc0, _mm256_madd_epi16(a0, b0));
+					acc1 = _mm256_add_epi32(acc1, _mm256_madd_epi16(a1, b1));
+				}
+
+				result += ops<std::int32_t>::sum(_mm256_add_epi32(acc0, acc1));
+			}
+
+			return result + dot_i8_scalar(a + i, b + i, n - i);
+		}
+
+		CPPLAB_TARGET_AVX2 inline float dot_f16(const std::uint16_t* a, const std::uint16_t* b, size_t n)
+		{
+			__m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+			size_t i = 0;
+
+			for (; i + 16 <= n; i += 16)
+			{
+				acc0 = _mm256_fmadd_ps(_mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i))),
+					_mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i))), acc0);
+				acc1 = _mm256_fmadd_ps(_mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i + 8))),
+					_mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i + 8))), acc1);
+			}
+
+			return ops<float>::sum(_mm256_add_ps(acc0, acc1)) + dot_f16_scalar(a + i, b + i, n - i);
+		}
+
+		/* 8 bf16 values widened to floats by moving them to the upper halves of 32-bit lanes. */
+		CPPLAB_TARGET_AVX2 inline __m256 load_bf16(const std::uint16_t* p)
+		{
+			return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))), 16));
+		}
+
+		CPPLAB_TARGET_AVX2 inline float dot_bf16(const std::uint16_t* a, const std::uint16_t* b, size_t n)
+		{
+			__m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+			size_t i = 0;
+
+			for (; i + 16 <= n; i += 16)
+			{
+				acc0 = _mm256_fmadd_ps(load_bf16(a + i), load_bf16(b + i), acc0);
+				acc1 = _mm256_fmadd_ps(load_bf16(a + i + 8), load_bf16(b + i + 8), acc1);
+			}
+
+			return ops<float>::sum(_mm256_add_ps(acc0, acc1)) + dot_bf16_scalar(a + i, b + i, n - i);
+		}
+	}
+
+	// Same bogus GCC 12 warnings as in Simd_dot.h
+#if defined(__GNUC__) && !defined(__clang__)
+	#pragma GCC diagnostic push
+	#pragma GCC diagnostic ignored "-Wuninitialized"
+	#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+	namespace avx512
+	{
+		CPPLAB_TARGET_AVX512 inline std::int64_t dot_i8(const std::int8_t* a, const std::int8_t* b, size_t n)
+		{
+			std::int64_t result = 0;
+			size_t i = 0;
+
+			while (i + 64 <= n)
+			{
+				size_t block_end = std::min(n, i + int8_block);
+				__m512i acc0 = _mm512_setzero_si512(), acc1 = _mm512_setzero_si512();
+
+				for (; i + 64 <= block_end; i += 64)
+				{
+					__m512i a0 = _mm512_cvtepi8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)));
+					__m512i b0 = _mm512_cvtepi8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i)));
+					__m512i a1 = _mm512_cvtepi8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i + 32)));
+					__m512i b1 = _mm512_cvtepi8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i + 32)));
+					acc0 = _mm512_add_epi32(acc0, _mm512_madd_epi16(a0, b0));
+					acc1 = _mm512_add_epi32(acc1, _mm512_madd_epi16(a1, b1));
+				}
+
+				result += ops<std::int32_t>::sum(_mm512_add_epi32(acc0, acc1));
+			}
+
+			return result + avx2::dot_i8(a + i, b + i, n - i);
+		}
+
+		CPPLAB_TARGET_AVX512 inline float dot_f16(const std::uint16_t* a, const std::uint16_t* b, size_t n)
+		{
+			__m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+			size_t i = 0;
+
+			for (; i + 32 <= n; i += 32)
+			{
+				acc0 = _mm512_fmadd_ps(_mm512_cvtph_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i))),
+					_mm512_cvtph_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i))), acc0);
+				acc1 = _mm512_fmadd_ps(_mm512_cvtph_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i + 16))),
+					_mm512_cvtph_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i + 16))), acc1);
+			}
+
+			return ops<float>::sum(_mm512_add_ps(acc0, acc1)) + avx2::dot_f16(a + i, b + i, n - i);
+		}
+
+		CPPLAB_TARGET_AVX512 inline __m512 load_bf16(const std::uint16_t* p)
+		{
+			return _mm512_castsi512_ps(_mm512_slli_epi32(_mm512_cvtepu16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p))), 16));
+		}
+
+		CPPLAB_TARGET_AVX512 inline float dot_bf16(const std::uint16_t* a, const std::uint16_t* b, size_t n)
+		{
+			__m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+			size_t i = 0;
+
+			for (; i + 32 <= n; i += 32)
+			{
+				acc0 = _mm512_fmadd_ps(load_bf16(a + i), load_bf16(b + i), acc0);
+				acc1 = _mm512_fmadd_ps(load_bf16(a + i + 16), load_bf16(b + i + 16), acc1);
+			}
+
+			return ops<float>::sum(_mm512_add_ps(acc0, acc1)) + avx2::dot_bf16(a + i, b + i, n - i);
+		}
+
+	#if defined(CPPLAB_TARGET_AVX512_BF16)
+		/* vdpbf16ps multiplies pairs of bf16 values and adds both products to a float lane in one instruction. */
+		CPPLAB_TARGET_AVX512_BF16 inline float dot_bf16_native(const std::uint16_t* a, const std::uint16_t* b, size_t n)
+		{
+			__m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+			size_t i = 0;
+
+			for (; i + 64 <= n; i += 64)
+			{
+				acc0 = _mm512_dpbf16_ps(acc0, (__m512bh)_mm512_loadu_si512(a + i), (__m512bh)_mm512_loadu_si512(b + i));
+				acc1 = _mm512_dpbf16_ps(acc1, (__m512bh)_mm512_loadu_si512(a + i + 32), (__m512bh)_mm512_loadu_si512(b + i + 32));
+			}
+
+			return ops<float>::sum(_mm512_add_ps(acc0, acc1)) + dot_bf16(a + i, b + i, n - i);
+		}
+	#endif
+	}
+#if defined(__GNUC__) && !defined(__clang__)
+	#pragma GCC diagnostic pop
+#endif
+#endif
+
+	/// <summary>Dot product of two int8 arrays, exact (summed in 64 bits).</summary>
+	inline std::int64_t dot_i8(const std::int8_t* a, const std::int8_t* b, size_t n)
+	{
+#if CPPLAB_SIMD_X86
+		switch (active_level())
+		{
+			case level::avx512: return avx512::dot_i8(a, b, n);
+			case level::avx2: return avx2::dot_i8(a, b, n);
+			default: break;
+		}
+#endif
+		return dot_i8_scalar(a, b, n);
+	}
+
+	/// <summary>Dot product of two fp16 arrays, summed in float.</summary>
+	inline float dot_f16(const std::uint16_t* a, const std::uint16_t* b, size_t n)
+	{
+#if CPPLAB_SIMD_X86
+		switch (active_level())
+		{
+			case level::avx512: return avx512::dot_f16(a, b, n);
+			case level::avx2: return avx2::dot_f16(a, b, n);
+			default: break;
+		}
+#endif
+		return dot_f16_scalar(a, b, n);
+	}
+
+	/// <summary>Dot product of two bf16 arrays, summed in float.</summary>
+	inline float dot_bf16(const std::uint16_t* a, const std::uint16_t* b, size_t n)
+	{
+#if CPPLAB_SIMD_X86
+		switch (active_level())
+		{
+			case level::avx512:
+	#if defined(CPPLAB_TARGET_AVX512_BF16)
+				if (has_avx512_bf16())
+					return avx512::dot_bf16_native(a, b, n);
+	#endif
+				return avx512::dot_bf16(a, b, n);
+			case level::avx2: return avx2::dot_bf16(a, b, n);
+			default: break;
+		}
+#endif
+		return dot_bf16_scalar(a, b, n);
+	}
+}
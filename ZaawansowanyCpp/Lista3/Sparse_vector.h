@@ -0,0 +1,307 @@
+// Sparse vector: only the non-zero elements are stored, as pairs of (sorted) indices and values
+
+#pragma once
+
+#include <iostream>
+#include <algorithm>
+#include <cstdint>
+#include <initializer_list>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "Zadanie3_1.h"
+
+
+namespace cpplab
+{
+	template <typename T>
+	class sparse_vector
+	{
+		static_assert(std::is_arithmetic_v<T>, "sparse_vector elements must be numbers");
+
+	  public:
+		using value_type = T;
+		using index_type = std::uint32_t;  // Half the memory traffic of size_t, and what the gather instructions take
+
+		// Indices must fit into a signed 32-bit gather index
+		static constexpr size_t max_size = std::numeric_limits<std::int32_t>::max();
+
+		// Default constructor
+		sparse_vector() {}
+
+		/* Vector of the given dimension with all elements equal to zero. */
+		explicit sparse_vector(size_t size) : _size(check_size(size)) {}
+
+		/* Vector of the given dimension with the listed (index, value) elements, in any order. Listed zeros are not stored. */
+		sparse_vector(size_t size, std::initializer_list<std::pair<size_t, T>> elements)
+			: _size(check_size(size))
+		{
+			std::vector<std::pair<size_t, T>> sorted(elements);
+			std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+			for (size_t k = 0; k < sorted.size(); k++)
+			{
+				const auto& [idx, value] = sorted[k];
+				if (idx >= _size) throw std::range_error("Provided index is out of bounds");
+				if (k > 0 && sorted[k - 1].first == idx) throw std::invalid_argument("Every index can be given only once");
+
+				if (value != T())
+					push_back(idx, value);
+			}
+		}
+
+		/* Sparse copy of a dense vector, zeros are dropped. */
+		template <typename V> requires (!std::is_same_v<V, sparse_vector<T>>) && IsVector<V>
+		explicit sparse_vector(const V& dense)
+			: _size(check_size(dense.size()))
+		{
+			for (size_t i = 0; i < _size; i++)
+			{
+				T value;
+				if constexpr (IsContiguousVector<V>)
+					value = static_cast<T>(dense.data()[i]);
+				else
+					value = static_cast<T>(dense[i]);
+
+				if (value != T())
+					push_back(i, value);
+			}
+		}
+
+
+		/* Dimension of the vector (counting the zeros). */
+		size_t size() const { return _size; }
+
+		/* Number of stored (non-zero) elements. */
+		size_t nnz() const { return _indices.size(); }
+
+		std::span<const index_type> indices() const { return _indices; }
+		std::span<const T> values() const { return _values; }
+
+		/* Element with the given index, found with a binary search. Zero when it is not stored. */
+		T operator[](size_t idx) const
+		{
+			auto it = std::lower_bound(_indices.begin(), _indices.end(), idx);
+			if (it == _indices.end() || *it != idx)
+				return T();
+
+			return _values[it - _indices.begin()];
+		}
+
+		T at(size_t idx) const
+		{
+			if (idx >= _size) throw std::range_error("Provided index is out of bounds");
+			return (*this)[idx];
+		}
+
+		/* Sets the element with the given index, storing zero removes it. Cheap when idx is above every stored index. */
+		void set(size_t idx, T value)
+		{
+			if (idx >= _size) throw std::range_error("Provided index is out of bounds");
+
+			auto it = std::lower_bound(_indices.begin(), _indices.end(), idx);
+			size_t pos = it - _indices.begin();
+
+			if (it != _indices.end() && *it == idx)
+			{
+				if (value != T())
+				{
+					_values[pos] = value;
+				}
+				else
+				{
+					_indices.erase(it);
+					_values.erase(_values.begin() + pos);
+				}
+			}
+			else if (value != T())
+			{
+				_indices.insert(it, static_cast<index_type>(idx));
+				_values.insert(_values.begin() + pos, value);
+			}
+		}
+
+		/* Dense copy of the vector. */
+		vector<T> to_dense() const
+		{
+			vector<T> result(_size, T());
+			T* out = result.data();
+			for (size_t k = 0; k < _indices.size(); k++)
+				out[_indices[k]] = _values[k];
+
+			return result;
+		}
+
+		friend std::ostream& operator<<(std::ostream& out, const sparse_vector& vec)
+		{
+			out << "{size=" << vec._size << ":";
+			for (size_t k = 0; k < vec.nnz(); k++)
+				out << (k > 0 ? ", " : " ") << vec._indices[k] << "->" << vec._values[k];
+			out << "}";
+
+			return out;
+		}
+
+	  private:
+		static size_t check_size(size_t size)
+		{
+			if (size > max_size) throw std::length_error("sparse_vector dimension must fit into 31 bits");
+			return size;
+		}
+
+		/* Appends an element whose index is above every stored index. */
+		void push_back(size_t idx, T value)
+		{
+			_indices.push_back(static_cast<index_type>(idx));
+			_values.push_back(value);
+		}
+
+		size_t _size = 0;
+		std::vector<index_type> _indices;
+		std::vector<T> _values;
+	};
+
+	template <typename T>
+	struct is_sparse_vector : std::false_type {};
+
+	template <typename T>
+	struct is_sparse_vector<sparse_vector<T>> : std::true_type {};
+
+	namespace detail
+	{
+		constexpr size_t gallop_ratio = 32;  // Above this ratio of stored elements the longer vector is searched instead of merged
+
+		/* Sparse-dense dot product, only the dense elements at the stored indices are read. */
+		template <typename Acc, typename T, typename V>
+		Acc sparse_dense_dot(const sparse_vector<T>& s, const V& dense)
+		{
+			if (s.size() != dense.size()) throw std::runtime_error("Vectors must be the same size");
+
+			auto indices = s.indices();
+			auto values = s.values();
+
+			if constexpr (IsContiguousVector<V>)
+			{
+				return simd::dot_gather_as<Acc>(values.data(), indices.data(), dense.data(), indices.size());
+			}
+			else
+			{
+				Acc result = Acc();
+				for (size_t k = 0; k < indices.size(); k++)
+					result += static_cast<Acc>(values[k]) * static_cast<Acc>(dense[indices[k]]);
+
+				return result;
+			}
+		}
+
+		/* First position in [first, last) whose index is not below idx: the step doubles until it overshoots, then a binary search. */
+		inline const std::uint32_t* gallop(const std::uint32_t* first, const std::uint32_t* last, std::uint32_t idx)
+		{
+			size_t step = 1;
+			while (step < static_cast<size_t>(last - first) && first[step] < idx)
+			{
+				first += step;
+				step *= 2;
+			}
+
+			return std::lower_bound(first, first + std::min(step + 1, static_cast<size_t>(last - first)), idx);
+		}
+
+		/// <summary>
+		/// Sparse-sparse dot product, only the indices stored in both vectors contribute. Vectors with similar numbers of
+		/// elements are merged in one pass. When one is much longer, every index of the shorter one is searched for
+		/// in the longer one with galloping (exponential) search, which skips the long runs that cannot match.
+		/// </summary>
+		template <typename Acc, typename T, typename U>
+		Acc sparse_sparse_dot(const sparse_vector<T>& a, const sparse_vector<U>& b)
+		{
+			if (a.size() != b.size()) throw std::runtime_error("Vectors must be the same size");
+
+			if (a.nnz() > b.nnz())
+				return sparse_sparse_dot<Acc>(b, a);
+
+			const std::uint32_t* ai = a.indices().data();
+			const std::uint32_t* bi = b.indices().data();
+			const T* av = a.values().data();
+			const U* bv = b.values().data();
+			size_t na = a.nnz(), nb = b.nnz();
+
+			Acc result = Acc();
+
+			if (nb > gallop_ratio * na)
+			{
+				const std::uint32_t* pos = bi;
+				const std::uint32_t* end = bi + nb;
+				for (size_t i = 0; i < na && pos != end; i++)
+				{
+					pos = gallop(pos, end, ai[i]);
+					if (pos != end && *pos == ai[i])
+						result += static_cast<Acc>(av[i]) * static_cast<Acc>(bv[pos - bi]);
+				}
+
+				return result;
+			}
+
+			size_t i = 0, j = 0;
+			while (i < na && j < nb)
+			{
+				std::uint32_t x = ai[i], y = bi[j];
+				if (x == y)
+					result += static_cast<Acc>(av[i]) * static_cast<Acc>(bv[j]);
+
+				// Both sides move when the indices are equal, without a branch that is hard to predict
+				i += x <= y;
+				j += y <= x;
+			}
+
+			return result;
+		}
+	}
+
+	/// <summary>Dot product of a sparse and a dense vector, O(number of stored elements).</summary>
+	template <typename Policy = accumulate::natural, typename T, IsVector U> requires (!is_sparse_vector<U>::value)
+	auto dot(const sparse_vector<T>& s, const U& dense)
+	{
+		using Acc = typename Policy::template accumulator<T, typename U::value_type>;
+		return Policy::template finish<T, typename U::value_type>(detail::sparse_dense_dot<Acc>(s, dense));
+	}
+
+	template <typename Policy = accumulate::natural, IsVector V, typename T> requires (!is_sparse_vector<V>::value)
+	auto dot(const V& dense, const sparse_vector<T>& s)
+	{
+		using Acc = typename Policy::template accumulator<typename V::value_type, T>;
+		return Policy::template finish<typename V::value_type, T>(detail::sparse_dense_dot<Acc>(s, dense));
+	}
+
+	/// <summary>Dot product of two sparse vectors, see detail::sparse_sparse_dot.</summary>
+	template <typename Policy = accumulate::natural, typename T, typename U>
+	auto dot(const sparse_vector<T>& a, const sparse_vector<U>& b)
+	{
+		using Acc = typename Policy::template accumulator<T, U>;
+		return Policy::template finish<T, U>(detail::sparse_sparse_dot<Acc>(a, b));
+	}
+}
+
+
+int sparse_vector_demo()
+{
+	using cpplab::operator*;
+
+	cpplab::sparse_vector<double> s(10, { { 7, 2.0 }, { 1, 0.5 }, { 4, -1.0 } });
+	cpplab::vector<double> d = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 };
+	std::vector<int> dense_ints = { 0, 0, 3, 0, 5, 0, 0, 1, 0, 0 };
+	cpplab::sparse_vector<int> t(dense_ints);
+
+	std::cout << "s = " << s << "\n";
+	std::cout << "t = " << t << "\n";
+	std::cout << "s.to_dense() = " << s.to_dense() << "\n";
+	std::cout << "s * d = " << s * d << "\n";
+	std::cout << "d * s = " << d * s << "\n";
+	std::cout << "s * t = " << s * t << "\n";
+
+
+	return 0;
+}
@@ -0,0 +1,162 @@
+// Fixed-size pool of worker threads
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+
+namespace cpplab
+{
+	class thread_pool
+	{
+	  private:
+		std::vector<std::thread> workers;
+		std::queue<std::function<void()>> tasks;
+		std::mutex mutex;
+		std::condition_variable wake_up;
+		bool stopping = false;
+
+	  public:
+		explicit thread_pool(size_t threads = std::max(1u, std::thread::hardware_concurrency()))
+		{
+			for (size_t i = 0; i < threads; i++)
+				workers.emplace_back([this]() { work(); });
+		}
+
+		thread_pool(const thread_pool&) = delete;
+		thread_pool& operator=(const thread_pool&) = delete;
+
+		/* Finishes the queued tasks and joins the workers. */
+		~thread_pool()
+		{
+			{
+				std::lock_guard lock(mutex);
+				stopping = true;
+			}
+			wake_up.notify_all();
+
+			for (auto& worker : workers)
+				worker.join();
+		}
+
+		size_t size() const { return workers.size(); }
+
+		/* Pool shared by the whole program, created on first use with one thread per hardware thread. */
+		static thread_pool& shared()
+		{
+			static thread_pool pool;
+			return pool;
+		}
+
+		/* Queues a task, its result (or exception) can be collected from the returned future. */
+		template <typename F>
+		auto submit(F&& f) -> std::future<std::invoke_result_t<F>>
+		{
+			using Result = std::invoke_result_t<F>;
+
+			auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(f));
+			std::future<Result> result = task->get_future();
+			post([task]() { (*task)(); });
+
+			return result;
+		}
+
+		/// <summary>
+		/// Calls f(i) for every i in [0, count) and waits until all calls are done. The calling thread takes part in the work
+		/// and waits only for calls that are already running, never for queued helpers, so it can be nested inside a pool task.
+		/// The first exception thrown by f is rethrown.
+		/// </summary>
+		template <typename F>
+		void parallel_for(size_t count, F&& f)
+		{
+			if (count == 0)
+				return;
+
+			// A helper may start after the call has returned, so the loop state is shared and f is used only while calls are left
+			struct loop_state
+			{
+				std::atomic<size_t> next = 0;
+				size_t finished = 0;
+				std::exception_ptr error;
+				std::mutex mutex;
+				std::condition_variable all_finished;
+			};
+			auto state = std::make_shared<loop_state>();
+
+			auto run = [state, count, &f]()
+				{
+					for (size_t i = state->next++; i < count; i = state->next++)
+					{
+						std::exception_ptr error;
+						try
+						{
+							f(i);
+						}
+						catch (...)
+						{
+							error = std::current_exception();
+						}
+
+						std::lock_guard lock(state->mutex);
+						if (error && !state->error)
+							state->error = error;
+						if (++state->finished == count)
+							state->all_finished.notify_all();
+					}
+				};
+
+			size_t helper_count = std::min(size(), count - 1);
+			for (size_t i = 0; i < helper_count; i++)
+				post(run);
+
+			run();
+
+			std::unique_lock lock(state->mutex);
+			state->all_finished.wait(lock, [&]() { return state->finished == count; });
+
+			if (state->error)
+				std::rethrow_exception(state->error);
+		}
+
+	  private:
+		void post(std::function<void()> task)
+		{
+			{
+				std::lock_guard lock(mutex);
+				tasks.push(std::move(task));
+			}
+			wake_up.notify_one();
+		}
+
+		void work()
+		{
+			while (true)
+			{
+				std::function<void()> task;
+				{
+					std::unique_lock lock(mutex);
+					wake_up.wait(lock, [this]() { return stopping || !tasks.empty(); });
+
+					if (stopping && tasks.empty())
+						return;
+
+					task = std::move(tasks.front());
+					tasks.pop();
+				}
+
+				task();
+			}
+		}
+	};
+}
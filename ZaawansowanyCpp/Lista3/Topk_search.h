@@ -0,0 +1,293 @@
+// Brute-force top-k search: finds the rows of a collection with the largest dot products with a query
+
+#pragma once
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <functional>
+#include <random>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#include "Zadanie3_1.h"
+#include "Matrix.h"
+#include "Thread_pool.h"
+#include "../Common/Bench_timer.h"
+
+
+namespace cpplab
+{
+	template <typename Score>
+	struct search_hit
+	{
+		size_t index;  // Position of the row in the collection
+		Score score;   // Dot product of the row with the query
+
+		// Better hits come first: higher score, and the lower index on a tie so that results do not depend on threading
+		friend bool operator<(const search_hit& a, const search_hit& b)
+		{
+			return a.score > b.score || (a.score == b.score && a.index < b.index);
+		}
+	};
+
+	namespace detail
+	{
+		/* At most k best hits seen so far. The worst of them sits on top of the heap, so a new hit is rejected by one comparison. */
+		template <typename Score>
+		class bounded_heap
+		{
+		  public:
+			explicit bounded_heap(size_t k) : k(k) { hits.reserve(k); }
+
+			void push(size_t index, Score score)
+			{
+				search_hit<Score> hit{ index, score };
+
+				if (hits.size() < k)
+				{
+					hits.push_back(hit);
+					std::push_heap(hits.begin(), hits.end());
+				}
+				else if (k > 0 && hit < hits.front())
+				{
+					std::pop_heap(hits.begin(), hits.end());
+					hits.back() = hit;
+					std::push_heap(hits.begin(), hits.end());
+				}
+			}
+
+			const std::vector<search_hit<Score>>& contents() const { return hits; }
+
+		  private:
+			size_t k;
+			std::vector<search_hit<Score>> hits;  // Max-heap by operator<, i.e. the worst hit on top
+		};
+	}
+
+	/// <summary>
+	/// Collection of vectors of the same dimension, kept one after another in a single block of memory,
+	/// which answers "which k rows have the largest dot product with this query" by scoring every row.
+	/// </summary>
+	template <typename T = float>
+	class flat_index
+	{
+		static_assert(std::is_arithmetic_v<T>, "flat_index elements must be numbers");
+
+	  public:
+		using value_type = T;
+		using score_type = decltype(std::declval<T>() * std::declval<T>());
+		using hit = search_hit<score_type>;
+
+		static constexpr size_t block_bytes = 128 * 1024;  // Rows scored against all queries of a batch before moving on, about the size of L2
+
+		explicit flat_index(size_t dimensions) : _dimensions(dimensions)
+		{
+			if (dimensions == 0) throw std::invalid_argument("Vectors must have at least one dimension");
+		}
+
+		size_t dimensions() const { return _dimensions; }
+		size_t size() const { return _data.size() / _dimensions; }
+
+		void reserve(size_t rows) { _data.reserve(rows * _dimensions); }
+
+		/* Appends a copy of the vector, its index is the previous size(). */
+		template <IsVector V>
+		void add(const V& row)
+		{
+			if (row.size() != _dimensions) throw std::runtime_error("Vectors must be the same size");
+
+			for (size_t i = 0; i < _dimensions; i++)
+				_data.push_back(static_cast<T>(row[i]));
+		}
+
+		std::span<const T> row(size_t idx) const { return { _data.data() + idx * _dimensions, _dimensions }; }
+
+		/* The k best rows for the query, best first. */
+		template <IsVector V>
+		std::vector<hit> search(const V& query, size_t k, thread_pool& pool = thread_pool::shared()) const
+		{
+			return std::move(search_batch(std::vector<std::vector<T>>{ to_row(query) }, k, pool)[0]);
+		}
+
+		/// <summary>
+		/// The k best rows for every query of the batch. Each block of rows is scored against all the queries while it
+		/// is in cache, by the same four-rows-at-a-time kernel as gemv(). Runs of blocks are split into tasks for the threads
+		/// of the pool, every task keeps its own bounded heap per query (no locking), and the heaps are merged at the end.
+		/// </summary>
+		template <typename Queries>
+			requires std::ranges::random_access_range<Queries> && IsVector<std::ranges::range_value_t<Queries>>
+		std::vector<std::vector<hit>> search_batch(const Queries& queries, size_t k, thread_pool& pool = thread_pool::shared()) const
+		{
+			// Queries are copied into one contiguous block of the collection's element type
+			const size_t query_count = std::ranges::size(queries);
+			std::vector<T> query_data;
+			query_data.reserve(query_count * _dimensions);
+			for (const auto& query : queries)
+			{
+				std::vector<T> q = to_row(query);
+				query_data.insert(query_data.end(), q.begin(), q.end());
+			}
+
+			const size_t rows = size();
+			const size_t rows_per_block = std::max<size_t>(4, block_bytes / (_dimensions * sizeof(T)) / 4 * 4);
+			const size_t blocks = (rows + rows_per_block - 1) / rows_per_block;
+
+			// A few tasks per thread, each a run of whole blocks
+			const size_t tasks = std::max<size_t>(1, std::min(blocks, 4 * pool.size()));
+			const size_t blocks_per_task = (blocks + tasks - 1) / std::max<size_t>(1, tasks);
+
+			std::vector<std::vector<detail::bounded_heap<score_type>>> heaps(tasks);
+			auto row_at = [&](size_t r) { return _data.data() + r * _dimensions; };
+
+			auto run = [&](size_t task)
+				{
+					auto& task_heaps = heaps[task];
+					task_heaps.assign(query_count, detail::bounded_heap<score_type>(k));
+					std::vector<score_type> scores(rows_per_block);
+
+					for (size_t b = task * blocks_per_task; b < std::min(blocks, (task + 1) * blocks_per_task); b++)
+					{
+						size_t first = b * rows_per_block;
+						size_t last = std::min(rows, first + rows_per_block);
+
+						for (size_t q = 0; q < query_count; q++)
+						{
+							std::fill(scores.begin(), scores.end(), score_type());
+							detail::dot_rows<score_type, T>(first, last, row_at, query_data.data() + q * _dimensions, 0, _dimensions, scores.data());
+
+							for (size_t r = first; r < last; r++)
+								task_heaps[q].push(r, scores[r - first]);
+						}
+					}
+				};
+
+			if (tasks == 1 || rows * _dimensions * query_count < parallel_threshold)
+			{
+				for (size_t task = 0; task < tasks; task++)
+					run(task);
+			}
+			else
+			{
+				pool.parallel_for(tasks, run);
+			}
+
+			// Merge: the best k of all the per-thread candidates
+			std::vector<std::vector<hit>> results(query_count);
+			for (size_t q = 0; q < query_count; q++)
+			{
+				for (const auto& task_heaps : heaps)
+				{
+					if (!task_heaps.empty())
+						results[q].insert(results[q].end(), task_heaps[q].contents().begin(), task_heaps[q].contents().end());
+				}
+
+				size_t best = std::min(k, results[q].size());
+				std::partial_sort(results[q].begin(), results[q].begin() + best, results[q].end());
+				results[q].resize(best);
+			}
+
+			return results;
+		}
+
+	  private:
+		template <IsVector V>
+		std::vector<T> to_row(const V& query) const
+		{
+			if (query.size() != _dimensions) throw std::runtime_error("Vectors must be the same size");
+
+			std::vector<T> result(_dimensions);
+			for (size_t i = 0; i < _dimensions; i++)
+				result[i] = static_cast<T>(query[i]);
+
+			return result;
+		}
+
+		size_t _dimensions;
+		std::vector<T> _data;
+	};
+}
+
+
+int topk_search_demo()
+{
+	cpplab::flat_index<float> index(3);
+	index.add(std::vector<float>{ 1, 0, 0 });
+	index.add(std::vector<float>{ 0, 1, 0 });
+	index.add(std::vector<float>{ 0.7f, 0.7f, 0 });
+	index.add(std::vector<float>{ -1, 0, 0 });
+
+	for (const auto& hit : index.search(std::vector<float>{ 1, 0.5f, 0 }, 2))
+		std::cout << "row " << hit.index << ": " << hit.score << "\n";
+
+
+	return 0;
+}
+
+/// <summary>
+/// Latency (one query) and throughput (batches of queries) of flat_index, compared with calling
+/// operator* for every row and sorting the scores, for collections of growing size.
+/// </summary>
+int topk_search_benchmark()
+{
+	using cpplab::operator*;
+	using clock = cpplab::bench::clock;
+	using cpplab::bench::ms_since;
+
+	const size_t dimensions = 128, k = 10, batch = 64;
+	std::mt19937 generator(7);
+	std::normal_distribution<float> normal(0.0f, 1.0f);
+
+	auto random_vector = [&]()
+		{
+			std::vector<float> v(dimensions);
+			std::generate(v.begin(), v.end(), [&]() { return normal(generator); });
+			return v;
+		};
+
+	std::vector<std::vector<float>> queries(batch);
+	std::generate(queries.begin(), queries.end(), random_vector);
+
+	std::cout << std::fixed << std::setprecision(3);
+	std::cout << "top-" << k << " of " << dimensions << "-dimensional float vectors, " << cpplab::thread_pool::shared().size() << " threads\n";
+
+	for (size_t rows : { 10'000, 100'000, 1'000'000 })
+	{
+		cpplab::flat_index<float> index(dimensions);
+		std::vector<std::vector<float>> separate;  // The old way: one vector per row
+		index.reserve(rows);
+		for (size_t i = 0; i < rows; i++)
+		{
+			separate.push_back(random_vector());
+			index.add(separate.back());
+		}
+
+		// Baseline: operator* per row, then a partial sort of all the scores
+		auto start = clock::now();
+		std::vector<std::pair<float, size_t>> scored(rows);
+		for (size_t i = 0; i < rows; i++)
+			scored[i] = { -(queries[0] * separate[i]), i };
+		std::partial_sort(scored.begin(), scored.begin() + k, scored.end());
+		double baseline_ms = ms_since(start);
+
+		start = clock::now();
+		auto hits = index.search(queries[0], k);
+		double latency_ms = ms_since(start);
+
+		start = clock::now();
+		auto batch_hits = index.search_batch(queries, k);
+		double batch_ms = ms_since(start);
+
+		bool same = hits.size() == k && hits[0].index == scored[0].second && batch_hits[0][0].index == scored[0].second;
+
+		std::cout << std::setw(9) << rows << " rows: operator* loop " << baseline_ms << " ms/query, "
+			<< "search " << latency_ms << " ms/query, "
+			<< "batch of " << batch << ": " << batch / (batch_ms / 1000) << " queries/s"
+			<< (same ? "" : " (RESULTS DIFFER)") << "\n";
+	}
+
+
+	return 0;
+}
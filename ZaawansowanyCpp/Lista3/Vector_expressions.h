@@ -0,0 +1,201 @@
+// Lazy element-wise arithmetic on IsVector types (expression templates).
+// a + b - 2.0 * c does not create any temporary vectors: it builds a small tree of expression nodes which is evaluated
+// element by element in a single loop when it is assigned to a cpplab::vector (or reduced with operator*).
+
+#pragma once
+
+#include <iostream>
+#include <type_traits>
+#include <stdexcept>
+
+#include "Zadanie3_1.h"
+
+
+namespace cpplab
+{
+	namespace expr
+	{
+		/* Leaf of the expression tree, refers to a vector. Contiguous vectors are read straight through a pointer. */
+		template <IsVector V>
+		class leaf : public node
+		{
+		  public:
+			using value_type = typename V::value_type;
+
+			explicit leaf(const V& vec) : vec(&vec), ptr(nullptr)
+			{
+				if constexpr (IsContiguousVector<V>)
+					ptr = vec.data();
+			}
+
+			size_t size() const { return vec->size(); }
+
+			value_type operator[](size_t idx) const
+			{
+				if constexpr (IsContiguousVector<V>)
+					return ptr[idx];
+				else
+					return (*vec)[idx];
+			}
+
+		  private:
+			const V* vec;
+			const value_type* ptr;
+		};
+
+		/* Nodes are stored by value inside their parents, containers are wrapped into a leaf. */
+		template <typename E>
+		auto wrap(const E& e)
+		{
+			if constexpr (IsNode<E>)
+				return e;
+			else
+				return leaf<E>(e);
+		}
+
+		template <typename E>
+		using wrapped = decltype(wrap(std::declval<const E&>()));
+
+		/* Element-wise operation on two vectors of the same size. */
+		template <typename L, typename R, typename Op>
+		class binary : public node
+		{
+		  public:
+			using value_type = decltype(Op()(std::declval<typename L::value_type>(), std::declval<typename R::value_type>()));
+
+			binary(const L& l, const R& r) : l(l), r(r)
+			{
+				if (l.size() != r.size()) throw std::runtime_error("Vectors must be the same size");
+			}
+
+			size_t size() const { return l.size(); }
+			value_type operator[](size_t idx) const { return Op()(l[idx], r[idx]); }
+
+		  private:
+			L l;
+			R r;
+		};
+
+		/* Operation between every element of a vector and the same scalar. */
+		template <typename E, typename S, typename Op>
+		class scalar_op : public node
+		{
+		  public:
+			using value_type = decltype(Op()(std::declval<typename E::value_type>(), std::declval<S>()));
+
+			scalar_op(const E& e, S s) : e(e), s(s) {}
+
+			size_t size() const { return e.size(); }
+			value_type operator[](size_t idx) const { return Op()(e[idx], s); }
+
+		  private:
+			E e;
+			S s;
+		};
+
+		template <typename E>
+		class negate : public node
+		{
+		  public:
+			using value_type = decltype(-std::declval<typename E::value_type>());
+
+			explicit negate(const E& e) : e(e) {}
+
+			size_t size() const { return e.size(); }
+			value_type operator[](size_t idx) const { return -e[idx]; }
+
+		  private:
+			E e;
+		};
+
+		struct plus { auto operator()(const auto& a, const auto& b) const { return a + b; } };
+		struct minus { auto operator()(const auto& a, const auto& b) const { return a - b; } };
+		struct multiplies { auto operator()(const auto& a, const auto& b) const { return a * b; } };
+		struct divides { auto operator()(const auto& a, const auto& b) const { return a / b; } };
+	}
+
+	// Operator * between two vectors stays the scalar product (see Zadanie3_1.h), it also accepts expressions,
+	// so (a - b) * (a - b) is computed in one pass. The element-wise product is called hadamard().
+
+	template <IsVector V, IsVector U>
+	auto operator+(const V& v, const U& u)
+	{
+		return expr::binary<expr::wrapped<V>, expr::wrapped<U>, expr::plus>(expr::wrap(v), expr::wrap(u));
+	}
+
+	template <IsVector V, IsVector U>
+	auto operator-(const V& v, const U& u)
+	{
+		return expr::binary<expr::wrapped<V>, expr::wrapped<U>, expr::minus>(expr::wrap(v), expr::wrap(u));
+	}
+
+	template <IsVector V>
+	auto operator-(const V& v)
+	{
+		return expr::negate<expr::wrapped<V>>(expr::wrap(v));
+	}
+
+	/* Element-wise product of two vectors. */
+	template <IsVector V, IsVector U>
+	auto hadamard(const V& v, const U& u)
+	{
+		return expr::binary<expr::wrapped<V>, expr::wrapped<U>, expr::multiplies>(expr::wrap(v), expr::wrap(u));
+	}
+
+	template <IsVector V, typename S> requires std::is_arithmetic_v<S>
+	auto operator*(const V& v, S s)
+	{
+		return expr::scalar_op<expr::wrapped<V>, S, expr::multiplies>(expr::wrap(v), s);
+	}
+
+	template <typename S, IsVector V> requires std::is_arithmetic_v<S>
+	auto operator*(S s, const V& v)
+	{
+		return v * s;
+	}
+
+	template <IsVector V, typename S> requires std::is_arithmetic_v<S>
+	auto operator/(const V& v, S s)
+	{
+		return expr::scalar_op<expr::wrapped<V>, S, expr::divides>(expr::wrap(v), s);
+	}
+
+	namespace expr
+	{
+		// Lets argument-dependent lookup find the operators for expressions built only from std::vector
+		using cpplab::operator+;
+		using cpplab::operator-;
+		using cpplab::operator*;
+		using cpplab::operator/;
+	}
+}
+
+
+int vector_expressions_demo()
+{
+	using cpplab::operator*;
+
+	cpplab::vector<double> a = { 1, 2, 3, 4 };
+	cpplab::vector<double> b = { 0.5, 0.5, 0.5, 0.5 };
+	cpplab::vector<int> c = { 1, 2, 3, 4 };
+	std::vector<double> d = { 4, 3, 2, 1 };
+
+	// Evaluated in a single loop while constructing e, no temporary vectors are created
+	cpplab::vector<double> e = a + hadamard(b, c) - 2.0 * d;
+	std::cout << "a + hadamard(b, c) - 2.0 * d = " << e << "\n";
+
+	e = -(e / 2.0);
+	std::cout << "-(e / 2.0) = " << e << "\n";
+
+	// Squared distance, the differences are never stored
+	std::cout << "(a - b) * (a - b) = " << (a - b) * (a - b) << "\n";
+
+	// The right-hand side reads m while it is assigned to m
+	cpplab::vector<bool> m = { true, false, true, true };
+	cpplab::vector<bool> x = { true, true, false, true };
+	m = hadamard(m, x);
+	std::cout << "m = hadamard(m, x) = " << m << "\n";
+
+
+	return 0;
+}
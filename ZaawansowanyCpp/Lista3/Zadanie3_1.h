@@ -2,7 +2,14 @@
 
 #include <iostream>
 #include <vector>
+#include <algorithm>
+#include <bit>
+#include <cstdint>
 #include <type_traits>
+#include <concepts>
+
+#include "Simd_dot.h"
+#include "Accumulators.h"
 
 
 template <typename T>
@@ -23,9 +30,25 @@ concept IsValueTypeNumeric = std::is_arithmetic<typename T::value_type>::value;
 template <typename T>
 concept IsVector = HasSubscriptOperator<T> && HasSizeMethod<T> && IsValueTypeNumeric<T>;
 
+// Vector whose elements lie next to each other in memory and can be reached through data()
+template <typename T>
+concept IsContiguousVector = IsVector<T> && requires (const T a)
+{
+	{ a.data() } -> std::convertible_to<const typename T::value_type*>;
+};
+
 // Wektor z listy 1
 namespace cpplab {
 
+	namespace expr
+	{
+		// Base class of every expression node from Vector_expressions.h (used only to tell nodes apart from containers)
+		struct node {};
+
+		template <typename T>
+		concept IsNode = std::is_base_of_v<node, T>;
+	}
+
 	template <typename T>
 	class vector
 	{
@@ -37,23 +60,23 @@ namespace cpplab {
 		vector(std::initializer_list<T> list)
 			: _size(list.size()), _capacity(list.size())
 		{
-			data = new T[_capacity];
+			_data = new T[_capacity];
 
 			size_t idx = 0;
 			for (const T& elem : list)
 			{
-				data[idx++] = elem;
+				_data[idx++] = elem;
 			}
 		}
 
 		vector(size_t size, T default_value)
 			: _size(size), _capacity(size)
 		{
-			data = new T[_capacity];
+			_data = new T[_capacity];
 
 			for (size_t i = 0; i < _size; i++)
 			{
-				data[i] = default_value;
+				_data[i] = default_value;
 			}
 		}
 
@@ -63,11 +86,11 @@ namespace cpplab {
 		{
 			std::cout << "Used my copy constructor\n";
 
-			data = new T[_capacity];
+			_data = new T[_capacity];
 
 			for (size_t i = 0; i < _size; i++)
 			{
-				data[i] = vec[i];
+				_data[i] = vec[i];
 			}
 		}
 
@@ -78,14 +101,28 @@ namespace cpplab {
 
 			_size = vec._size;
 			_capacity = vec._capacity;
-			data = vec.data;
+			_data = vec._data;
 
 			vec._size = 0;
 			vec._capacity = 0;
-			vec.data = nullptr;
+			vec._data = nullptr;
 		}
 
-		~vector() { delete[] data; }
+		// Converting constructor from any other IsVector (e.g. std::vector or a lazy vector expression, which is evaluated here in one loop),
+		// implicit only for expressions so that vector<double> e = a + b works
+		template <typename V> requires (!std::is_same_v<V, vector<T>>) && IsVector<V>
+		explicit(!expr::IsNode<V>) vector(const V& vec)
+			: _size(vec.size()), _capacity(vec.size())
+		{
+			_data = new T[_capacity];
+
+			for (size_t i = 0; i < _size; i++)
+			{
+				_data[i] = static_cast<T>(vec[i]);
+			}
+		}
+
+		~vector() { delete[] _data; }
 
 
 		using value_type = T;
@@ -94,16 +131,19 @@ namespace cpplab {
 		size_t capacity() const { return _capacity; }
 		bool empty() const { return _size == 0; }
 
+		T* data() { return _data; }
+		const T* data() const { return _data; }
+
 		T at(size_t idx) const
 		{
 			if (idx < 0 || idx >= _size) throw std::range_error("Provided index is out of bounds");
-			return data[idx];
+			return _data[idx];
 		}
 
 		T& at(size_t idx)
 		{
 			if (idx < 0 || idx >= _size) throw std::range_error("Provided index is out of bounds");
-			return data[idx];
+			return _data[idx];
 		}
 
 		void resize(size_t new_size)
@@ -118,7 +158,7 @@ namespace cpplab {
 
 				for (size_t i = _size; i < new_size; i++)
 				{
-					data[i] = 0;
+					_data[i] = 0;
 				}
 				_size = new_size;
 				return;
@@ -139,15 +179,15 @@ namespace cpplab {
 			for (size_t i = 0; i < new_capacity; i++)
 			{
 				if (i < _size)
-					tmp[i] = data[i];
+					tmp[i] = _data[i];
 				else
 					tmp[i] = 0;
 			}
 
 			_capacity = new_capacity;
 
-			delete[] data;
-			data = tmp;
+			delete[] _data;
+			_data = tmp;
 		}
 
 		void pop_back()
@@ -164,18 +204,18 @@ namespace cpplab {
 				if (empty())
 				{
 					resize(1);
-					data[0] = value;
+					_data[0] = value;
 				}
 				else
 				{
 					reserve(2 * _size);
-					data[_size] = value;
+					_data[_size] = value;
 					_size++;
 				}
 			}
 			else
 			{
-				data[_size] = value;
+				_data[_size] = value;
 				_size++;
 			}
 		}
@@ -195,15 +235,31 @@ namespace cpplab {
 				return *this;
 			}
 
+			if (vec._size <= _capacity)
+			{
+				// The copy fits, so the memory is reused (slots past the size are kept zeroed, as resize() leaves them)
+				for (size_t i = 0; i < vec._size; i++)
+				{
+					_data[i] = vec[i];
+				}
+				for (size_t i = vec._size; i < _size; i++)
+				{
+					_data[i] = 0;
+				}
+
+				_size = vec._size;
+				return *this;
+			}
+
 			_size = vec._size;
 			_capacity = vec._capacity;
 
-			delete[] data;
-			data = new T[_capacity];
+			delete[] _data;
+			_data = new T[_capacity];
 
 			for (size_t i = 0; i < _size; i++)
 			{
-				data[i] = vec[i];
+				_data[i] = vec[i];
 			}
 
 			return *this;
@@ -222,12 +278,41 @@ namespace cpplab {
 			_size = vec._size;
 			_capacity = vec._capacity;
 
-			delete[] data;
-			data = vec.data;
+			delete[] _data;
+			_data = vec._data;
 
 			vec._size = 0;
 			vec._capacity = 0;
-			vec.data = nullptr;
+			vec._data = nullptr;
+
+			return *this;
+		}
+
+		// Assignment from any other IsVector, the elements are evaluated straight into this vector's memory
+		template <typename V> requires (!std::is_same_v<V, vector<T>>) && IsVector<V>
+		vector& operator=(const V& vec)
+		{
+			if (vec.size() == _size)
+			{
+				// Element i of an element-wise expression only reads element i of its operands, so a = a + b is safe in place
+				for (size_t i = 0; i < _size; i++)
+				{
+					_data[i] = static_cast<T>(vec[i]);
+				}
+
+				return *this;
+			}
+
+			T* tmp = new T[vec.size()];
+			for (size_t i = 0; i < vec.size(); i++)
+			{
+				tmp[i] = static_cast<T>(vec[i]);
+			}
+
+			delete[] _data;
+			_data = tmp;
+			_size = vec.size();
+			_capacity = vec.size();
 
 			return *this;
 		}
@@ -253,30 +338,460 @@ namespace cpplab {
 
 		void print_info() const
 		{
-			std::cout << "size=" << _size << "; capacity=" << _capacity << "; data=" << *this;
+			std::cout << "size=" << _size << "; capacity=" << _capacity << "; _data=" << *this;
 		}
 
 	private:
 		size_t _size = 0;
 		size_t _capacity = 0;
-		T* data = nullptr;
+		T* _data = nullptr;
 	};
 
-	// Scalar multiplacation operator
-	template <IsVector V, IsVector U>
-	auto operator*(const V& v, const U& u)
+	/// <summary>
+	/// Vector of bools packed 64 to a word, one bit per element instead of a byte (32x less memory than a vector of int).
+	/// Elements are reached through a proxy reference, like in std::vector&lt;bool&gt;. The bit operations, count() and
+	/// the dot products work on whole words. Bits past size() are always zero, so no word loop needs a special last step.
+	/// </summary>
+	template <>
+	class vector<bool>
+	{
+	public:
+		using value_type = bool;
+		using word_type = std::uint64_t;
+
+		static constexpr size_t word_bits = 64;
+
+		// Proxy for one bit, returned by the non-const operator[] and at()
+		class reference
+		{
+		public:
+			reference(word_type& word, word_type mask) : _word(word), _mask(mask) {}
+
+			reference& operator=(bool value)
+			{
+				if (value)
+					_word |= _mask;
+				else
+					_word &= ~_mask;
+
+				return *this;
+			}
+
+			reference& operator=(const reference& other) { return *this = static_cast<bool>(other); }
+
+			operator bool() const { return (_word & _mask) != 0; }
+
+			void flip() { _word ^= _mask; }
+
+		private:
+			word_type& _word;
+			word_type _mask;
+		};
+
+		// Default constructor
+		vector() {}
+
+		// Initializer list constructor
+		vector(std::initializer_list<bool> list)
+			: _size(list.size()), _capacity(words_for(list.size()) * word_bits)
+		{
+			_words = allocate(words_for(_capacity));
+
+			size_t idx = 0;
+			for (bool elem : list)
+			{
+				if (elem)
+					_words[idx / word_bits] |= bit(idx);
+				idx++;
+			}
+		}
+
+		vector(size_t size, bool default_value)
+			: _size(size), _capacity(words_for(size) * word_bits)
+		{
+			_words = allocate(words_for(_capacity));
+
+			if (default_value)
+			{
+				std::fill(_words, _words + word_count(), ~word_type(0));
+				clear_tail();
+			}
+		}
+
+		// Copy constructor
+		vector(const vector<bool>& vec)
+			: _size(vec._size), _capacity(vec._capacity)
+		{
+			std::cout << "Used my copy constructor\n";
+
+			_words = allocate(words_for(_capacity));
+			std::copy(vec._words, vec._words + vec.word_count(), _words);
+		}
+
+		// Move constructor
+		vector(vector<bool>&& vec) noexcept
+		{
+			std::cout << "Used my move constructor\n";
+
+			_size = vec._size;
+			_capacity = vec._capacity;
+			_words = vec._words;
+
+			vec._size = 0;
+			vec._capacity = 0;
+			vec._words = nullptr;
+		}
+
+		// Converting constructor from any other IsVector, non-zero elements become true (implicit only for expressions)
+		template <typename V> requires (!std::is_same_v<V, vector<bool>>) && IsVector<V>
+		explicit(!expr::IsNode<V>) vector(const V& vec)
+			: _size(vec.size()), _capacity(words_for(vec.size()) * word_bits)
+		{
+			_words = allocate(words_for(_capacity));
+
+			for (size_t i = 0; i < _size; i++)
+			{
+				if (static_cast<bool>(vec[i]))
+					_words[i / word_bits] |= bit(i);
+			}
+		}
+
+		~vector() { delete[] _words; }
+
+
+		size_t size() const { return _size; }
+		size_t capacity() const { return _capacity; }
+		bool empty() const { return _size == 0; }
+
+		/* The packed bits: element i is bit i % 64 of word i / 64. */
+		const word_type* words() const { return _words; }
+
+		/* Number of words holding the elements. */
+		size_t word_count() const { return words_for(_size); }
+
+		bool at(size_t idx) const
+		{
+			if (idx >= _size) throw std::range_error("Provided index is out of bounds");
+			return (_words[idx / word_bits] & bit(idx)) != 0;
+		}
+
+		reference at(size_t idx)
+		{
+			if (idx >= _size) throw std::range_error("Provided index is out of bounds");
+			return reference(_words[idx / word_bits], bit(idx));
+		}
+
+		void resize(size_t new_size)
+		{
+			if (new_size > _capacity)
+			{
+				reserve(new_size);
+			}
+			else if (new_size < _size)
+			{
+				// Bits past the new size are cleared, new elements are false
+				std::fill(_words + words_for(new_size), _words + word_count(), word_type(0));
+				_size = new_size;
+				clear_tail();
+			}
+
+			_size = new_size;
+		}
+
+		void reserve(size_t new_capacity)
+		{
+			if (new_capacity < _capacity) throw std::invalid_argument("Cannot reserve a smaller amount than already reserved");
+
+			word_type* tmp = allocate(words_for(new_capacity));
+			std::copy(_words, _words + word_count(), tmp);
+
+			_capacity = words_for(new_capacity) * word_bits;
+
+			delete[] _words;
+			_words = tmp;
+		}
+
+		void pop_back()
+		{
+			resize(_size - 1);
+		}
+
+		void pop() { pop_back(); }  // A pop_back alias, because I prefer the name pop :)
+
+		void push_back(bool value)
+		{
+			if (_size == _capacity)
+				reserve(std::max(word_bits, 2 * _capacity));
+
+			if (value)
+				_words[_size / word_bits] |= bit(_size);
+			_size++;
+		}
+
+		void append(bool value) { push_back(value); }  // A push_back alias, because I prefer the name append :)
+
+		bool operator[](size_t idx) const { return this->at(idx); }
+		reference operator[](size_t idx) { return this->at(idx); }
+
+		// Copy assignment operator
+		vector& operator=(const vector<bool>& vec)
+		{
+			std::cout << "Used my copy assignment operator\n";
+
+			if (this == &vec)
+			{
+				return *this;
+			}
+
+			_size = vec._size;
+			_capacity = vec._capacity;
+
+			delete[] _words;
+			_words = allocate(words_for(_capacity));
+			std::copy(vec._words, vec._words + vec.word_count(), _words);
+
+			return *this;
+		}
+
+		// Move assignment operator
+		vector& operator=(vector<bool>&& vec) noexcept
+		{
+			std::cout << "Used my move assignment operator\n";
+
+			if (this == &vec)
+			{
+				return *this;
+			}
+
+			_size = vec._size;
+			_capacity = vec._capacity;
+
+			delete[] _words;
+			_words = vec._words;
+
+			vec._size = 0;
+			vec._capacity = 0;
+			vec._words = nullptr;
+
+			return *this;
+		}
+
+		// Assignment from any other IsVector, non-zero elements become true
+		template <typename V> requires (!std::is_same_v<V, vector<bool>>) && IsVector<V>
+		vector& operator=(const V& vec)
+		{
+			// vec may be an expression that reads this vector (m = hadamard(m, x)), so the bits are collected in a new buffer
+			const size_t size = vec.size();
+			word_type* words = allocate(words_for(size));
+			for (size_t i = 0; i < size; i++)
+			{
+				if (static_cast<bool>(vec[i]))
+					words[i / word_bits] |= bit(i);
+			}
+
+			delete[] _words;
+			_words = words;
+			_size = size;
+			_capacity = words_for(size) * word_bits;
+
+			return *this;
+		}
+
+		/* Number of true elements. */
+		size_t count() const { return simd::popcount(_words, word_count()); }
+
+		bool any() const { return find_first() != _size; }
+		bool none() const { return !any(); }
+		bool all() const { return count() == _size; }
+
+		/* Index of the first true element, size() when there is none. */
+		size_t find_first() const { return find_next(0); }
+
+		/* Index of the first true element at or after pos, size() when there is none. */
+		size_t find_next(size_t pos) const
+		{
+			if (pos >= _size) return _size;
+
+			size_t w = pos / word_bits;
+			word_type bits = _words[w] & (~word_type(0) << (pos % word_bits));
+			while (bits == 0)
+			{
+				if (++w == word_count()) return _size;
+				bits = _words[w];
+			}
+
+			return w * word_bits + std::countr_zero(bits);
+		}
+
+		/* Negates every element. */
+		void flip()
+		{
+			for (size_t w = 0; w < word_count(); w++)
+				_words[w] = ~_words[w];
+			clear_tail();
+		}
+
+		vector& operator&=(const vector<bool>& vec) { return combine(vec, [](word_type a, word_type b) { return a & b; }); }
+		vector& operator|=(const vector<bool>& vec) { return combine(vec, [](word_type a, word_type b) { return a | b; }); }
+		vector& operator^=(const vector<bool>& vec) { return combine(vec, [](word_type a, word_type b) { return a ^ b; }); }
+
+		friend vector<bool> operator&(const vector<bool>& a, const vector<bool>& b) { return combined(a, b, [](word_type x, word_type y) { return x & y; }); }
+		friend vector<bool> operator|(const vector<bool>& a, const vector<bool>& b) { return combined(a, b, [](word_type x, word_type y) { return x | y; }); }
+		friend vector<bool> operator^(const vector<bool>& a, const vector<bool>& b) { return combined(a, b, [](word_type x, word_type y) { return x ^ y; }); }
+
+		friend vector<bool> operator~(const vector<bool>& vec)
+		{
+			vector<bool> result(vec._size, false);
+			for (size_t w = 0; w < vec.word_count(); w++)
+				result._words[w] = ~vec._words[w];
+			result.clear_tail();
+
+			return result;
+		}
+
+		friend std::ostream& operator<<(std::ostream& out, const vector<bool>& vec)
+		{
+			if (vec._size > 0)
+			{
+				out << "[" << vec[0];
+				for (size_t i = 1; i < vec._size; i++)
+				{
+					out << ", " << vec[i];
+				}
+				out << "]";
+			}
+			else
+			{
+				out << "[]";
+			}
+
+			return out;
+		}
+
+		void print_info() const
+		{
+			std::cout << "size=" << _size << "; capacity=" << _capacity << "; _words=" << *this;
+		}
+
+	private:
+		static size_t words_for(size_t bits) { return (bits + word_bits - 1) / word_bits; }
+		static word_type bit(size_t idx) { return word_type(1) << (idx % word_bits); }
+
+		// Zero-initialized words, nullptr for none
+		static word_type* allocate(size_t words) { return words > 0 ? new word_type[words]() : nullptr; }
+
+		/* Clears the bits of the last word that lie past size(). */
+		void clear_tail()
+		{
+			if (_size % word_bits != 0)
+				_words[_size / word_bits] &= bit(_size) - 1;
+		}
+
+		template <typename Op>
+		vector& combine(const vector<bool>& vec, Op op)
+		{
+			if (vec._size != _size) throw std::runtime_error("Vectors must be the same size");
+
+			for (size_t w = 0; w < word_count(); w++)
+				_words[w] = op(_words[w], vec._words[w]);
+
+			return *this;
+		}
+
+		template <typename Op>
+		static vector<bool> combined(const vector<bool>& a, const vector<bool>& b, Op op)
+		{
+			if (a._size != b._size) throw std::runtime_error("Vectors must be the same size");
+
+			vector<bool> result(a._size, false);
+			for (size_t w = 0; w < a.word_count(); w++)
+				result._words[w] = op(a._words[w], b._words[w]);
+
+			return result;
+		}
+
+		size_t _size = 0;
+		size_t _capacity = 0;  // In bits, always a whole number of words
+		word_type* _words = nullptr;
+	};
+
+	/// <summary>
+	/// Scalar product with a chosen accumulator policy (see Accumulators.h), for example
+	/// cpplab::dot<cpplab::accumulate::widen>(v, u) sums vectors of int in 64 bits and returns an int64_t.
+	/// </summary>
+	template <typename Policy = accumulate::natural, IsVector V, IsVector U>
+	auto dot(const V& v, const U& u)
 	{
 		if (v.size() != u.size()) throw std::runtime_error("Vectors must be the same size");
 
-		using ResultType = decltype(std::declval<typename V::value_type>() * std::declval<typename U::value_type>());  // Apparently writing result = v[0] * u[0] is enough
+		using A = typename V::value_type;
+		using B = typename U::value_type;
+		using Accumulator = typename Policy::template accumulator<A, B>;
 
-		ResultType result = ResultType();
-		for (size_t i = 0; i < v.size(); i++)
+		// Contiguous vectors of float, double, int32 and int64 (also mixed) are handled by SIMD kernels
+		if constexpr (IsContiguousVector<V> && IsContiguousVector<U> && simd::HasAccumulateKernel<Accumulator, A, B>)
 		{
-			result += v[i] * u[i];
+			return Policy::template finish<A, B>(simd::dot_as<Accumulator>(v.data(), u.data(), v.size()));
+		}
+		else
+		{
+			Accumulator result = Accumulator();
+			for (size_t i = 0; i < v.size(); i++)
+			{
+				result += static_cast<Accumulator>(v[i]) * static_cast<Accumulator>(u[i]);
+			}
+
+			return Policy::template finish<A, B>(result);
 		}
+	}
+
+	/// <summary>Dot product of two bit vectors: the number of positions where both are true, counted a word at a time.</summary>
+	template <typename Policy = accumulate::natural>
+	auto dot(const vector<bool>& v, const vector<bool>& u)
+	{
+		if (v.size() != u.size()) throw std::runtime_error("Vectors must be the same size");
 
-		return result;
+		using Accumulator = typename Policy::template accumulator<bool, bool>;
+		return Policy::template finish<bool, bool>(static_cast<Accumulator>(simd::popcount_and(v.words(), u.words(), v.word_count())));
+	}
+
+	namespace detail
+	{
+		/* Sum of the elements of u where mask is true, by the masked-sum kernels for float, double, int32 and int64. */
+		template <typename Policy, typename U>
+		auto masked_dot(const vector<bool>& mask, const U& u)
+		{
+			if (mask.size() != u.size()) throw std::runtime_error("Vectors must be the same size");
+
+			using B = typename U::value_type;
+			using Accumulator = typename Policy::template accumulator<bool, B>;
+
+			if constexpr (simd::LoadsInto<Accumulator, B>)
+				return Policy::template finish<bool, B>(simd::masked_sum_as<Accumulator>(mask.words(), u.data(), u.size()));
+			else
+				return Policy::template finish<bool, B>(simd::masked_sum_scalar<Accumulator>(mask.words(), u.data(), u.size()));
+		}
+	}
+
+	/// <summary>Dot product of a bit vector and a contiguous vector of numbers: the sum of the numbers at the true positions.</summary>
+	template <typename Policy = accumulate::natural, IsContiguousVector U>
+	auto dot(const vector<bool>& v, const U& u)
+	{
+		return detail::masked_dot<Policy>(v, u);
+	}
+
+	template <typename Policy = accumulate::natural, IsContiguousVector V>
+	auto dot(const V& v, const vector<bool>& u)
+	{
+		return detail::masked_dot<Policy>(u, v);
+	}
+
+	// Scalar multiplacation operator
+	template <IsVector V, IsVector U>
+	auto operator*(const V& v, const U& u)
+	{
+		// The result has the type of v[0] * u[0], use dot<Policy>() to avoid overflow
+		return dot<accumulate::natural>(v, u);
 	}
 }
 
@@ -292,9 +807,15 @@ int main3_1()
 
 	std::cout << "Dot product of dblVec and intVec = " << dblVec * intVec << "\n";
 	std::cout << "Dot product of boolVec and intVec = " << boolVec * intVec << "\n";
+	std::cout << "Dot product of boolVec and boolVec = " << boolVec * boolVec << "\n";
 	//std::cout << "Dot product of strVec and strVec = " << strVec * strVec << "\n";  // no operator "*" matches these operands
 	//std::cout << "Dot product of strVec and intVec = " << strVec * intVec << "\n";  // no operator "*" matches these operands
 
+	cpplab::vector<int> bigVec(4, 50'000);
+	// bigVec * bigVec would overflow an int
+	std::cout << "Dot product of bigVec and bigVec (widen) = " << cpplab::dot<cpplab::accumulate::widen>(bigVec, bigVec) << "\n";
+	std::cout << "Dot product of bigVec and bigVec (saturate) = " << cpplab::dot<cpplab::accumulate::saturate>(bigVec, bigVec) << "\n";
+
 	/*std::cout << std::is_arithmetic<decltype(dblVec)::value_type>::value << "\n";
 	std::cout << std::is_arithmetic<decltype(strVec)::value_type>::value << "\n";
 	std::cout << std::is_arithmetic<decltype(intVec)::value_type>::value << "\n";
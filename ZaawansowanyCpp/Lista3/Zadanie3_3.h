@@ -38,6 +38,12 @@ namespace cpplab
 			}
 		}
 
+		/* Move constructor */
+		forward_list(forward_list&& flist) noexcept = default;
+
+		/* Move assignment operator */
+		forward_list& operator=(forward_list&& flist) noexcept = default;
+
 		/* Destructor */
 		~forward_list() = default;  // std::unique_ptr handles deleting nodes recursively
 
@@ -63,6 +69,14 @@ namespace cpplab
 				head = std::move(head->next);  // Moves the head one step forward, std::unique_ptr deletes the data left behind
 		}
 
+		/* Calls f with every element, from the front to the back. */
+		template <typename F>
+		void for_each(F f) const
+		{
+			for (Node* node = head.get(); node; node = node->next.get())
+				f(node->data);
+		}
+
 		/* Reverses the order of the forward list. */
 		void reverse()
 		{
@@ -0,0 +1,206 @@
+// Allocator with a guaranteed alignment (64 bytes by default) that can back large blocks with 2 MiB huge pages
+
+#pragma once
+
+#include <iostream>
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <new>
+#include <string>
+#include <type_traits>
+
+#include "Zadanie4_2.h"
+#include "../Lista3/Simd_dot.h"
+#include "../Common/Bench_timer.h"
+
+#if defined(__linux__)
+	#include <sys/mman.h>
+	#define CPPLAB_HAS_HUGE_PAGES 1
+#else
+	#define CPPLAB_HAS_HUGE_PAGES 0
+#endif
+
+
+namespace cpplab
+{
+	enum class page_policy
+	{
+		normal,  // Whatever the system gives (4 KiB pages)
+		huge     // Blocks of at least 2 MiB are mapped on a 2 MiB boundary and marked for transparent huge pages
+	};
+
+	/// <summary>
+	/// Allocator whose blocks all start at a multiple of Alignment, e.g. a cache line, so no SIMD load of a vector's
+	/// elements is split between two lines. cpplab::vector reads the alignment member and passes it to the compiler
+	/// through std::assume_aligned in data(). With page_policy::huge, a block of at least one huge page is a separate
+	/// mapping aligned to 2 MiB and marked with MADV_HUGEPAGE, so the kernel backs it with 2 MiB pages: a 1 GiB buffer
+	/// then needs 512 TLB entries instead of 262144. Elsewhere than on Linux the policy falls back to normal pages.
+	/// </summary>
+	template <typename T, size_t Alignment = 64, page_policy Pages = page_policy::normal>
+	class aligned_allocator
+	{
+		static_assert(std::has_single_bit(Alignment), "Alignment must be a power of two");
+		// Also checked for every type the allocator is rebound to, rebinding keeps the alignment
+		static_assert(Alignment >= alignof(T), "Alignment must be at least alignof(T)");
+
+	  public:
+		using value_type = T;
+		using is_always_equal = std::true_type;
+
+		static constexpr size_t alignment = Alignment;
+		static constexpr page_policy pages = Pages;
+		static constexpr size_t huge_page_size = 2 << 20;
+
+		template <typename U>
+		struct rebind { using other = aligned_allocator<U, Alignment, Pages>; };
+
+		// Default constructor
+		aligned_allocator() {}
+
+		// Converting constructor (used by rebind)
+		template <typename U>
+		aligned_allocator(const aligned_allocator<U, Alignment, Pages>&) {}
+
+		T* allocate(size_t n)
+		{
+			if (n > std::numeric_limits<size_t>::max() / sizeof(T)) throw std::bad_array_new_length();
+			const size_t bytes = n * sizeof(T);
+
+#if CPPLAB_HAS_HUGE_PAGES
+			if (uses_huge_pages(bytes))
+				return static_cast<T*>(map_huge(bytes));
+#endif
+			return static_cast<T*>(::operator new(bytes, std::align_val_t(Alignment)));
+		}
+
+		void deallocate(T* p, size_t n)
+		{
+#if CPPLAB_HAS_HUGE_PAGES
+			if (uses_huge_pages(n * sizeof(T)))
+			{
+				::munmap(p, round_up(n * sizeof(T)));
+				return;
+			}
+#endif
+			::operator delete(p, std::align_val_t(Alignment));
+		}
+
+		// Allocators with another alignment or page policy are different types and do not compare
+		template <typename U>
+		bool operator==(const aligned_allocator<U, Alignment, Pages>&) const { return true; }
+
+	  private:
+		static constexpr bool uses_huge_pages(size_t bytes) { return Pages == page_policy::huge && bytes >= huge_page_size; }
+
+		static constexpr size_t round_up(size_t bytes) { return (bytes + huge_page_size - 1) / huge_page_size * huge_page_size; }
+
+#if CPPLAB_HAS_HUGE_PAGES
+		/* Maps a whole number of huge pages on a huge page boundary: one extra huge page is mapped and the ends are cut off. */
+		static void* map_huge(size_t bytes)
+		{
+			const size_t length = round_up(bytes);
+			void* p = ::mmap(nullptr, length + huge_page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (p == MAP_FAILED) throw std::bad_alloc();
+
+			const std::uintptr_t start = reinterpret_cast<std::uintptr_t>(p);
+			const std::uintptr_t aligned = (start + huge_page_size - 1) / huge_page_size * huge_page_size;
+			if (aligned > start)
+				::munmap(p, aligned - start);
+			if (const size_t tail = start + huge_page_size - aligned; tail > 0)
+				::munmap(reinterpret_cast<void*>(aligned + length), tail);
+
+			::madvise(reinterpret_cast<void*>(aligned), length, MADV_HUGEPAGE);
+			return reinterpret_cast<void*>(aligned);
+		}
+#endif
+	};
+
+	// Vector aligned to a cache line, and one that also uses huge pages for blocks of 2 MiB and more
+	template <typename T>
+	using aligned_vector = vector<T, aligned_allocator<T, std::max<size_t>(64, alignof(T))>>;
+
+	template <typename T>
+	using huge_page_vector = vector<T, aligned_allocator<T, std::max<size_t>(64, alignof(T)), page_policy::huge>>;
+}
+
+
+/// <summary>
+/// Dot products of two 256 MiB float vectors held in a plain cpplab::vector, an aligned_vector and a huge_page_vector:
+/// the first pass over new memory (page faults), the throughput of repeated sequential passes, and one pass that
+/// visits the cache lines in a scattered order.
+/// </summary>
+int aligned_allocator_benchmark()
+{
+	using clock = cpplab::bench::clock;
+	using cpplab::bench::ms_since;
+
+	const size_t count = size_t(1) << 26;
+	const int passes = 10;
+
+	// Memory backed by huge pages in this process, as reported by the kernel
+	auto huge_kib = []() -> long
+	{
+		std::ifstream smaps("/proc/self/smaps_rollup");
+		std::string key;
+		long value = 0;
+		while (smaps >> key)
+		{
+			if (key == "AnonHugePages:")
+			{
+				smaps >> value;
+				return value;
+			}
+		}
+		return -1;
+	};
+
+	auto run = [&](const char* name, auto tag)
+	{
+		using Vector = typename decltype(tag)::type;
+
+		auto start = clock::now();
+		Vector a;
+		Vector b;
+		a.resize(count);
+		b.resize(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			a[i] = static_cast<float>(i % 7) * 0.25f;
+			b[i] = static_cast<float>(i % 5) * 0.5f;
+		}
+		double fill_ms = ms_since(start);
+		long huge = huge_kib();
+
+		float dot = 0;
+		start = clock::now();
+		for (int p = 0; p < passes; p++)
+			dot += cpplab::simd::dot(a.data(), b.data(), count);
+		double dot_ms = ms_since(start) / passes;
+
+		// The same dot product one cache line at a time in a scattered order: nearly every line is on another page,
+		// which is where the TLB reach of huge pages shows. The step is odd, so every line of the power-of-two count is visited
+		const size_t lines = count / 16;
+		float scattered = 0;
+		start = clock::now();
+		for (size_t i = 0, line = 0; i < lines; i++, line = (line + 7919) & (lines - 1))
+			scattered += cpplab::simd::dot(a.data() + line * 16, b.data() + line * 16, 16);
+		double scattered_ms = ms_since(start);
+
+		double gbs = 2.0 * count * sizeof(float) / (dot_ms * 1e6);
+		std::cout << name << ": fill " << fill_ms << " ms, dot " << dot_ms << " ms (" << gbs << " GB/s, " << dot << "), scattered lines "
+			<< scattered_ms << " ms (" << scattered << "), data() % 64 = " << reinterpret_cast<std::uintptr_t>(a.data()) % 64
+			<< ", AnonHugePages " << huge << " KiB\n";
+	};
+
+	std::cout << "Two vectors of " << count << " floats, dot product with " << cpplab::simd::level_name(cpplab::simd::active_level()) << "\n";
+	run("cpplab::vector   ", std::type_identity<cpplab::vector<float>>());
+	run("aligned_vector   ", std::type_identity<cpplab::aligned_vector<float>>());
+	run("huge_page_vector ", std::type_identity<cpplab::huge_page_vector<float>>());
+
+
+	return 0;
+}
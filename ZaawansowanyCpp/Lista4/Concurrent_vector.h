@@ -0,0 +1,370 @@
+// Append-only vector that many threads can push_back to at once, its elements never move
+
+#pragma once
+
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <exception>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Zadanie4_2.h"
+#include "../Common/Bench_timer.h"
+
+
+namespace cpplab
+{
+	/// <summary>
+	/// Vector that grows by adding segments instead of reallocating: segment k holds first_segment * 2^k elements, so the
+	/// segments double like a vector's capacity, but nothing is ever copied and references stay valid forever.
+	/// push_back and emplace_back claim a slot with one atomic fetch_add and construct the element in it, without locks.
+	/// Reading by index computes the segment from the highest set bit of the index, also without locks.
+	/// size() counts the claimed slots, so an element added by another thread may still be under construction: read
+	/// it after being told its index or after the producers finished (e.g. were joined).
+	/// </summary>
+	template <typename T>
+	class concurrent_vector
+	{
+		static_assert(std::is_nothrow_move_constructible_v<T> || std::is_nothrow_copy_constructible_v<T>,
+			"concurrent_vector builds elements that may throw outside the claimed slot and then moves them in");
+
+	  public:
+		using value_type = T;
+
+		// Elements in the first segment: about a page, a power of two so the segment of an index is a bit scan
+		static constexpr size_t first_segment = std::bit_floor(std::max<size_t>(1, 4096 / sizeof(T)));
+		static constexpr size_t max_segments = std::numeric_limits<size_t>::digits - std::countr_zero(first_segment);
+
+		// Default constructor
+		concurrent_vector() {}
+
+		concurrent_vector(const concurrent_vector&) = delete;
+		concurrent_vector& operator=(const concurrent_vector&) = delete;
+
+		/* Not thread-safe: every producer must have finished. */
+		~concurrent_vector()
+		{
+			clear();
+			for (auto& segment : _segments)
+				release(segment.load(std::memory_order_relaxed));
+		}
+
+
+		size_t size() const { return _size.load(std::memory_order_acquire); }
+		bool empty() const { return size() == 0; }
+
+		/* Elements in the segments allocated so far (they are allocated in order, up to the first missing one). */
+		size_t capacity() const
+		{
+			size_t k = 0;
+			while (k < max_segments && _segments[k].load(std::memory_order_acquire))
+				k++;
+			return segment_start(k);
+		}
+
+		const T& operator[](size_t idx) const { return *slot(idx); }
+		T& operator[](size_t idx) { return *slot(idx); }
+
+		const T& at(size_t idx) const
+		{
+			if (idx >= size()) throw std::range_error("Provided index is out of bounds");
+			return *slot(idx);
+		}
+
+		T& at(size_t idx)
+		{
+			if (idx >= size()) throw std::range_error("Provided index is out of bounds");
+			return *slot(idx);
+		}
+
+		void push_back(const T& value) { emplace_back(value); }
+		void push_back(T&& value) { emplace_back(std::move(value)); }
+
+		/* Thread-safe. Returns the index of the new element. */
+		template <typename... Args>
+		size_t emplace_back(Args&&... args)
+		{
+			if constexpr (std::is_nothrow_constructible_v<T, Args...>)
+			{
+				size_t idx = claim(1);
+				std::construct_at(slot(idx), std::forward<Args>(args)...);
+				return idx;
+			}
+			else
+			{
+				// A constructor that throws after the slot was claimed would leave a hole the destructor cannot skip
+				T value(std::forward<Args>(args)...);
+				size_t idx = claim(1);
+				std::construct_at(slot(idx), std::move_if_noexcept(value));
+				return idx;
+			}
+		}
+
+		/// <summary>
+		/// Thread-safe. Appends count copies of value with one atomic operation, returns the index of the first one.
+		/// Producers that add elements in batches touch the shared counter once per batch instead of once per element.
+		/// </summary>
+		size_t grow_by(size_t count, const T& value = T())
+		{
+			static_assert(std::is_nothrow_copy_constructible_v<T>, "grow_by copies the value into claimed slots");
+
+			size_t first = claim(count);
+			for_each_run(first, first + count, [&](T* p, size_t n) { std::uninitialized_fill_n(p, n, value); });
+			return first;
+		}
+
+		/* Thread-safe. Allocates the segments for n elements up front, so a later push_back never allocates. */
+		void reserve(size_t n)
+		{
+			for (size_t k = 0; k < max_segments && segment_start(k) < n; k++)
+				if (!_segments[k].load(std::memory_order_acquire))
+					install(k, allocate(k));
+		}
+
+		/* Not thread-safe. Destroys the elements but keeps the segments. */
+		void clear()
+		{
+			size_t n = _size.load(std::memory_order_relaxed);
+			if constexpr (!std::is_trivially_destructible_v<T>)
+				for_each_run(0, n, [](T* p, size_t count) { std::destroy_n(p, count); });
+			_size.store(0, std::memory_order_relaxed);
+		}
+
+		/* Calls f(pointer, count) for every contiguous run of the elements [first, last), one run per segment. */
+		template <typename F>
+		void for_each_run(size_t first, size_t last, F f) const
+		{
+			while (first < last)
+			{
+				size_t k = segment_of(first);
+				size_t end = std::min(last, segment_start(k + 1));
+				f(slot(first), end - first);
+				first = end;
+			}
+		}
+
+		class const_iterator
+		{
+		  public:
+			using iterator_category = std::forward_iterator_tag;
+			using value_type = T;
+			using difference_type = std::ptrdiff_t;
+			using pointer = const T*;
+			using reference = const T&;
+
+			const_iterator() {}
+			const_iterator(const concurrent_vector* vec, size_t idx) : _vec(vec), _idx(idx) {}
+
+			reference operator*() const { return (*_vec)[_idx]; }
+			pointer operator->() const { return &(*_vec)[_idx]; }
+
+			const_iterator& operator++() { _idx++; return *this; }
+			const_iterator operator++(int) { const_iterator old = *this; _idx++; return old; }
+
+			bool operator==(const const_iterator& other) const { return _idx == other._idx; }
+
+		  private:
+			const concurrent_vector* _vec = nullptr;
+			size_t _idx = 0;
+		};
+
+		const_iterator begin() const { return { this, 0 }; }
+		const_iterator end() const { return { this, size() }; }
+
+	  private:
+		static constexpr int first_shift = std::countr_zero(first_segment);
+		static constexpr std::align_val_t alignment{ std::max<size_t>(alignof(T), 64) };
+
+		static constexpr size_t segment_length(size_t k) { return first_segment << k; }
+
+		/* Index of the first element of segment k (first_segment * (2^k - 1)). */
+		static constexpr size_t segment_start(size_t k) { return segment_length(k) - first_segment; }
+
+		static size_t segment_of(size_t idx) { return std::bit_width(idx + first_segment) - 1 - first_shift; }
+
+		T* slot(size_t idx) const
+		{
+			size_t k = segment_of(idx);
+			return _segments[k].load(std::memory_order_acquire) + (idx - segment_start(k));
+		}
+
+		/* Takes the slots [first, first + count) and makes sure their segments exist. */
+		size_t claim(size_t count)
+		{
+			size_t first = _size.fetch_add(count, std::memory_order_acq_rel);
+			if (count == 0)
+				return first;
+
+			for (size_t k = segment_of(first); k <= segment_of(first + count - 1); k++)
+			{
+				if (_segments[k].load(std::memory_order_acquire))
+					continue;
+
+				if (segment_start(k) < first)
+				{
+					// The thread that claimed the first slot of the segment allocates it, the others wait instead of racing it
+					_segments[k].wait(nullptr, std::memory_order_acquire);
+					continue;
+				}
+
+				T* segment = allocate(k, std::nothrow);
+				// The slots are taken already and cannot be given back, an element missing in the middle would break the vector
+				if (!segment) std::terminate();
+				install(k, segment);
+			}
+
+			return first;
+		}
+
+		static T* allocate(size_t k)
+		{
+			return static_cast<T*>(::operator new(segment_length(k) * sizeof(T), alignment));
+		}
+
+		static T* allocate(size_t k, std::nothrow_t)
+		{
+			return static_cast<T*>(::operator new(segment_length(k) * sizeof(T), alignment, std::nothrow));
+		}
+
+		static void release(T* segment)
+		{
+			if (segment)
+				::operator delete(segment, alignment);
+		}
+
+		/* Publishes a new segment and wakes the threads waiting for it. When reserve() races claim() the first one is kept. */
+		void install(size_t k, T* segment)
+		{
+			T* expected = nullptr;
+			if (!_segments[k].compare_exchange_strong(expected, segment, std::memory_order_acq_rel))
+			{
+				release(segment);
+				return;
+			}
+
+			_segments[k].notify_all();
+		}
+
+		std::atomic<size_t> _size = 0;
+		std::atomic<T*> _segments[max_segments] = {};
+	};
+}
+
+
+/// <summary>
+/// Four threads append strings to one concurrent_vector while a reference to the first element stays valid.
+/// </summary>
+int concurrent_vector_demo()
+{
+	cpplab::concurrent_vector<std::string> log;
+	size_t first = log.emplace_back("started");
+	const std::string& kept = log[first];
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; t++)
+		threads.emplace_back([&log, t]()
+		{
+			for (int i = 0; i < 1000; i++)
+				log.push_back("thread " + std::to_string(t) + " line " + std::to_string(i));
+		});
+	for (auto& thread : threads)
+		thread.join();
+
+	std::cout << "size=" << log.size() << "; capacity=" << log.capacity() << "; first element still \"" << kept << "\"\n";
+	std::cout << "last element: \"" << log[log.size() - 1] << "\"\n";
+
+
+	return 0;
+}
+
+
+/// <summary>
+/// Several producer threads append to one shared container: a cpplab::vector behind a mutex, a concurrent_vector
+/// with push_back, and a concurrent_vector with grow_by in batches of 256.
+/// </summary>
+int concurrent_vector_benchmark()
+{
+	using clock = cpplab::bench::clock;
+	using cpplab::bench::ms_since;
+
+	const size_t total = 1 << 23;
+	const size_t batch = 256;
+
+	auto run = [&](size_t producers, auto produce)
+	{
+		std::vector<std::thread> threads;
+		auto start = clock::now();
+		for (size_t t = 0; t < producers; t++)
+		{
+			// Producer t adds the values [first, first + n), the last one also takes the remainder
+			size_t first = t * (total / producers);
+			size_t n = t + 1 == producers ? total - first : total / producers;
+			threads.emplace_back([&produce, first, n]() { produce(first, n); });
+		}
+		for (auto& thread : threads)
+			thread.join();
+		return ms_since(start);
+	};
+
+	std::vector<size_t> counts = { 1, 2, 4, 8 };
+	size_t hardware = std::thread::hardware_concurrency();
+	if (hardware > 8)
+		counts.push_back(hardware);
+
+	std::cout << total << " push_backs of size_t, " << hardware << " hardware threads\n";
+	for (size_t producers : counts)
+	{
+		cpplab::vector<size_t> locked;
+		std::mutex mutex;
+		double locked_ms = run(producers, [&](size_t first, size_t n)
+		{
+			for (size_t i = 0; i < n; i++)
+			{
+				std::lock_guard lock(mutex);
+				locked.push_back(first + i);
+			}
+		});
+
+		cpplab::concurrent_vector<size_t> concurrent;
+		double concurrent_ms = run(producers, [&](size_t first, size_t n)
+		{
+			for (size_t i = 0; i < n; i++)
+				concurrent.push_back(first + i);
+		});
+
+		cpplab::concurrent_vector<size_t> batched;
+		double batched_ms = run(producers, [&](size_t first, size_t n)
+		{
+			for (size_t i = 0; i < n; i += batch)
+			{
+				size_t idx = batched.grow_by(std::min(batch, n - i));
+				for (size_t j = 0; j < std::min(batch, n - i); j++)
+					batched[idx + j] = first + i + j;
+			}
+		});
+
+		// Every value must be there exactly once
+		std::vector<char> seen(total, 0);
+		for (size_t value : concurrent)
+			seen[value]++;
+		bool complete = concurrent.size() == total && std::all_of(seen.begin(), seen.end(), [](char c) { return c == 1; });
+
+		std::cout << producers << " producers: mutex + vector " << locked_ms << " ms, concurrent_vector " << concurrent_ms
+			<< " ms, grow_by(" << batch << ") " << batched_ms << " ms" << (complete ? "" : "  MISSING ELEMENTS") << "\n";
+	}
+
+
+	return 0;
+}
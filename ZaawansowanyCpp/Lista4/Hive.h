@@ -0,0 +1,600 @@
+// Unordered container with O(1) insert and erase whose elements never move: erased slots are skipped and reused
+
+#pragma once
+
+#include <iostream>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <list>
+#include <memory>
+#include <random>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "../Common/Bench_timer.h"
+
+
+namespace cpplab
+{
+	/// <summary>
+	/// Elements are kept in blocks (8 slots at first, growing with the size up to 8192) that are never reallocated, so a
+	/// pointer to an element stays valid until that element is erased. Erasing destroys the element and marks its slot in
+	/// the block's skip-field, inserting reuses an erased slot when there is one, both in O(1).
+	///
+	/// Skip-field (jump-counting): 0 means the slot holds an element. A run of erased slots stores its length in its first
+	/// and last slot, so iteration jumps over a whole run in one step and erase finds the runs next to a slot by looking
+	/// at its two neighbours. Each block keeps a free list of its runs, linked through the erased slots themselves.
+	/// Blocks that lose their last element are released (the largest one is kept for reuse).
+	/// </summary>
+	template <typename T>
+	class hive
+	{
+	  private:
+		using skip_type = std::uint16_t;
+		static constexpr skip_type no_slot = std::numeric_limits<skip_type>::max();
+		static constexpr size_t min_block = 8;
+		static constexpr size_t max_block = 8192;
+
+		// An erased slot holds the links of its run in the block's free list instead of an element
+		union slot
+		{
+			slot() {}
+			~slot() {}
+
+			T value;
+			struct { skip_type prev, next; } links;
+		};
+
+		struct block
+		{
+			explicit block(size_t capacity) : slots(new slot[capacity]), skip(new skip_type[capacity + 1]()), capacity(capacity) {}
+
+			std::unique_ptr<slot[]> slots;
+			std::unique_ptr<skip_type[]> skip;  // One more than the slots: the last entry is always 0 and ends the block
+			size_t capacity;
+			size_t end = 0;    // Slots [0, end) have been used, the rest have never held an element
+			size_t count = 0;  // Elements in the block
+			skip_type free_head = no_slot;  // First slot of the first erased run
+
+			block* prev = nullptr;
+			block* next = nullptr;
+			block* prev_erased = nullptr;  // Blocks with erased slots, where inserting looks first
+			block* next_erased = nullptr;
+		};
+
+		template <bool Const>
+		class basic_iterator
+		{
+		  public:
+			using iterator_category = std::forward_iterator_tag;
+			using value_type = T;
+			using difference_type = std::ptrdiff_t;
+			using pointer = std::conditional_t<Const, const T*, T*>;
+			using reference = std::conditional_t<Const, const T&, T&>;
+
+			basic_iterator() {}
+			basic_iterator(block* b, size_t idx) : _block(b), _idx(idx) {}
+
+			// An iterator converts to a const_iterator
+			template <bool OtherConst> requires (Const && !OtherConst)
+			basic_iterator(const basic_iterator<OtherConst>& it) : _block(it._block), _idx(it._idx) {}
+
+			reference operator*() const { return _block->slots[_idx].value; }
+			pointer operator->() const { return &_block->slots[_idx].value; }
+
+			basic_iterator& operator++()
+			{
+				_idx++;
+				settle();
+				return *this;
+			}
+
+			basic_iterator operator++(int)
+			{
+				basic_iterator old = *this;
+				++*this;
+				return old;
+			}
+
+			bool operator==(const basic_iterator& other) const { return _block == other._block && _idx == other._idx; }
+
+		  private:
+			friend class hive;
+			template <bool> friend class basic_iterator;
+
+			/* Moves from a slot that holds an element, starts an erased run or is past the block to the next element. */
+			void settle()
+			{
+				while (_block)
+				{
+					if (_idx < _block->end)
+					{
+						_idx += _block->skip[_idx];
+						if (_idx < _block->end)
+							return;
+					}
+
+					_block = _block->next;
+					_idx = 0;
+				}
+			}
+
+			block* _block = nullptr;
+			size_t _idx = 0;
+		};
+
+	  public:
+		using value_type = T;
+		using iterator = basic_iterator<false>;
+		using const_iterator = basic_iterator<true>;
+
+		// Default constructor
+		hive() {}
+
+		// Initializer list constructor
+		hive(std::initializer_list<T> list)
+		{
+			for (const T& elem : list)
+				insert(elem);
+		}
+
+		// Copy constructor
+		hive(const hive& other)
+		{
+			for (const T& elem : other)
+				insert(elem);
+		}
+
+		// Move constructor
+		hive(hive&& other) noexcept
+		{
+			swap(other);
+		}
+
+		// Copy assignment operator
+		hive& operator=(const hive& other)
+		{
+			if (this != &other)
+			{
+				hive copy(other);
+				swap(copy);
+			}
+
+			return *this;
+		}
+
+		// Move assignment operator
+		hive& operator=(hive&& other) noexcept
+		{
+			if (this != &other)
+			{
+				clear();
+				swap(other);
+			}
+
+			return *this;
+		}
+
+		~hive()
+		{
+			clear();
+			delete _spare;
+		}
+
+
+		size_t size() const { return _size; }
+		bool empty() const { return _size == 0; }
+
+		/* Slots in the blocks in use, erased ones included. */
+		size_t capacity() const { return _capacity; }
+
+		iterator begin() { iterator it(_first, 0); it.settle(); return it; }
+		iterator end() { return {}; }
+		const_iterator begin() const { const_iterator it(_first, 0); it.settle(); return it; }
+		const_iterator end() const { return {}; }
+
+		iterator insert(const T& value) { return emplace(value); }
+		iterator insert(T&& value) { return emplace(std::move(value)); }
+
+		/* Constructs the element in an erased slot if there is one, otherwise after the last used slot. */
+		template <typename... Args>
+		iterator emplace(Args&&... args)
+		{
+			if (_erased)
+				return emplace_in_erased(std::forward<Args>(args)...);
+
+			if (!_last || _last->end == _last->capacity)
+				add_block();
+
+			block* b = _last;
+			std::construct_at(&b->slots[b->end].value, std::forward<Args>(args)...);
+			b->count++;
+			_size++;
+
+			return { b, b->end++ };
+		}
+
+		/* Destroys the element, returns the iterator to the element after it. Other iterators stay valid. */
+		iterator erase(const_iterator pos)
+		{
+			block* b = pos._block;
+			const size_t i = pos._idx;
+
+			std::destroy_at(&b->slots[i].value);
+			_size--;
+
+			if (--b->count == 0)
+			{
+				iterator next(b->next, 0);
+				next.settle();
+				release_block(b);
+				return next;
+			}
+
+			// Lengths of the erased runs ending just before i and starting just after it (0 if there is an element)
+			const size_t left = i > 0 ? b->skip[i - 1] : 0;
+			const size_t right = b->skip[i + 1];
+
+			if (left == 0 && right == 0)
+			{
+				b->skip[i] = 1;
+				push_free(b, i);
+			}
+			else if (right == 0)  // Extends the run on the left
+			{
+				b->skip[i - left] = b->skip[i] = static_cast<skip_type>(left + 1);
+			}
+			else if (left == 0)  // The run on the right now starts at i
+			{
+				b->skip[i] = b->skip[i + right] = static_cast<skip_type>(right + 1);
+				move_free(b, i + 1, i);
+			}
+			else  // Joins both runs into the left one
+			{
+				b->skip[i - left] = b->skip[i + right] = static_cast<skip_type>(left + right + 1);
+				remove_free(b, i + 1);
+			}
+
+			iterator next(b, i + right + 1);
+			next.settle();
+			return next;
+		}
+
+		/* Iterator to the element at p (a pointer to an element of this hive). O(number of blocks). */
+		iterator get_iterator(const T* p)
+		{
+			const slot* s = reinterpret_cast<const slot*>(p);
+			for (block* b = _first; b; b = b->next)
+			{
+				const slot* first = b->slots.get();
+				if (!std::less<const slot*>()(s, first) && std::less<const slot*>()(s, first + b->end))
+					return { b, static_cast<size_t>(s - first) };
+			}
+
+			return end();
+		}
+
+		void clear()
+		{
+			block* b = _first;
+			while (b)
+			{
+				if constexpr (!std::is_trivially_destructible_v<T>)
+				{
+					for (size_t i = b->skip[0]; i < b->end; i++, i += b->skip[i])
+						std::destroy_at(&b->slots[i].value);
+				}
+
+				block* next = b->next;
+				delete b;
+				b = next;
+			}
+
+			_first = _last = _erased = nullptr;
+			_size = _capacity = 0;
+		}
+
+		void swap(hive& other) noexcept
+		{
+			std::swap(_first, other._first);
+			std::swap(_last, other._last);
+			std::swap(_erased, other._erased);
+			std::swap(_spare, other._spare);
+			std::swap(_size, other._size);
+			std::swap(_capacity, other._capacity);
+		}
+
+		friend std::ostream& operator<<(std::ostream& out, const hive& h)
+		{
+			out << "{";
+			for (auto it = h.begin(); it != h.end(); ++it)
+				out << (it == h.begin() ? "" : ", ") << *it;
+			return out << "}";
+		}
+
+	  private:
+		/* Takes the first slot of the first erased run of the first block with erased slots. */
+		template <typename... Args>
+		iterator emplace_in_erased(Args&&... args)
+		{
+			block* b = _erased;
+			const size_t s = b->free_head;
+			const size_t length = b->skip[s];
+			const auto links = b->slots[s].links;
+
+			try
+			{
+				std::construct_at(&b->slots[s].value, std::forward<Args>(args)...);
+			}
+			catch (...)
+			{
+				b->slots[s].links = links;
+				throw;
+			}
+
+			b->skip[s] = 0;
+			if (length > 1)  // The rest of the run stays in the free list, starting one slot later
+			{
+				b->skip[s + 1] = b->skip[s + length - 1] = static_cast<skip_type>(length - 1);
+				b->slots[s + 1].links = links;
+				b->free_head = static_cast<skip_type>(s + 1);
+				if (links.next != no_slot)
+					b->slots[links.next].links.prev = static_cast<skip_type>(s + 1);
+			}
+			else
+			{
+				b->free_head = links.next;
+				if (links.next != no_slot)
+					b->slots[links.next].links.prev = no_slot;
+				else
+					unlink_erased(b);
+			}
+
+			b->count++;
+			_size++;
+			return { b, s };
+		}
+
+		void push_free(block* b, size_t s)
+		{
+			if (b->free_head == no_slot)
+				link_erased(b);
+			else
+				b->slots[b->free_head].links.prev = static_cast<skip_type>(s);
+
+			b->slots[s].links = { no_slot, b->free_head };
+			b->free_head = static_cast<skip_type>(s);
+		}
+
+		/* The run starting at from now starts at to. */
+		void move_free(block* b, size_t from, size_t to)
+		{
+			const auto links = b->slots[from].links;
+			b->slots[to].links = links;
+
+			if (links.prev != no_slot)
+				b->slots[links.prev].links.next = static_cast<skip_type>(to);
+			else
+				b->free_head = static_cast<skip_type>(to);
+
+			if (links.next != no_slot)
+				b->slots[links.next].links.prev = static_cast<skip_type>(to);
+		}
+
+		void remove_free(block* b, size_t s)
+		{
+			const auto links = b->slots[s].links;
+
+			if (links.prev != no_slot)
+				b->slots[links.prev].links.next = links.next;
+			else
+				b->free_head = links.next;
+
+			if (links.next != no_slot)
+				b->slots[links.next].links.prev = links.prev;
+		}
+
+		void link_erased(block* b)
+		{
+			b->prev_erased = nullptr;
+			b->next_erased = _erased;
+			if (_erased)
+				_erased->prev_erased = b;
+			_erased = b;
+		}
+
+		void unlink_erased(block* b)
+		{
+			if (b->prev_erased)
+				b->prev_erased->next_erased = b->next_erased;
+			else
+				_erased = b->next_erased;
+
+			if (b->next_erased)
+				b->next_erased->prev_erased = b->prev_erased;
+
+			b->prev_erased = b->next_erased = nullptr;
+		}
+
+		/* Appends a block with about as many slots as there are elements, so the blocks grow geometrically. */
+		void add_block()
+		{
+			block* b = nullptr;
+			if (_spare)
+				b = std::exchange(_spare, nullptr);
+			else
+				b = new block(std::clamp(_size, min_block, max_block));
+
+			b->prev = _last;
+			b->next = nullptr;
+			if (_last)
+				_last->next = b;
+			else
+				_first = b;
+			_last = b;
+
+			_capacity += b->capacity;
+		}
+
+		/* Takes an empty block out of the hive and keeps it for reuse if it is the largest one seen. */
+		void release_block(block* b)
+		{
+			if (b->free_head != no_slot)
+				unlink_erased(b);
+
+			if (b->prev)
+				b->prev->next = b->next;
+			else
+				_first = b->next;
+
+			if (b->next)
+				b->next->prev = b->prev;
+			else
+				_last = b->prev;
+
+			_capacity -= b->capacity;
+
+			std::fill_n(b->skip.get(), b->capacity + 1, skip_type(0));
+			b->end = b->count = 0;
+			b->free_head = no_slot;
+			b->prev = b->next = nullptr;
+
+			if (_spare && _spare->capacity >= b->capacity)
+			{
+				delete b;
+				return;
+			}
+
+			delete _spare;
+			_spare = b;
+		}
+
+		block* _first = nullptr;
+		block* _last = nullptr;
+		block* _erased = nullptr;
+		block* _spare = nullptr;
+		size_t _size = 0;
+		size_t _capacity = 0;
+	};
+}
+
+
+/// <summary>
+/// Erases and inserts entities while keeping pointers to them, then iterates over the hive with holes in it.
+/// </summary>
+int hive_demo()
+{
+	cpplab::hive<int> entities = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 };
+	int* seven = nullptr;
+	for (int& e : entities)
+		if (e == 7)
+			seven = &e;
+
+	for (auto it = entities.begin(); it != entities.end();)
+		it = (*it % 2 == 0) ? entities.erase(it) : std::next(it);
+	std::cout << "odd entities " << entities << " (size=" << entities.size() << "; capacity=" << entities.capacity() << ")\n";
+
+	entities.insert(100);
+	entities.insert(200);
+	std::cout << "after two inserts " << entities << ", erased slots were reused\n";
+	std::cout << "pointer taken before the erases still points at " << *seven << "\n";
+
+
+	return 0;
+}
+
+
+/// <summary>
+/// Entity churn: every round erases 10% of the entities at random and inserts as many new ones, then sums all of them.
+/// Compares hive with std::list (stable pointers, one allocation per element) and std::vector with swap-and-pop
+/// erase (fast, but every erase moves an element and breaks the pointers to it).
+/// </summary>
+int hive_benchmark()
+{
+	using clock = cpplab::bench::clock;
+	using cpplab::bench::ms_since;
+
+	struct entity
+	{
+		float position[3];
+		float velocity[3];
+		std::uint64_t id;
+	};
+
+	const size_t count = 1 << 18;
+	const size_t rounds = 50;
+	const size_t churn = count / 10;
+
+	auto run = [&](auto& container, auto& handles, auto insert, auto erase)
+	{
+		std::mt19937 generator(9);
+		std::uint64_t next_id = 0;
+		double sum = 0;
+
+		auto start = clock::now();
+		for (size_t i = 0; i < count; i++)
+			handles.push_back(insert(container, entity{ { 1, 2, 3 }, { 0.5f, 0.5f, 0.5f }, next_id++ }));
+
+		for (size_t round = 0; round < rounds; round++)
+		{
+			for (size_t i = 0; i < churn; i++)
+			{
+				size_t victim = std::uniform_int_distribution<size_t>(0, handles.size() - 1)(generator);
+				erase(container, handles, victim);
+			}
+			for (size_t i = 0; i < churn; i++)
+				handles.push_back(insert(container, entity{ { 1, 2, 3 }, { 0.5f, 0.5f, 0.5f }, next_id++ }));
+
+			for (const entity& e : container)
+				sum += e.position[0] + e.velocity[0];
+		}
+
+		return std::make_pair(ms_since(start), sum);
+	};
+
+	cpplab::hive<entity> hive;
+	std::vector<cpplab::hive<entity>::iterator> hive_handles;
+	auto [hive_ms, hive_sum] = run(hive, hive_handles,
+		[](auto& c, entity e) { return c.insert(e); },
+		[](auto& c, auto& handles, size_t victim)
+		{
+			c.erase(handles[victim]);
+			handles[victim] = handles.back();
+			handles.pop_back();
+		});
+
+	std::list<entity> list;
+	std::vector<std::list<entity>::iterator> list_handles;
+	auto [list_ms, list_sum] = run(list, list_handles,
+		[](auto& c, entity e) { return c.insert(c.end(), e); },
+		[](auto& c, auto& handles, size_t victim)
+		{
+			c.erase(handles[victim]);
+			handles[victim] = handles.back();
+			handles.pop_back();
+		});
+
+	// Handles are positions here, and erase moves the last entity into the hole
+	std::vector<entity> vec;
+	std::vector<size_t> vec_handles;
+	auto [vec_ms, vec_sum] = run(vec, vec_handles,
+		[](auto& c, entity e) { c.push_back(e); return c.size() - 1; },
+		[](auto& c, auto& handles, size_t victim)
+		{
+			c[victim] = c.back();
+			c.pop_back();
+			handles.pop_back();
+		});
+
+	std::cout << count << " entities, " << rounds << " rounds of " << churn << " erases + inserts + a full pass\n";
+	std::cout << "hive " << hive_ms << " ms (" << hive_sum << "; " << hive.capacity() << " slots), std::list " << list_ms << " ms ("
+		<< list_sum << "), std::vector swap-and-pop " << vec_ms << " ms (" << vec_sum << ", pointers not stable)\n";
+
+
+	return 0;
+}
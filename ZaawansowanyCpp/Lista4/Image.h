@@ -0,0 +1,561 @@
+// 8-bit images with packed pixels (RGB8, RGBA8 or gray) and a processing pipeline running band by band on a thread pool
+
+#pragma once
+
+#include <iostream>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <vector>
+
+#include "Zadanie4_2.h"
+#include "Simd_image.h"
+#include "../Lista3/Thread_pool.h"
+#include "../Common/Bench_timer.h"
+
+
+namespace cpplab
+{
+	enum class pixel_format { gray8, rgb8, rgba8 };
+
+	inline size_t channels_of(pixel_format format)
+	{
+		switch (format)
+		{
+			case pixel_format::gray8: return 1;
+			case pixel_format::rgb8: return 3;
+			default: return 4;
+		}
+	}
+
+	inline const char* format_name(pixel_format format)
+	{
+		switch (format)
+		{
+			case pixel_format::gray8: return "gray8";
+			case pixel_format::rgb8: return "rgb8";
+			default: return "rgba8";
+		}
+	}
+
+	/// <summary>
+	/// Image of width x height pixels with one byte per channel, stored row by row. Every row starts on a 64-byte boundary
+	/// (stride() is the distance between rows in bytes), so SIMD loads of a row never split a cache line at its start
+	/// and the rows can be processed by different threads without sharing cache lines.
+	/// </summary>
+	class image
+	{
+	  public:
+		static constexpr size_t row_alignment = 64;
+
+		// Default constructor
+		image() {}
+
+		/* Image with all bytes set to zero (black, and transparent for RGBA). */
+		image(size_t width, size_t height, pixel_format format = pixel_format::rgba8)
+			: _width(width), _height(height), _format(format),
+			  _stride((width * channels_of(format) + row_alignment - 1) / row_alignment * row_alignment)
+		{
+			_data = allocate(bytes());
+			if (_data)
+				std::memset(_data, 0, bytes());
+		}
+
+		// Copy constructor
+		image(const image& img)
+			: _width(img._width), _height(img._height), _format(img._format), _stride(img._stride)
+		{
+			_data = allocate(bytes());
+			if (_data)
+				std::memcpy(_data, img._data, bytes());
+		}
+
+		// Move constructor
+		image(image&& img) noexcept
+		{
+			take(std::move(img));
+		}
+
+		~image() { release(); }
+
+		// Copy assignment operator
+		image& operator=(const image& img)
+		{
+			if (this == &img)
+			{
+				return *this;
+			}
+
+			image copy(img);
+			release();
+			take(std::move(copy));
+
+			return *this;
+		}
+
+		// Move assignment operator
+		image& operator=(image&& img) noexcept
+		{
+			if (this == &img)
+			{
+				return *this;
+			}
+
+			release();
+			take(std::move(img));
+
+			return *this;
+		}
+
+		/* Packs a row-major vector of Pixels (channels outside [0, 255] are clamped, alpha is set to 255). */
+		static image from_pixels(const vector<Pixel>& pixels, size_t width, size_t height, pixel_format format = pixel_format::rgba8)
+		{
+			if (pixels.size() != width * height) throw std::invalid_argument("Number of pixels does not match the dimensions");
+
+			image result(width, height, format);
+			for (size_t y = 0; y < height; y++)
+			{
+				for (size_t x = 0; x < width; x++)
+					result.set_pixel(x, y, pixels[y * width + x]);
+			}
+
+			return result;
+		}
+
+
+		size_t width() const { return _width; }
+		size_t height() const { return _height; }
+		pixel_format format() const { return _format; }
+		size_t channels() const { return channels_of(_format); }
+		size_t stride() const { return _stride; }
+		size_t bytes() const { return _stride * _height; }
+
+		std::uint8_t* data() { return _data; }
+		const std::uint8_t* data() const { return _data; }
+
+		std::uint8_t* row(size_t y) { return _data + y * _stride; }
+		const std::uint8_t* row(size_t y) const { return _data + y * _stride; }
+
+		/* Pixel at (x, y), gray images give the same value in all three channels. */
+		Pixel pixel(size_t x, size_t y) const
+		{
+			check(x, y);
+			const std::uint8_t* p = row(y) + x * channels();
+
+			Pixel result;
+			result.r = p[0];
+			result.g = channels() == 1 ? p[0] : p[1];
+			result.b = channels() == 1 ? p[0] : p[2];
+			return result;
+		}
+
+		void set_pixel(size_t x, size_t y, const Pixel& pixel)
+		{
+			check(x, y);
+			std::uint8_t* p = row(y) + x * channels();
+			auto clamp = [](int value) { return static_cast<std::uint8_t>(std::clamp(value, 0, 255)); };
+
+			if (_format == pixel_format::gray8)
+			{
+				p[0] = simd::gray_value(clamp(pixel.r), clamp(pixel.g), clamp(pixel.b));
+				return;
+			}
+
+			p[0] = clamp(pixel.r);
+			p[1] = clamp(pixel.g);
+			p[2] = clamp(pixel.b);
+			if (_format == pixel_format::rgba8)
+				p[3] = 255;
+		}
+
+		friend std::ostream& operator<<(std::ostream& out, const image& img)
+		{
+			out << "image(" << img._width << "x" << img._height << ", " << format_name(img._format) << ", stride " << img._stride << ")";
+			return out;
+		}
+
+	  private:
+		static std::uint8_t* allocate(size_t bytes)
+		{
+			return bytes > 0 ? static_cast<std::uint8_t*>(::operator new(bytes, std::align_val_t(row_alignment))) : nullptr;
+		}
+
+		void check(size_t x, size_t y) const
+		{
+			if (x >= _width || y >= _height) throw std::range_error("Provided index is out of bounds");
+		}
+
+		void take(image&& img)
+		{
+			_width = img._width;
+			_height = img._height;
+			_format = img._format;
+			_stride = img._stride;
+			_data = img._data;
+
+			img._width = img._height = img._stride = 0;
+			img._data = nullptr;
+		}
+
+		void release()
+		{
+			::operator delete(_data, std::align_val_t(row_alignment));
+			_data = nullptr;
+		}
+
+		size_t _width = 0;
+		size_t _height = 0;
+		pixel_format _format = pixel_format::rgba8;
+		size_t _stride = 0;
+		std::uint8_t* _data = nullptr;
+	};
+
+	// Counts of every byte value, one table per channel (unused channels stay zero)
+	using histogram = std::array<std::array<std::uint64_t, 256>, 4>;
+
+	namespace detail
+	{
+		constexpr size_t image_tile_bytes = 64 * 1024;     // Rows handled by one task of a pointwise operation, they stay in L2 between reading and writing
+		constexpr size_t blur_tile_bytes = 128 * 1024;     // Output rows of one blur task, the intermediate rows of the band fit into L2 as well
+		constexpr size_t image_parallel_bytes = 1 << 18;   // Smaller images are processed by the calling thread only
+		constexpr size_t max_blur_radius = 31;             // weighted_sum() takes at most 64 taps
+
+		/* Calls f(first_row, last_row) for bands of rows of about band_bytes each, in parallel for large images. */
+		template <typename F>
+		void for_each_band(size_t height, size_t stride, size_t band_bytes, size_t total_bytes, thread_pool& pool, F&& f)
+		{
+			size_t rows_per_band = std::max<size_t>(1, band_bytes / std::max<size_t>(1, stride));
+			size_t bands = (height + rows_per_band - 1) / rows_per_band;
+
+			auto run = [&](size_t band) { f(band * rows_per_band, std::min(height, (band + 1) * rows_per_band)); };
+
+			if (bands <= 1 || total_bytes < image_parallel_bytes)
+			{
+				for (size_t band = 0; band < bands; band++)
+					run(band);
+			}
+			else
+			{
+				pool.parallel_for(bands, run);
+			}
+		}
+
+		/* Separable filter: every row is filtered horizontally, then every column vertically, with edge pixels repeated. */
+		inline image separable_filter(const image& src, const std::vector<float>& weights, thread_pool& pool)
+		{
+			const size_t radius = weights.size() / 2;
+			const size_t channels = src.channels();
+			const size_t row_bytes = src.width() * channels;
+			image dst(src.width(), src.height(), src.format());
+
+			if (src.width() == 0 || src.height() == 0)
+				return dst;
+
+			for_each_band(src.height(), src.stride(), blur_tile_bytes, src.bytes(), pool, [&](size_t first, size_t last)
+				{
+					// Rows [first - radius, last + radius) filtered horizontally, rows above and below the image repeat the edge rows
+					const size_t band_rows = last - first + 2 * radius;
+					std::vector<std::uint8_t> horizontal(band_rows * row_bytes);
+					std::vector<std::uint8_t> padded((src.width() + 2 * radius) * channels);
+					std::vector<const std::uint8_t*> taps(weights.size());
+
+					for (size_t r = 0; r < band_rows; r++)
+					{
+						size_t y = std::clamp<std::ptrdiff_t>(static_cast<std::ptrdiff_t>(first + r) - static_cast<std::ptrdiff_t>(radius),
+							0, static_cast<std::ptrdiff_t>(src.height() - 1));
+						const std::uint8_t* in = src.row(y);
+
+						// The row with its first and last pixels repeated radius times on either side
+						for (size_t k = 0; k < radius; k++)
+						{
+							std::memcpy(padded.data() + k * channels, in, channels);
+							std::memcpy(padded.data() + (radius + src.width() + k) * channels, in + row_bytes - channels, channels);
+						}
+						std::memcpy(padded.data() + radius * channels, in, row_bytes);
+
+						for (size_t k = 0; k < taps.size(); k++)
+							taps[k] = padded.data() + k * channels;
+						simd::weighted_sum(taps.data(), weights.data(), taps.size(), horizontal.data() + r * row_bytes, row_bytes);
+					}
+
+					for (size_t y = first; y < last; y++)
+					{
+						for (size_t k = 0; k < taps.size(); k++)
+							taps[k] = horizontal.data() + (y - first + k) * row_bytes;
+						simd::weighted_sum(taps.data(), weights.data(), taps.size(), dst.row(y), row_bytes);
+					}
+				});
+
+			return dst;
+		}
+	}
+
+	/// <summary>
+	/// Changes brightness and contrast in place: every color channel becomes contrast * (value - 128) + 128 + brightness,
+	/// rounded and clamped to [0, 255]. Alpha is left unchanged.
+	/// </summary>
+	inline void adjust(image& img, float brightness, float contrast, thread_pool& pool = thread_pool::shared())
+	{
+		const float offset = 128.0f - 128.0f * contrast + brightness;
+		const bool keep_alpha = img.format() == pixel_format::rgba8;
+		const size_t row_bytes = img.width() * img.channels();
+
+		detail::for_each_band(img.height(), img.stride(), detail::image_tile_bytes, img.bytes(), pool, [&](size_t first, size_t last)
+			{
+				for (size_t y = first; y < last; y++)
+					simd::adjust_row(img.row(y), img.row(y), row_bytes, contrast, offset, keep_alpha);
+			});
+	}
+
+	/// <summary>Gray (luma) copy of an RGB or RGBA image, see simd::gray_value for the weights.</summary>
+	inline image to_grayscale(const image& img, thread_pool& pool = thread_pool::shared())
+	{
+		if (img.format() == pixel_format::gray8)
+			return img;
+
+		image result(img.width(), img.height(), pixel_format::gray8);
+		detail::for_each_band(img.height(), img.stride(), detail::image_tile_bytes, img.bytes(), pool, [&](size_t first, size_t last)
+			{
+				for (size_t y = first; y < last; y++)
+					simd::gray_row(img.row(y), result.row(y), img.width(), img.channels());
+			});
+
+		return result;
+	}
+
+	/// <summary>Average of the (2 * radius + 1) x (2 * radius + 1) square around every pixel, radius at most 31.</summary>
+	inline image box_blur(const image& img, size_t radius, thread_pool& pool = thread_pool::shared())
+	{
+		if (radius > detail::max_blur_radius) throw std::invalid_argument("Blur radius must be at most 31");
+
+		std::vector<float> weights(2 * radius + 1, 1.0f / (2 * radius + 1));
+		return detail::separable_filter(img, weights, pool);
+	}
+
+	/// <summary>Gaussian blur with the given standard deviation in pixels, the kernel reaches 3 sigma (at most 31 pixels) each way.</summary>
+	inline image gaussian_blur(const image& img, float sigma, thread_pool& pool = thread_pool::shared())
+	{
+		if (!(sigma > 0)) throw std::invalid_argument("Sigma must be positive");
+
+		size_t radius = static_cast<size_t>(std::ceil(3 * sigma));
+		if (radius > detail::max_blur_radius) throw std::invalid_argument("Sigma must be at most 10 pixels");
+
+		std::vector<float> weights(2 * radius + 1);
+		float total = 0;
+		for (size_t k = 0; k < weights.size(); k++)
+		{
+			float d = static_cast<float>(k) - static_cast<float>(radius);
+			weights[k] = std::exp(-d * d / (2 * sigma * sigma));
+			total += weights[k];
+		}
+		for (float& w : weights)
+			w /= total;
+
+		return detail::separable_filter(img, weights, pool);
+	}
+
+	/// <summary>
+	/// Number of pixels with every value of every channel. Each band counts into its own tables, split further into four
+	/// copies that alternate between pixels, so runs of equal values do not wait on the same counter. The tables are added at the end.
+	/// </summary>
+	inline histogram channel_histogram(const image& img, thread_pool& pool = thread_pool::shared())
+	{
+		const size_t channels = img.channels();
+		const size_t rows_per_band = std::max<size_t>(1, detail::image_tile_bytes / std::max<size_t>(1, img.stride()));
+		const size_t bands = (img.height() + rows_per_band - 1) / rows_per_band;
+
+		std::vector<std::array<std::array<std::uint32_t, 256>, 16>> partial(std::max<size_t>(1, bands));
+
+		detail::for_each_band(img.height(), img.stride(), detail::image_tile_bytes, img.bytes(), pool, [&](size_t first, size_t last)
+			{
+				auto& tables = partial[first / rows_per_band];  // tables[4 * copy + channel]
+				for (auto& table : tables)
+					table.fill(0);
+
+				// The number of channels is a compile-time constant inside, so the loop over them is unrolled
+				auto count = [&]<size_t C>()
+					{
+						for (size_t y = first; y < last; y++)
+						{
+							const std::uint8_t* p = img.row(y);
+							size_t x = 0;
+
+							for (; x + 4 <= img.width(); x += 4, p += 4 * C)
+							{
+								for (size_t c = 0; c < C; c++)
+								{
+									tables[c][p[c]]++;
+									tables[4 + c][p[C + c]]++;
+									tables[8 + c][p[2 * C + c]]++;
+									tables[12 + c][p[3 * C + c]]++;
+								}
+							}
+
+							for (; x < img.width(); x++, p += C)
+							{
+								for (size_t c = 0; c < C; c++)
+									tables[c][p[c]]++;
+							}
+						}
+					};
+
+				if (channels == 1)
+					count.template operator()<1>();
+				else if (channels == 3)
+					count.template operator()<3>();
+				else
+					count.template operator()<4>();
+			});
+
+		histogram result{};
+		for (size_t band = 0; band < bands; band++)
+		{
+			for (size_t copy = 0; copy < 4; copy++)
+			{
+				for (size_t c = 0; c < channels; c++)
+				{
+					for (size_t v = 0; v < 256; v++)
+						result[c][v] += partial[band][4 * copy + c][v];
+				}
+			}
+		}
+
+		return result;
+	}
+}
+
+
+int image_demo()
+{
+	cpplab::image img(4, 2, cpplab::pixel_format::rgb8);
+	Pixel red;
+	red.r = 255;
+	img.set_pixel(0, 0, red);
+
+	cpplab::adjust(img, 20.0f, 1.0f);
+	cpplab::image gray = cpplab::to_grayscale(img);
+	cpplab::image blurred = cpplab::box_blur(img, 1);
+
+	std::cout << img << "\n";
+	std::cout << "pixel(0, 0) = " << img.pixel(0, 0) << ", gray " << gray.pixel(0, 0).r << ", blurred " << blurred.pixel(0, 0) << "\n";
+	std::cout << "red histogram: " << cpplab::channel_histogram(img)[0][20] << " pixels of 20\n";
+
+
+	return 0;
+}
+
+/// <summary>
+/// A 1920x1080 frame processed by the image kernels and by plain loops over a vector of Pixels (three ints per pixel):
+/// brightness/contrast, grayscale, a 5x5 box blur and the histograms of the channels.
+/// </summary>
+int image_benchmark()
+{
+	using clock = cpplab::bench::clock;
+	using cpplab::bench::ms_since;
+
+	const size_t width = 1920, height = 1080, radius = 2;
+
+	cpplab::vector<Pixel> pixels;
+	pixels.resize(width * height);
+	for (size_t i = 0; i < pixels.size(); i++)
+	{
+		pixels[i].r = static_cast<int>(i * 7 % 256);
+		pixels[i].g = static_cast<int>(i * 13 % 256);
+		pixels[i].b = static_cast<int>(i % 256);
+	}
+	cpplab::image frame = cpplab::image::from_pixels(pixels, width, height);
+
+	std::cout << "Frame " << frame << ", " << cpplab::thread_pool::shared().size() << " threads, SIMD: "
+		<< cpplab::simd::level_name(cpplab::simd::active_level()) << "\n";
+
+	// Brightness and contrast
+	auto start = clock::now();
+	for (size_t i = 0; i < pixels.size(); i++)
+	{
+		pixels[i].r = std::clamp(static_cast<int>(std::lround(1.2f * (pixels[i].r - 128) + 128 + 10)), 0, 255);
+		pixels[i].g = std::clamp(static_cast<int>(std::lround(1.2f * (pixels[i].g - 128) + 128 + 10)), 0, 255);
+		pixels[i].b = std::clamp(static_cast<int>(std::lround(1.2f * (pixels[i].b - 128) + 128 + 10)), 0, 255);
+	}
+	double naive_adjust = ms_since(start);
+
+	start = clock::now();
+	cpplab::adjust(frame, 10.0f, 1.2f);
+	double fast_adjust = ms_since(start);
+
+	// Grayscale
+	start = clock::now();
+	std::vector<std::uint8_t> gray_pixels(pixels.size());
+	for (size_t i = 0; i < pixels.size(); i++)
+		gray_pixels[i] = static_cast<std::uint8_t>((38 * pixels[i].r + 75 * pixels[i].g + 15 * pixels[i].b + 64) >> 7);
+	double naive_gray = ms_since(start);
+
+	start = clock::now();
+	cpplab::image gray = cpplab::to_grayscale(frame);
+	double fast_gray = ms_since(start);
+
+	// Box blur, the naive version averages the whole square around every pixel
+	start = clock::now();
+	cpplab::vector<Pixel> blurred;
+	blurred.resize(pixels.size());
+	const int r = static_cast<int>(radius), w = static_cast<int>(width), h = static_cast<int>(height);
+	for (int y = 0; y < h; y++)
+	{
+		for (int x = 0; x < w; x++)
+		{
+			int sum_r = 0, sum_g = 0, sum_b = 0;
+			for (int dy = -r; dy <= r; dy++)
+			{
+				for (int dx = -r; dx <= r; dx++)
+				{
+					const Pixel& p = pixels[std::clamp(y + dy, 0, h - 1) * width + std::clamp(x + dx, 0, w - 1)];
+					sum_r += p.r;
+					sum_g += p.g;
+					sum_b += p.b;
+				}
+			}
+
+			Pixel& out = blurred[y * width + x];
+			out.r = sum_r / ((2 * r + 1) * (2 * r + 1));
+			out.g = sum_g / ((2 * r + 1) * (2 * r + 1));
+			out.b = sum_b / ((2 * r + 1) * (2 * r + 1));
+		}
+	}
+	double naive_blur = ms_since(start);
+
+	start = clock::now();
+	cpplab::image blurred_frame = cpplab::box_blur(frame, radius);
+	double fast_blur = ms_since(start);
+
+	// Histograms (the image also counts the alpha channel)
+	start = clock::now();
+	cpplab::histogram naive_counts{};
+	for (size_t i = 0; i < pixels.size(); i++)
+	{
+		naive_counts[0][pixels[i].r]++;
+		naive_counts[1][pixels[i].g]++;
+		naive_counts[2][pixels[i].b]++;
+	}
+	double naive_histogram = ms_since(start);
+
+	start = clock::now();
+	cpplab::histogram counts = cpplab::channel_histogram(frame);
+	double fast_histogram = ms_since(start);
+
+	bool same = counts[0] == naive_counts[0] && counts[2] == naive_counts[2] && gray.pixel(5, 5).r == gray_pixels[5 * width + 5];
+
+	std::cout << "brightness/contrast: vector<Pixel> " << naive_adjust << " ms, image " << fast_adjust << " ms\n";
+	std::cout << "grayscale:           vector<Pixel> " << naive_gray << " ms, image " << fast_gray << " ms\n";
+	std::cout << "5x5 box blur:        vector<Pixel> " << naive_blur << " ms, image " << fast_blur << " ms\n";
+	std::cout << "histograms:          vector<Pixel> " << naive_histogram << " ms, image " << fast_histogram << " ms"
+		<< (same ? "" : " (RESULTS DIFFER)") << "\n";
+	std::cout << "memory:              vector<Pixel> " << pixels.size() * sizeof(Pixel) / 1024 << " KiB, image " << frame.bytes() / 1024 << " KiB\n";
+
+	(void)blurred_frame;
+
+
+	return 0;
+}
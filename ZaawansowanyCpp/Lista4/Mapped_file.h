@@ -0,0 +1,150 @@
+// Read-only view of a whole file: memory-mapped on POSIX systems, read into memory elsewhere
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Also detected in Lista1/Zeroed_memory.h, whichever is included first defines it
+#ifndef CPPLAB_HAS_MMAP
+	#if defined(__unix__) || defined(__APPLE__)
+		#define CPPLAB_HAS_MMAP 1
+	#else
+		#define CPPLAB_HAS_MMAP 0
+	#endif
+#endif
+
+#if CPPLAB_HAS_MMAP
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+
+namespace cpplab
+{
+	/// <summary>
+	/// The bytes of a file, mapped into memory. Pages are read by the kernel when they are first touched and are shared with
+	/// the page cache, so opening a file costs almost nothing and nothing is copied. Without mmap the file is read at once.
+	/// </summary>
+	class mapped_file
+	{
+	  public:
+		// Default constructor
+		mapped_file() {}
+
+		explicit mapped_file(const std::string& path)
+		{
+#if CPPLAB_HAS_MMAP
+			int fd = ::open(path.c_str(), O_RDONLY);
+			if (fd < 0) throw std::runtime_error("Cannot open " + path);
+
+			struct stat info;
+			if (::fstat(fd, &info) != 0)
+			{
+				::close(fd);
+				throw std::runtime_error("Cannot read the size of " + path);
+			}
+
+			_size = static_cast<size_t>(info.st_size);
+			if (_size > 0)
+			{
+				void* p = ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+				if (p == MAP_FAILED)
+				{
+					::close(fd);
+					throw std::runtime_error("Cannot map " + path);
+				}
+				_data = static_cast<const std::uint8_t*>(p);
+			}
+
+			// The mapping keeps the file alive on its own
+			::close(fd);
+#else
+			std::ifstream file(path, std::ios::binary | std::ios::ate);
+			if (!file) throw std::runtime_error("Cannot open " + path);
+
+			_buffer.resize(static_cast<size_t>(file.tellg()));
+			file.seekg(0);
+			file.read(reinterpret_cast<char*>(_buffer.data()), static_cast<std::streamsize>(_buffer.size()));
+			if (!file) throw std::runtime_error("Cannot read " + path);
+
+			_data = _buffer.data();
+			_size = _buffer.size();
+#endif
+		}
+
+		mapped_file(const mapped_file&) = delete;
+		mapped_file& operator=(const mapped_file&) = delete;
+
+		// Move constructor
+		mapped_file(mapped_file&& file) noexcept
+		{
+			take(std::move(file));
+		}
+
+		// Move assignment operator
+		mapped_file& operator=(mapped_file&& file) noexcept
+		{
+			if (this == &file)
+			{
+				return *this;
+			}
+
+			release();
+			take(std::move(file));
+
+			return *this;
+		}
+
+		~mapped_file() { release(); }
+
+
+		const std::uint8_t* data() const { return _data; }
+		size_t size() const { return _size; }
+		std::span<const std::uint8_t> bytes() const { return { _data, _size }; }
+
+		/* Tells the kernel the file will be read from start to end, so it reads ahead aggressively. */
+		void advise_sequential() const
+		{
+#if CPPLAB_HAS_MMAP
+			if (_data)
+				::madvise(const_cast<std::uint8_t*>(_data), _size, MADV_SEQUENTIAL);
+#endif
+		}
+
+	  private:
+		void take(mapped_file&& file)
+		{
+			_data = std::exchange(file._data, nullptr);
+			_size = std::exchange(file._size, 0);
+#if !CPPLAB_HAS_MMAP
+			_buffer = std::move(file._buffer);
+			_data = _buffer.data();
+#endif
+		}
+
+		void release()
+		{
+#if CPPLAB_HAS_MMAP
+			if (_data)
+				::munmap(const_cast<std::uint8_t*>(_data), _size);
+#endif
+			_data = nullptr;
+			_size = 0;
+		}
+
+		const std::uint8_t* _data = nullptr;
+		size_t _size = 0;
+#if !CPPLAB_HAS_MMAP
+		std::vector<std::uint8_t> _buffer;
+#endif
+	};
+}
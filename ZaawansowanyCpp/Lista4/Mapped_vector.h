@@ -0,0 +1,421 @@
+// Vector kept in a memory-mapped file: the file is the storage, so it can be larger than RAM and reopening it is free
+
+#pragma once
+
+#include <iostream>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Mapped_file.h"
+#include "../Lista3/Simd_dot.h"
+#include "../Common/Bench_timer.h"
+
+
+#if CPPLAB_HAS_MMAP
+namespace cpplab
+{
+	enum class map_mode
+	{
+		open_or_create,  // Keeps the elements already in the file
+		create,          // Starts empty, an existing file is truncated
+		read_only        // Existing file, every modification throws
+	};
+
+	// Access pattern hints passed to madvise()
+	enum class access_hint
+	{
+		normal,
+		sequential,  // Reads ahead aggressively and drops pages soon after they were read
+		random,      // No read-ahead
+		willneed,    // Starts reading the pages in the background now
+		dontneed     // The pages can be dropped from memory (they are read from the file again when needed)
+	};
+
+	/// <summary>
+	/// Vector of trivially copyable T stored in a file that is mapped into memory. The kernel moves pages between the file
+	/// and RAM on demand, so the vector can be larger than the physical memory, several processes mapping the same file
+	/// share the pages of the page cache, and reopening a saved vector reads nothing until the elements are used.
+	/// Growing extends the file with ftruncate and the mapping with mremap (the pages are not copied). The elements follow
+	/// a header_bytes long header that holds the size, updated on every change: the file is cut to size() when the vector
+	/// is closed, and a file left longer by a process that never closed it still opens with the right size.
+	/// </summary>
+	template <typename T>
+	class mapped_vector
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "mapped_vector elements are stored as raw bytes and must be trivially copyable");
+
+		struct file_header
+		{
+			static constexpr char magic_bytes[8] = { 'C', 'P', 'P', 'L', 'A', 'B', 'M', 'V' };
+
+			char magic[8];
+			std::uint64_t element_size;
+			std::uint64_t size;  // Elements in use, the rest of the file up to the capacity is spare room
+		};
+
+	  public:
+		using value_type = T;
+		using iterator = T*;
+		using const_iterator = const T*;
+
+		// The elements start this far into the file, which keeps them aligned to a cache line
+		static constexpr size_t header_bytes = 64;
+		static_assert(sizeof(file_header) <= header_bytes && alignof(T) <= header_bytes);
+
+		// Default constructor
+		mapped_vector() {}
+
+		explicit mapped_vector(const std::string& path, map_mode mode = map_mode::open_or_create)
+			: _read_only(mode == map_mode::read_only)
+		{
+			int flags = _read_only ? O_RDONLY : O_RDWR | O_CREAT;
+			if (mode == map_mode::create)
+				flags |= O_TRUNC;
+
+			_fd = ::open(path.c_str(), flags, 0644);
+			if (_fd < 0) throw std::runtime_error("Cannot open " + path);
+
+			try
+			{
+				open_mapping(path);
+			}
+			catch (...)
+			{
+				if (_base)
+					::munmap(_base, mapped_bytes(_capacity));
+				::close(_fd);
+				throw;
+			}
+		}
+
+		mapped_vector(const mapped_vector&) = delete;
+		mapped_vector& operator=(const mapped_vector&) = delete;
+
+		// Move constructor
+		mapped_vector(mapped_vector&& vec) noexcept
+		{
+			take(std::move(vec));
+		}
+
+		// Move assignment operator
+		mapped_vector& operator=(mapped_vector&& vec) noexcept
+		{
+			if (this == &vec)
+			{
+				return *this;
+			}
+
+			close();
+			take(std::move(vec));
+
+			return *this;
+		}
+
+		~mapped_vector() { close(); }
+
+
+		size_t size() const { return _size; }
+		size_t capacity() const { return _capacity; }
+		bool empty() const { return _size == 0; }
+
+		T* data() { return _data; }
+		const T* data() const { return _data; }
+
+		iterator begin() { return _data; }
+		iterator end() { return _data + _size; }
+		const_iterator begin() const { return _data; }
+		const_iterator end() const { return _data + _size; }
+
+		const T& at(size_t idx) const
+		{
+			if (idx >= _size) throw std::range_error("Provided index is out of bounds");
+			return _data[idx];
+		}
+
+		T& at(size_t idx)
+		{
+			if (idx >= _size) throw std::range_error("Provided index is out of bounds");
+			return _data[idx];
+		}
+
+		const T& operator[](size_t idx) const { return _data[idx]; }
+		T& operator[](size_t idx) { return _data[idx]; }
+
+		/* Makes room for new_capacity elements: the file is extended (with zeros) and the mapping grown in place if possible. */
+		void reserve(size_t new_capacity)
+		{
+			if (new_capacity <= _capacity)
+				return;
+
+			check_writable();
+			if (::ftruncate(_fd, static_cast<off_t>(mapped_bytes(new_capacity))) != 0) throw std::runtime_error("Cannot extend the file");
+
+			map(new_capacity);
+		}
+
+		/* New elements are zero bytes, as the file is extended with zeros. */
+		void resize(size_t new_size)
+		{
+			check_writable();
+
+			// Elements between size and the old capacity may hold old values that were popped, the rest of the file is new zeros
+			size_t dirty_end = std::min(new_size, _capacity);
+			if (new_size > _capacity)
+				reserve(new_size);
+			if (dirty_end > _size)
+				std::memset(static_cast<void*>(_data + _size), 0, (dirty_end - _size) * sizeof(T));
+
+			set_size(new_size);
+		}
+
+		void push_back(const T& value)
+		{
+			check_writable();
+			if (_size == _capacity)
+				reserve(std::max(min_capacity(), 2 * _capacity));
+
+			// The element is written before the size that makes it part of the vector
+			_data[_size] = value;
+			set_size(_size + 1);
+		}
+
+		void pop_back()
+		{
+			check_writable();
+			if (_size == 0) throw std::out_of_range("pop_back() called on an empty mapped_vector");
+			set_size(_size - 1);
+		}
+
+		void clear()
+		{
+			check_writable();
+			set_size(0);
+		}
+
+		/* Hint about how the elements will be used, for the whole vector or for the elements [first, first + count). */
+		void advise(access_hint hint) const { advise(hint, 0, _size); }
+
+		void advise(access_hint hint, size_t first, size_t count) const
+		{
+			if (!_base || count == 0)
+				return;
+
+			// madvise needs an address aligned to a page
+			const size_t page = page_size();
+			size_t begin = (header_bytes + first * sizeof(T)) / page * page;
+			size_t end = mapped_bytes(std::min(_capacity, first + count));
+
+			int advice = MADV_NORMAL;
+			switch (hint)
+			{
+				case access_hint::sequential: advice = MADV_SEQUENTIAL; break;
+				case access_hint::random: advice = MADV_RANDOM; break;
+				case access_hint::willneed: advice = MADV_WILLNEED; break;
+				case access_hint::dontneed: advice = MADV_DONTNEED; break;
+				default: break;
+			}
+
+			::madvise(static_cast<char*>(_base) + begin, end - begin, advice);
+		}
+
+		/* Writes the modified pages to the file and waits until they are there. */
+		void sync() const
+		{
+			if (_base && !_read_only && ::msync(_base, mapped_bytes(_capacity), MS_SYNC) != 0) throw std::runtime_error("Cannot write the file");
+		}
+
+		/* Unmaps the file and cuts it to the elements. The vector becomes empty. */
+		void close()
+		{
+			if (_base)
+				::munmap(_base, mapped_bytes(_capacity));
+			if (_fd >= 0)
+			{
+				if (!_read_only && _capacity != _size)
+				{
+					// Nothing can be reported from here, a failed truncation only leaves spare room past the elements
+					[[maybe_unused]] int result = ::ftruncate(_fd, static_cast<off_t>(mapped_bytes(_size)));
+				}
+				::close(_fd);
+			}
+
+			_base = nullptr;
+			_data = nullptr;
+			_size = _capacity = 0;
+			_fd = -1;
+		}
+
+	  private:
+		static size_t page_size() { return static_cast<size_t>(::sysconf(_SC_PAGESIZE)); }
+
+		// The first growth maps a whole page
+		static size_t min_capacity() { return std::max<size_t>(1, page_size() / sizeof(T)); }
+
+		static size_t mapped_bytes(size_t capacity) { return header_bytes + capacity * sizeof(T); }
+
+		file_header* header() const { return static_cast<file_header*>(_base); }
+
+		void check_writable() const
+		{
+			if (_read_only) throw std::logic_error("mapped_vector was opened read-only");
+		}
+
+		/* Keeps the size in the file up to date, so it survives a process that never calls close(). */
+		void set_size(size_t new_size)
+		{
+			_size = new_size;
+			header()->size = new_size;
+		}
+
+		/* Maps the open file, writing the header of an empty new file, and reads the size from the header. */
+		void open_mapping(const std::string& path)
+		{
+			struct stat info;
+			if (::fstat(_fd, &info) != 0) throw std::runtime_error("Cannot read the size of " + path);
+
+			size_t bytes = static_cast<size_t>(info.st_size);
+			const bool fresh = bytes == 0 && !_read_only;
+			if (fresh)
+			{
+				if (::ftruncate(_fd, static_cast<off_t>(header_bytes)) != 0) throw std::runtime_error("Cannot extend the file");
+				bytes = header_bytes;
+			}
+
+			if (bytes < header_bytes || (bytes - header_bytes) % sizeof(T) != 0)
+				throw std::runtime_error(path + " does not hold a whole number of elements");
+
+			map((bytes - header_bytes) / sizeof(T));
+
+			if (fresh)
+			{
+				std::memcpy(header()->magic, file_header::magic_bytes, sizeof(header()->magic));
+				header()->element_size = sizeof(T);
+				header()->size = 0;
+			}
+
+			if (std::memcmp(header()->magic, file_header::magic_bytes, sizeof(header()->magic)) != 0)
+				throw std::runtime_error(path + " is not a mapped_vector file");
+			if (header()->element_size != sizeof(T) || header()->size > _capacity)
+				throw std::runtime_error(path + " does not hold a whole number of elements");
+
+			_size = header()->size;
+		}
+
+		/* Maps (or remaps) the header and the first new_capacity elements of the file. */
+		void map(size_t new_capacity)
+		{
+			const size_t new_bytes = mapped_bytes(new_capacity);
+			void* p = nullptr;
+
+			if (_base)
+			{
+#if defined(__linux__)
+				p = ::mremap(_base, mapped_bytes(_capacity), new_bytes, MREMAP_MAYMOVE);
+#else
+				::munmap(_base, mapped_bytes(_capacity));
+				_base = nullptr;
+				_data = nullptr;
+				p = ::mmap(nullptr, new_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+#endif
+			}
+			else
+			{
+				p = ::mmap(nullptr, new_bytes, _read_only ? PROT_READ : PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+			}
+
+			if (p == MAP_FAILED) throw std::runtime_error("Cannot map the file");
+
+			_base = p;
+			_data = reinterpret_cast<T*>(static_cast<char*>(p) + header_bytes);
+			_capacity = new_capacity;
+		}
+
+		void take(mapped_vector&& vec)
+		{
+			_fd = std::exchange(vec._fd, -1);
+			_base = std::exchange(vec._base, nullptr);
+			_data = std::exchange(vec._data, nullptr);
+			_size = std::exchange(vec._size, 0);
+			_capacity = std::exchange(vec._capacity, 0);
+			_read_only = vec._read_only;
+		}
+
+		int _fd = -1;
+		void* _base = nullptr;  // Start of the mapping: the header, then the elements at _data
+		T* _data = nullptr;
+		size_t _size = 0;
+		size_t _capacity = 0;
+		bool _read_only = false;
+	};
+}
+#endif
+
+
+/// <summary>
+/// Builds a file-backed dataset of floats, closes it, then compares reopening it as a mapped_vector with reading it
+/// into a std::vector, and runs a SIMD dot product and a sort over the mapped elements.
+/// </summary>
+int mapped_vector_demo()
+{
+#if CPPLAB_HAS_MMAP
+	using clock = cpplab::bench::clock;
+	using cpplab::bench::ms_since;
+
+	const size_t count = 1 << 24;
+	const std::string path = (std::filesystem::temp_directory_path() / "cpplab_dataset.bin").string();
+
+	{
+		std::mt19937 generator(1);
+		std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+
+		cpplab::mapped_vector<float> dataset(path, cpplab::map_mode::create);
+		dataset.reserve(count);
+		for (size_t i = 0; i < count; i++)
+			dataset.push_back(uniform(generator));
+	}
+
+	auto start = clock::now();
+	cpplab::mapped_vector<float> mapped(path, cpplab::map_mode::read_only);
+	double open_ms = ms_since(start);
+
+	start = clock::now();
+	std::vector<float> loaded((std::filesystem::file_size(path) - mapped.header_bytes) / sizeof(float));
+	std::ifstream file(path, std::ios::binary);
+	file.seekg(mapped.header_bytes);
+	file.read(reinterpret_cast<char*>(loaded.data()), static_cast<std::streamsize>(loaded.size() * sizeof(float)));
+	double read_ms = ms_since(start);
+
+	start = clock::now();
+	mapped.advise(cpplab::access_hint::sequential);
+	float norm = cpplab::simd::dot(mapped.data(), mapped.data(), mapped.size());
+	double dot_ms = ms_since(start);
+
+	start = clock::now();
+	cpplab::mapped_vector<float> sorted(path);
+	std::sort(sorted.begin(), sorted.end());
+	double sort_ms = ms_since(start);
+
+	std::cout << mapped.size() << " floats (" << mapped.size() * sizeof(float) / (1 << 20) << " MiB)\n";
+	std::cout << "reopen as mapped_vector " << open_ms << " ms, read into std::vector " << read_ms << " ms\n";
+	std::cout << "dot product over the mapping " << dot_ms << " ms (" << norm << "), sort in the file " << sort_ms << " ms, "
+		<< (std::is_sorted(sorted.begin(), sorted.end()) ? "sorted" : "NOT SORTED") << "\n";
+
+	mapped.close();
+	sorted.close();
+	std::filesystem::remove(path);
+#else
+	std::cout << "mapped_vector needs mmap (POSIX)\n";
+#endif
+
+
+	return 0;
+}
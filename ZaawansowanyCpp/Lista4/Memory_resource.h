@@ -0,0 +1,237 @@
+// Memory resources for allocator-aware cpplab containers (usable through std::pmr::polymorphic_allocator)
+
+#pragma once
+
+#include <iostream>
+#include <memory_resource>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+
+#include "Zadanie4_2.h"
+
+
+namespace cpplab
+{
+	/// <summary>
+	/// Monotonic arena: allocations bump a pointer inside large blocks obtained from the upstream resource,
+	/// deallocation is a no-op and release() frees every block at once.
+	/// </summary>
+	class arena_resource : public std::pmr::memory_resource
+	{
+	  private:
+		// Header placed at the beginning of every block, blocks form a singly linked list
+		struct Block
+		{
+			Block* next;
+			size_t size;  // Size of the whole block (including the header)
+		};
+
+		std::pmr::memory_resource* upstream;
+		size_t next_block_size;
+		Block* blocks = nullptr;
+		std::byte* current = nullptr;  // First free byte of the newest block
+		std::byte* end = nullptr;      // One past the last byte of the newest block
+
+	  public:
+		explicit arena_resource(size_t initial_block_size = 64 * 1024, std::pmr::memory_resource* upstream = std::pmr::new_delete_resource())
+			: upstream(upstream), next_block_size(std::max(initial_block_size, sizeof(Block))) {}
+
+		arena_resource(const arena_resource&) = delete;
+		arena_resource& operator=(const arena_resource&) = delete;
+
+		~arena_resource() { release(); }
+
+		/* Returns all blocks to the upstream resource. Every pointer handed out so far becomes dangling. */
+		void release()
+		{
+			while (blocks)
+			{
+				Block* next = blocks->next;
+				upstream->deallocate(blocks, blocks->size, alignof(std::max_align_t));
+				blocks = next;
+			}
+
+			current = end = nullptr;
+		}
+
+		std::pmr::memory_resource* upstream_resource() const { return upstream; }
+
+	  protected:
+		void* do_allocate(size_t bytes, size_t alignment) override
+		{
+			std::byte* aligned = align_up(current, alignment);
+
+			if (current == nullptr || aligned + bytes > end)
+			{
+				add_block(bytes + alignment);
+				aligned = align_up(current, alignment);
+			}
+
+			current = aligned + bytes;
+			return aligned;
+		}
+
+		void do_deallocate(void*, size_t, size_t) override {}  // Memory is only given back by release()
+
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+	  private:
+		static std::byte* align_up(std::byte* ptr, size_t alignment)
+		{
+			auto address = reinterpret_cast<std::uintptr_t>(ptr);
+			return ptr + ((alignment - address % alignment) % alignment);
+		}
+
+		/* Allocates a block big enough for at least min_bytes, block sizes grow geometrically. */
+		void add_block(size_t min_bytes)
+		{
+			size_t size = std::max(next_block_size, min_bytes + sizeof(Block));
+			Block* block = static_cast<Block*>(upstream->allocate(size, alignof(std::max_align_t)));
+			block->next = blocks;
+			block->size = size;
+			blocks = block;
+
+			current = reinterpret_cast<std::byte*>(block) + sizeof(Block);
+			end = reinterpret_cast<std::byte*>(block) + size;
+			next_block_size = size * 2;
+		}
+	};
+
+	/// <summary>
+	/// Pool of power-of-two size classes (from 8 bytes up to max_pooled_size). Freed chunks go onto a per-class free list
+	/// and are reused by the next allocation of the same class. Bigger requests go straight to the upstream resource.
+	/// </summary>
+	class pool_resource : public std::pmr::memory_resource
+	{
+	  public:
+		static constexpr size_t min_class_size = 8;
+		static constexpr size_t max_pooled_size = 4096;
+
+	  private:
+		static constexpr size_t class_count = 10;  // 8, 16, ..., 4096
+		static constexpr size_t slab_size = 64 * 1024;
+
+		struct FreeChunk { FreeChunk* next; };
+		struct Slab { Slab* next; };
+
+		std::pmr::memory_resource* upstream;
+		FreeChunk* free_lists[class_count] = {};
+		Slab* slabs = nullptr;
+
+	  public:
+		explicit pool_resource(std::pmr::memory_resource* upstream = std::pmr::new_delete_resource()) : upstream(upstream) {}
+
+		pool_resource(const pool_resource&) = delete;
+		pool_resource& operator=(const pool_resource&) = delete;
+
+		~pool_resource() { release(); }
+
+		/* Returns all slabs to the upstream resource. Every pooled pointer handed out so far becomes dangling. */
+		void release()
+		{
+			while (slabs)
+			{
+				Slab* next = slabs->next;
+				upstream->deallocate(slabs, slab_size, alignof(std::max_align_t));
+				slabs = next;
+			}
+
+			std::fill(std::begin(free_lists), std::end(free_lists), nullptr);
+		}
+
+		std::pmr::memory_resource* upstream_resource() const { return upstream; }
+
+	  protected:
+		void* do_allocate(size_t bytes, size_t alignment) override
+		{
+			if (!is_pooled(bytes, alignment))
+				return upstream->allocate(bytes, alignment);
+
+			size_t idx = class_index(bytes, alignment);
+			if (free_lists[idx] == nullptr)
+				refill(idx);
+
+			FreeChunk* chunk = free_lists[idx];
+			free_lists[idx] = chunk->next;
+			return chunk;
+		}
+
+		void do_deallocate(void* ptr, size_t bytes, size_t alignment) override
+		{
+			if (!is_pooled(bytes, alignment))
+			{
+				upstream->deallocate(ptr, bytes, alignment);
+				return;
+			}
+
+			size_t idx = class_index(bytes, alignment);
+			free_lists[idx] = new (ptr) FreeChunk{ free_lists[idx] };
+		}
+
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+	  private:
+		static bool is_pooled(size_t bytes, size_t alignment)
+		{
+			return bytes <= max_pooled_size && alignment <= alignof(std::max_align_t);
+		}
+
+		/* Index of the smallest power-of-two class that fits both the size and the alignment. */
+		static size_t class_index(size_t bytes, size_t alignment)
+		{
+			size_t needed = std::max({ bytes, alignment, min_class_size });
+			size_t idx = 0;
+			for (size_t size = min_class_size; size < needed; size *= 2)
+				idx++;
+			return idx;
+		}
+
+		/* Carves a new slab into chunks of the given class and puts them on its free list. */
+		void refill(size_t idx)
+		{
+			size_t chunk_size = min_class_size << idx;
+			std::byte* memory = static_cast<std::byte*>(upstream->allocate(slab_size, alignof(std::max_align_t)));
+			slabs = new (memory) Slab{ slabs };
+
+			// The first chunk (or its part) is taken by the slab header
+			size_t first = std::max(chunk_size, sizeof(Slab));
+			for (size_t offset = first; offset + chunk_size <= slab_size; offset += chunk_size)
+				free_lists[idx] = new (memory + offset) FreeChunk{ free_lists[idx] };
+		}
+	};
+}
+
+
+int memory_resource_demo()
+{
+	namespace cpp = cpplab;
+
+	std::cout << "--- Vectors living in a monotonic arena\n";
+	cpp::arena_resource arena;
+	{
+		cpp::pmr::vector<int> vec0(&arena);
+		cpp::pmr::vector<Pixel> pixels(&arena);
+
+		for (int i = 0; i < 10; i++)
+		{
+			vec0.push_back(i);
+			pixels.emplace_back(i, 2 * i, 3 * i);
+		}
+
+		std::cout << "vec0 = " << vec0 << "\n";
+	}
+	arena.release();  // Frees the memory of every vector built in the arena at once
+
+	std::cout << "\n--- Vectors sharing a size-class pool\n";
+	cpp::pool_resource pool;
+	for (int round = 0; round < 3; round++)
+	{
+		cpp::pmr::vector<double> vec1(4, 0.5 * round, &pool);
+		vec1.push_back(1.5);
+		std::cout << "vec1 = " << vec1 << "\n";  // Chunks freed in the previous round are reused
+	}
+
+
+	return 0;
+}
@@ -0,0 +1,421 @@
+// Binary PPM (P6, RGB) and PGM (P5, gray) files: a reader working on the memory-mapped file and a writer with large buffered writes
+
+#pragma once
+
+#include <iostream>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Zadanie4_2.h"
+#include "Image.h"
+#include "Mapped_file.h"
+#include "../Common/Bench_timer.h"
+
+
+namespace cpplab
+{
+	// Pixel is read and written as three ints in a row, which is how the conversions below see a vector of Pixels
+	static_assert(sizeof(Pixel) == 3 * sizeof(std::int32_t) && std::is_trivially_copyable_v<Pixel>, "Pixel must be three ints");
+
+	namespace detail
+	{
+		constexpr size_t pnm_chunk_pixels = 4096;  // Pixels converted at a time between bytes and ints, the chunks stay in L1
+	}
+
+	/// <summary>
+	/// Reader of binary PPM and PGM files with up to 8 bits per channel. The file is memory-mapped and the header parsed
+	/// once in the constructor. payload() gives the pixel bytes without copying them, to_pixels() and to_image() convert
+	/// them with the SIMD kernels of Simd_image.h. Values are returned as stored, they are not rescaled when maxval is below 255.
+	/// </summary>
+	class pnm_reader
+	{
+	  public:
+		explicit pnm_reader(const std::string& path) : _file(path)
+		{
+			_file.advise_sequential();
+			parse_header();
+		}
+
+		size_t width() const { return _width; }
+		size_t height() const { return _height; }
+		size_t channels() const { return _channels; }
+		unsigned maxval() const { return _maxval; }
+
+		/* The pixels as stored in the file: height rows of width * channels bytes, with no padding. */
+		std::span<const std::uint8_t> payload() const { return { _file.data() + _offset, _width * _height * _channels }; }
+
+		/* The pixels as a row-major vector of Pixels, gray files give the same value in all three channels. */
+		vector<Pixel> to_pixels() const
+		{
+			vector<Pixel> pixels;
+			pixels.resize(_width * _height);
+
+			const std::uint8_t* in = payload().data();
+			std::vector<std::int32_t> ints(3 * std::min(detail::pnm_chunk_pixels, pixels.size()));
+
+			for (size_t first = 0; first < pixels.size(); first += detail::pnm_chunk_pixels)
+			{
+				size_t count = std::min(detail::pnm_chunk_pixels, pixels.size() - first);
+
+				if (_channels == 3)
+				{
+					simd::widen_bytes(in + 3 * first, ints.data(), 3 * count);
+				}
+				else
+				{
+					for (size_t i = 0; i < count; i++)
+						ints[3 * i] = ints[3 * i + 1] = ints[3 * i + 2] = in[first + i];
+				}
+
+				std::memcpy(static_cast<void*>(pixels.data() + first), ints.data(), count * sizeof(Pixel));
+			}
+
+			return pixels;
+		}
+
+		/* The pixels packed into an image, PPM files become rgb8 and PGM files gray8 unless another format is asked for. */
+		image to_image() const { return to_image(_channels == 3 ? pixel_format::rgb8 : pixel_format::gray8); }
+
+		image to_image(pixel_format format) const
+		{
+			image result(_width, _height, format);
+			const size_t row_bytes = _width * _channels;
+
+			for (size_t y = 0; y < _height; y++)
+			{
+				const std::uint8_t* in = payload().data() + y * row_bytes;
+				std::uint8_t* out = result.row(y);
+
+				if (channels_of(format) == _channels)
+				{
+					std::memcpy(out, in, row_bytes);
+				}
+				else if (_channels == 3)
+				{
+					if (format == pixel_format::rgba8)
+						simd::rgb_to_rgba(in, out, _width);
+					else
+						simd::gray_row(in, out, _width, 3);
+				}
+				else
+				{
+					for (size_t x = 0; x < _width; x++)
+					{
+						for (size_t c = 0; c < channels_of(format); c++)
+							out[x * channels_of(format) + c] = c < 3 ? in[x] : 255;
+					}
+				}
+			}
+
+			return result;
+		}
+
+	  private:
+		// Header: magic number, width, height and maxval separated by whitespace (a '#' starts a comment until the end of the line),
+		// then a single whitespace character before the pixels
+		void parse_header()
+		{
+			const std::uint8_t* p = _file.data();
+			const size_t size = _file.size();
+
+			if (size < 2 || p[0] != 'P' || (p[1] != '5' && p[1] != '6')) throw std::runtime_error("Not a binary PPM or PGM file");
+			_channels = p[1] == '6' ? 3 : 1;
+
+			size_t pos = 2;
+			auto is_space = [](std::uint8_t c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f'; };
+
+			auto read_number = [&]()
+				{
+					while (pos < size && (is_space(p[pos]) || p[pos] == '#'))
+					{
+						if (p[pos] == '#')
+						{
+							while (pos < size && p[pos] != '\n')
+								pos++;
+						}
+						else
+						{
+							pos++;
+						}
+					}
+
+					if (pos >= size || p[pos] < '0' || p[pos] > '9') throw std::runtime_error("Malformed PPM/PGM header");
+
+					size_t value = 0;
+					while (pos < size && p[pos] >= '0' && p[pos] <= '9')
+					{
+						value = value * 10 + (p[pos++] - '0');
+						if (value > (1u << 30)) throw std::runtime_error("PPM/PGM dimensions are too large");
+					}
+
+					return value;
+				};
+
+			_width = read_number();
+			_height = read_number();
+			size_t maxval = read_number();
+			if (maxval == 0 || maxval > 255) throw std::runtime_error("Only PPM/PGM files with up to 8 bits per channel are supported");
+			_maxval = static_cast<unsigned>(maxval);
+
+			if (pos >= size || !is_space(p[pos])) throw std::runtime_error("Malformed PPM/PGM header");
+			_offset = pos + 1;
+
+			if (size - _offset < _width * _height * _channels) throw std::runtime_error("PPM/PGM file is truncated");
+		}
+
+		mapped_file _file;
+		size_t _width = 0;
+		size_t _height = 0;
+		size_t _channels = 0;
+		unsigned _maxval = 0;
+		size_t _offset = 0;
+	};
+
+	/// <summary>
+	/// Output file with its own large buffer: small writes are collected and handed to the system in 1 MiB blocks,
+	/// writes larger than the buffer go straight through.
+	/// </summary>
+	class buffered_writer
+	{
+	  public:
+		static constexpr size_t buffer_size = 1 << 20;
+
+		explicit buffered_writer(const std::string& path)
+		{
+			_file = std::fopen(path.c_str(), "wb");
+			if (!_file) throw std::runtime_error("Cannot create " + path);
+
+			std::setvbuf(_file, nullptr, _IONBF, 0);  // The C library buffer would only add a copy
+			_buffer.reserve(buffer_size);
+		}
+
+		buffered_writer(const buffered_writer&) = delete;
+		buffered_writer& operator=(const buffered_writer&) = delete;
+
+		/* Closes the file, errors are ignored here, call close() to see them. */
+		~buffered_writer()
+		{
+			if (_file)
+			{
+				try { flush(); } catch (...) {}
+				std::fclose(_file);
+			}
+		}
+
+		void write(const void* data, size_t bytes)
+		{
+			if (_buffer.size() + bytes > buffer_size)
+				flush();
+
+			if (bytes >= buffer_size)
+			{
+				put(data, bytes);
+				return;
+			}
+
+			const std::uint8_t* p = static_cast<const std::uint8_t*>(data);
+			_buffer.insert(_buffer.end(), p, p + bytes);
+		}
+
+		void write(const std::string& text) { write(text.data(), text.size()); }
+
+		void flush()
+		{
+			if (!_buffer.empty())
+			{
+				put(_buffer.data(), _buffer.size());
+				_buffer.clear();
+			}
+		}
+
+		/* Writes the buffer and closes the file, throws if any of it failed. Closing a closed writer does nothing. */
+		void close()
+		{
+			if (!_file)
+				return;
+
+			flush();
+			int result = std::fclose(_file);
+			_file = nullptr;
+			if (result != 0) throw std::runtime_error("Cannot write the file");
+		}
+
+	  private:
+		void put(const void* data, size_t bytes)
+		{
+			if (std::fwrite(data, 1, bytes, _file) != bytes) throw std::runtime_error("Cannot write the file");
+		}
+
+		std::FILE* _file = nullptr;
+		std::vector<std::uint8_t> _buffer;
+	};
+
+	namespace detail
+	{
+		inline std::string pnm_header(size_t channels, size_t width, size_t height)
+		{
+			return std::string(channels == 3 ? "P6\n" : "P5\n") + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+		}
+	}
+
+	/// <summary>Saves an image as PGM (gray8) or PPM (rgb8 and rgba8, alpha is dropped).</summary>
+	inline void write_pnm(const std::string& path, const image& img)
+	{
+		const size_t channels = img.format() == pixel_format::gray8 ? 1 : 3;
+		buffered_writer out(path);
+		out.write(detail::pnm_header(channels, img.width(), img.height()));
+
+		std::vector<std::uint8_t> rgb(img.format() == pixel_format::rgba8 ? 3 * img.width() : 0);
+		for (size_t y = 0; y < img.height(); y++)
+		{
+			if (img.format() != pixel_format::rgba8)
+			{
+				out.write(img.row(y), img.width() * channels);
+				continue;
+			}
+
+			const std::uint8_t* in = img.row(y);
+			for (size_t x = 0; x < img.width(); x++)
+			{
+				rgb[3 * x] = in[4 * x];
+				rgb[3 * x + 1] = in[4 * x + 1];
+				rgb[3 * x + 2] = in[4 * x + 2];
+			}
+			out.write(rgb.data(), rgb.size());
+		}
+
+		out.close();
+	}
+
+	/// <summary>Saves a row-major vector of Pixels as PPM, channels outside [0, 255] are clamped.</summary>
+	inline void write_pnm(const std::string& path, const vector<Pixel>& pixels, size_t width, size_t height)
+	{
+		if (pixels.size() != width * height) throw std::invalid_argument("Number of pixels does not match the dimensions");
+
+		buffered_writer out(path);
+		out.write(detail::pnm_header(3, width, height));
+
+		// The chunks are 48 KiB of ints, too much for the stack
+		const size_t chunk = std::min(detail::pnm_chunk_pixels, pixels.size());
+		std::vector<std::int32_t> ints(3 * chunk);
+		std::vector<std::uint8_t> bytes(3 * chunk);
+		for (size_t first = 0; first < pixels.size(); first += detail::pnm_chunk_pixels)
+		{
+			size_t count = std::min(detail::pnm_chunk_pixels, pixels.size() - first);
+			std::memcpy(ints.data(), static_cast<const void*>(pixels.data() + first), count * sizeof(Pixel));
+			simd::narrow_to_bytes(ints.data(), bytes.data(), 3 * count);
+			out.write(bytes.data(), 3 * count);
+		}
+
+		out.close();
+	}
+}
+
+
+int pnm_io_demo()
+{
+	const std::string path = (std::filesystem::temp_directory_path() / "cpplab_demo.ppm").string();
+
+	cpplab::image img(3, 2, cpplab::pixel_format::rgb8);
+	Pixel orange;
+	orange.r = 255;
+	orange.g = 128;
+	img.set_pixel(1, 1, orange);
+	cpplab::write_pnm(path, img);
+
+	cpplab::pnm_reader reader(path);
+	std::cout << reader.width() << "x" << reader.height() << ", " << reader.channels() << " channels, "
+		<< reader.payload().size() << " bytes of pixels\n";
+	std::cout << reader.to_pixels() << "\n";
+
+	std::filesystem::remove(path);
+
+
+	return 0;
+}
+
+/// <summary>
+/// Saves and loads a 3840x2160 frame of Pixels as PPM, with iostreams one channel at a time and with buffered_writer / pnm_reader.
+/// The file is hot in the page cache after it is written, so the reading times show the cost of parsing and converting.
+/// </summary>
+int pnm_io_benchmark()
+{
+	using clock = cpplab::bench::clock;
+	using cpplab::bench::ms_since;
+
+	const size_t width = 3840, height = 2160;
+	const std::string path = (std::filesystem::temp_directory_path() / "cpplab_benchmark.ppm").string();
+	const double megabytes = 3.0 * width * height / (1 << 20);
+
+	cpplab::vector<Pixel> pixels;
+	pixels.resize(width * height);
+	for (size_t i = 0; i < pixels.size(); i++)
+	{
+		pixels[i].r = static_cast<int>(i % 256);
+		pixels[i].g = static_cast<int>(i / width % 256);
+		pixels[i].b = static_cast<int>(i * 7 % 256);
+	}
+
+	// iostreams, one character at a time
+	auto start = clock::now();
+	{
+		std::ofstream out(path, std::ios::binary);
+		out << "P6\n" << width << " " << height << "\n255\n";
+		for (size_t i = 0; i < pixels.size(); i++)
+			out.put(static_cast<char>(pixels[i].r)).put(static_cast<char>(pixels[i].g)).put(static_cast<char>(pixels[i].b));
+	}
+	double stream_write = ms_since(start);
+
+	start = clock::now();
+	cpplab::vector<Pixel> stream_pixels;
+	{
+		std::ifstream in(path, std::ios::binary);
+		std::string magic;
+		size_t w, h, maxval;
+		in >> magic >> w >> h >> maxval;
+		in.get();
+
+		stream_pixels.resize(w * h);
+		for (size_t i = 0; i < stream_pixels.size(); i++)
+		{
+			stream_pixels[i].r = in.get();
+			stream_pixels[i].g = in.get();
+			stream_pixels[i].b = in.get();
+		}
+	}
+	double stream_read = ms_since(start);
+
+	start = clock::now();
+	cpplab::write_pnm(path, pixels, width, height);
+	double fast_write = ms_since(start);
+
+	start = clock::now();
+	cpplab::vector<Pixel> fast_pixels = cpplab::pnm_reader(path).to_pixels();
+	double fast_read = ms_since(start);
+
+	start = clock::now();
+	cpplab::image frame = cpplab::pnm_reader(path).to_image();
+	double image_read = ms_since(start);
+
+	bool same = fast_pixels.size() == stream_pixels.size() && fast_pixels[12345].b == stream_pixels[12345].b
+		&& frame.pixel(100, 200).g == pixels[200 * width + 100].g;
+
+	std::cout << "PPM " << width << "x" << height << " (" << megabytes << " MiB of pixels)\n";
+	std::cout << "write: iostream " << stream_write << " ms, buffered_writer " << fast_write << " ms ("
+		<< megabytes / (fast_write / 1000) << " MiB/s)\n";
+	std::cout << "read:  iostream " << stream_read << " ms, pnm_reader to Pixels " << fast_read << " ms, to rgb8 image " << image_read << " ms"
+		<< (same ? "" : " (RESULTS DIFFER)") << "\n";
+
+	std::filesystem::remove(path);
+
+
+	return 0;
+}
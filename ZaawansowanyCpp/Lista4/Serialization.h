@@ -0,0 +1,503 @@
+// Versioned binary format for dumping and loading the elements of cpplab::vector, cpplab::forward_list and cpplab::bst
+
+#pragma once
+
+#include <iostream>
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "Zadanie4_2.h"
+#include "Mapped_file.h"
+#include "Pnm_io.h"
+#include "../Lista3/Simd_dot.h"
+#include "../Lista3/Zadanie3_3.h"
+#include "../Lista5/Zadanie5_1.h"
+#include "../Common/Bench_timer.h"
+
+
+/*
+ * Layout of a file (all numbers in the byte order of the machine that wrote it):
+ *
+ *   offset  0  magic "CPPLABSR"
+ *           8  endianness marker 0x01020304
+ *          12  format version
+ *          14  container kind, element type tag
+ *          16  element size in bytes
+ *          24  element count
+ *          32  payload offset (a multiple of 64)
+ *          40  CRC-32C of the payload
+ *          44  reserved, zero
+ *          64  padding up to the payload offset
+ *   payload    the elements, copied byte for byte
+ *
+ * The payload starts at a multiple of 64 bytes, so in a memory-mapped file it is aligned for any element type and
+ * can be used in place. Only trivially copyable elements are supported: their bytes are the whole value.
+ */
+namespace cpplab
+{
+	enum class container_kind : std::uint8_t { vector = 1, forward_list = 2, bst = 3 };
+
+	// Kind of element, stored next to its size so a file of floats is not loaded as ints
+	enum class type_tag : std::uint8_t
+	{
+		other = 0,  // Any other trivially copyable type, only the size is checked
+		boolean, character,
+		int8, uint8, int16, uint16, int32, uint32, int64, uint64,
+		float32, float64
+	};
+
+	template <typename T>
+	constexpr type_tag type_tag_of()
+	{
+		using U = std::remove_cv_t<T>;
+
+		if constexpr (std::is_same_v<U, bool>)
+			return type_tag::boolean;
+		else if constexpr (std::is_same_v<U, char>)
+			return type_tag::character;
+		else if constexpr (std::is_integral_v<U>)
+		{
+			constexpr bool is_signed = std::is_signed_v<U>;
+			switch (sizeof(U))
+			{
+				case 1: return is_signed ? type_tag::int8 : type_tag::uint8;
+				case 2: return is_signed ? type_tag::int16 : type_tag::uint16;
+				case 4: return is_signed ? type_tag::int32 : type_tag::uint32;
+				case 8: return is_signed ? type_tag::int64 : type_tag::uint64;
+				default: return type_tag::other;
+			}
+		}
+		else if constexpr (std::is_floating_point_v<U> && sizeof(U) == 4)
+			return type_tag::float32;
+		else if constexpr (std::is_floating_point_v<U> && sizeof(U) == 8)
+			return type_tag::float64;
+		else
+			return type_tag::other;
+	}
+
+	struct serial_header
+	{
+		static constexpr char magic_bytes[8] = { 'C', 'P', 'P', 'L', 'A', 'B', 'S', 'R' };
+		static constexpr std::uint32_t endian_marker = 0x01020304;
+		static constexpr std::uint16_t current_version = 1;
+		static constexpr size_t payload_alignment = 64;
+
+		char magic[8];
+		std::uint32_t endian;
+		std::uint16_t version;
+		container_kind container;
+		type_tag type;
+		std::uint64_t element_size;
+		std::uint64_t count;
+		std::uint64_t payload_offset;
+		std::uint32_t checksum;
+		std::uint8_t reserved[20];
+	};
+
+	static_assert(sizeof(serial_header) == 64 && std::is_trivially_copyable_v<serial_header>, "serial_header must be 64 raw bytes");
+
+	template <typename T>
+	concept Serializable = std::is_trivially_copyable_v<T> && !std::is_pointer_v<T>;
+
+	/* Containers that keep their elements in one array: cpplab::vector, mapped_vector, std::vector. */
+	template <typename V>
+	concept SerializableVector = requires (V vec, const V cvec, size_t n)
+	{
+		typename V::value_type;
+		vec.resize(n);
+		{ vec.data() } -> std::same_as<typename V::value_type*>;
+		{ cvec.size() } -> std::convertible_to<size_t>;
+	} && Serializable<typename V::value_type>;
+
+	namespace detail
+	{
+		constexpr std::uint32_t crc32c_polynomial = 0x82F63B78;  // Castagnoli, reflected (the one SSE4.2 computes)
+
+		constexpr std::array<std::uint32_t, 256> make_crc32c_table()
+		{
+			std::array<std::uint32_t, 256> table{};
+			for (std::uint32_t i = 0; i < 256; i++)
+			{
+				std::uint32_t crc = i;
+				for (int bit = 0; bit < 8; bit++)
+					crc = (crc >> 1) ^ (crc & 1 ? crc32c_polynomial : 0);
+				table[i] = crc;
+			}
+			return table;
+		}
+
+		inline constexpr std::array<std::uint32_t, 256> crc32c_table = make_crc32c_table();
+
+		inline std::uint32_t crc32c_scalar(std::uint32_t crc, const std::uint8_t* p, size_t n)
+		{
+			for (size_t i = 0; i < n; i++)
+				crc = (crc >> 8) ^ crc32c_table[(crc ^ p[i]) & 0xFF];
+			return crc;
+		}
+
+#if CPPLAB_SIMD_X86 && (defined(__x86_64__) || defined(_M_X64))
+		/* The crc32 instruction takes 8 bytes per step. */
+		CPPLAB_TARGET_SSE42 inline std::uint32_t crc32c_sse42(std::uint32_t crc, const std::uint8_t* p, size_t n)
+		{
+			std::uint64_t c = crc;
+			size_t i = 0;
+			for (; i + 8 <= n; i += 8)
+			{
+				std::uint64_t word;
+				std::memcpy(&word, p + i, 8);
+				c = _mm_crc32_u64(c, word);
+			}
+			for (; i < n; i++)
+				c = _mm_crc32_u8(static_cast<std::uint32_t>(c), p[i]);
+			return static_cast<std::uint32_t>(c);
+		}
+#endif
+	}
+
+	/* CRC-32C of n bytes, computed with the crc32 instruction when the CPU has SSE4.2. */
+	inline std::uint32_t crc32c(const void* data, size_t n)
+	{
+		const std::uint8_t* p = static_cast<const std::uint8_t*>(data);
+		std::uint32_t crc = 0xFFFFFFFF;
+
+#if CPPLAB_SIMD_X86 && (defined(__x86_64__) || defined(_M_X64))
+		if (simd::active_level() != simd::level::scalar)
+			return ~detail::crc32c_sse42(crc, p, n);
+#endif
+		return ~detail::crc32c_scalar(crc, p, n);
+	}
+
+	namespace detail
+	{
+		template <typename T>
+		serial_header make_header(container_kind container, size_t count, const T* elements)
+		{
+			serial_header header{};
+			std::memcpy(header.magic, serial_header::magic_bytes, sizeof(header.magic));
+			header.endian = serial_header::endian_marker;
+			header.version = serial_header::current_version;
+			header.container = container;
+			header.type = type_tag_of<T>();
+			header.element_size = sizeof(T);
+			header.count = count;
+			header.payload_offset = std::max(serial_header::payload_alignment, alignof(T));
+			header.checksum = crc32c(elements, count * sizeof(T));
+			return header;
+		}
+
+		template <typename T>
+		void write_serialized(const std::string& path, container_kind container, const T* elements, size_t count)
+		{
+			serial_header header = make_header(container, count, elements);
+
+			buffered_writer out(path);
+			out.write(&header, sizeof(header));
+
+			const std::uint8_t zeros[serial_header::payload_alignment] = {};
+			for (size_t at = sizeof(header); at < header.payload_offset; at += sizeof(zeros))
+				out.write(zeros, std::min(sizeof(zeros), static_cast<size_t>(header.payload_offset) - at));
+
+			// Larger than the writer's buffer, so the payload goes to the system in one call
+			out.write(elements, count * sizeof(T));
+			out.close();
+		}
+
+		/* Checks everything in the header except the checksum. file_size is the size of the whole file. */
+		template <typename T>
+		void check_header(const serial_header& header, size_t file_size, const std::string& path)
+		{
+			if (std::memcmp(header.magic, serial_header::magic_bytes, sizeof(header.magic)) != 0)
+				throw std::runtime_error(path + " is not a cpplab serialized file");
+			if (header.endian != serial_header::endian_marker)
+				throw std::runtime_error(path + " was written on a machine with a different byte order");
+			if (header.version > serial_header::current_version)
+				throw std::runtime_error(path + " has an unsupported format version " + std::to_string(header.version));
+			if (header.type != type_tag_of<T>() || header.element_size != sizeof(T))
+				throw std::runtime_error(path + " holds elements of a different type");
+			if (header.payload_offset < sizeof(serial_header) || header.payload_offset % alignof(T) != 0)
+				throw std::runtime_error(path + " has a misplaced payload");
+			if (header.count > (file_size - std::min<size_t>(file_size, header.payload_offset)) / sizeof(T))
+				throw std::runtime_error(path + " is truncated");
+		}
+
+		inline void check_checksum(const serial_header& header, const void* payload, const std::string& path)
+		{
+			if (crc32c(payload, header.count * header.element_size) != header.checksum)
+				throw std::runtime_error(path + " is corrupted (checksum mismatch)");
+		}
+
+		/// <summary>
+		/// Reads the header and then the whole payload with a single read into the memory returned by
+		/// allocate(count), which must have room for count elements.
+		/// </summary>
+		template <typename T, typename Allocate>
+		void read_serialized(const std::string& path, Allocate allocate)
+		{
+			std::FILE* file = std::fopen(path.c_str(), "rb");
+			if (!file) throw std::runtime_error("Cannot open " + path);
+			std::setvbuf(file, nullptr, _IONBF, 0);  // Reads go straight into the destination
+
+			auto fail = [&](const std::string& message)
+			{
+				std::fclose(file);
+				throw std::runtime_error(message);
+			};
+
+			serial_header header;
+			if (std::fread(&header, sizeof(header), 1, file) != 1) fail(path + " is not a cpplab serialized file");
+
+			std::error_code error;
+			size_t file_size = static_cast<size_t>(std::filesystem::file_size(path, error));
+			if (error) fail("Cannot read the size of " + path);
+
+			try
+			{
+				check_header<T>(header, file_size, path);
+			}
+			catch (const std::runtime_error& e)
+			{
+				fail(e.what());
+			}
+
+			T* elements = nullptr;
+			try
+			{
+				elements = allocate(static_cast<size_t>(header.count));
+			}
+			catch (...)
+			{
+				std::fclose(file);
+				throw;
+			}
+
+			const size_t bytes = static_cast<size_t>(header.count) * sizeof(T);
+			if (std::fseek(file, static_cast<long>(header.payload_offset), SEEK_SET) != 0 ||
+				(bytes > 0 && std::fread(elements, 1, bytes, file) != bytes))
+				fail("Cannot read " + path);
+			std::fclose(file);
+
+			check_checksum(header, elements, path);
+		}
+
+		/* Elements of a forward list or a tree gathered into one array, in the order they are stored. */
+		template <typename T>
+		std::vector<T> read_elements(const std::string& path)
+		{
+			std::vector<T> elements;
+			read_serialized<T>(path, [&](size_t count) { elements.resize(count); return elements.data(); });
+			return elements;
+		}
+	}
+
+	/* Writes the elements of a contiguous vector: the payload is a single write straight from data(). */
+	template <SerializableVector V>
+	void save(const std::string& path, const V& vec)
+	{
+		detail::write_serialized(path, container_kind::vector, vec.data(), static_cast<size_t>(vec.size()));
+	}
+
+	/* Writes the elements of a forward list from the front to the back. */
+	template <Serializable T>
+	void save(const std::string& path, const forward_list<T>& flist)
+	{
+		std::vector<T> elements;
+		flist.for_each([&](const T& value) { elements.push_back(value); });
+		detail::write_serialized(path, container_kind::forward_list, elements.data(), elements.size());
+	}
+
+	/* Writes the values of a tree in pre-order, so loading rebuilds a tree of the same shape. */
+	template <Serializable T>
+	void save(const std::string& path, const bst<T>& tree)
+	{
+		std::vector<T> elements;
+		tree.for_each_pre_order([&](const T& value) { elements.push_back(value); });
+		detail::write_serialized(path, container_kind::bst, elements.data(), elements.size());
+	}
+
+	/// <summary>
+	/// Loads a file written by save(). A vector is resized once and the payload is read into data() with a single read,
+	/// without looking at the elements one by one. A forward list or a tree is rebuilt from the stored order. Any of the
+	/// three containers can be loaded from a file of any other, the element type must match.
+	/// </summary>
+	template <SerializableVector V>
+	V load(const std::string& path)
+	{
+		V vec;
+		detail::read_serialized<typename V::value_type>(path, [&](size_t count) { vec.resize(count); return vec.data(); });
+		return vec;
+	}
+
+	template <typename L>
+		requires std::same_as<L, forward_list<typename L::value_type>> && Serializable<typename L::value_type>
+	L load(const std::string& path)
+	{
+		using T = typename L::value_type;
+		std::vector<T> elements = detail::read_elements<T>(path);
+
+		L flist;
+		for (size_t i = elements.size(); i > 0; i--)
+			flist.push_front(elements[i - 1]);
+		return flist;
+	}
+
+	template <typename B, typename T = typename B::value_type>
+		requires std::same_as<B, bst<T>> && Serializable<T>
+	B load(const std::string& path)
+	{
+		B tree;
+		for (const T& value : detail::read_elements<T>(path))
+			tree.add_node(value);
+		return tree;
+	}
+
+	/// <summary>
+	/// Elements of a serialized file used in place, through a memory mapping: opening reads only the header and
+	/// every element is read by the kernel when it is first touched. The checksum is checked by verify() only,
+	/// because it has to read the whole payload.
+	/// </summary>
+	template <Serializable T>
+	class serialized_view
+	{
+	  public:
+		explicit serialized_view(const std::string& path) : _file(path), _path(path)
+		{
+			if (_file.size() < sizeof(serial_header)) throw std::runtime_error(path + " is not a cpplab serialized file");
+
+			std::memcpy(&_header, _file.data(), sizeof(_header));
+			detail::check_header<T>(_header, _file.size(), path);
+		}
+
+		const serial_header& header() const { return _header; }
+		size_t size() const { return static_cast<size_t>(_header.count); }
+
+		std::span<const T> elements() const
+		{
+			return { reinterpret_cast<const T*>(_file.data() + _header.payload_offset), size() };
+		}
+
+		const T& operator[](size_t idx) const { return elements()[idx]; }
+		const T* begin() const { return elements().data(); }
+		const T* end() const { return elements().data() + size(); }
+
+		void verify() const { detail::check_checksum(_header, begin(), _path); }
+
+	  private:
+		mapped_file _file;
+		std::string _path;
+		serial_header _header{};
+	};
+}
+
+
+/// <summary>
+/// Saves and loads a vector, a forward list and a tree, shows the checks catching a corrupted file and a wrong element
+/// type, and compares writing a large vector as text (which has no reader at all) with the binary format.
+/// </summary>
+int serialization_demo()
+{
+	namespace fs = std::filesystem;
+	using clock = cpplab::bench::clock;
+	using cpplab::bench::ms_since;
+
+	const std::string path = (fs::temp_directory_path() / "cpplab_serialized.bin").string();
+
+	cpplab::vector<double> values;
+	for (int i = 1; i <= 5; i++)
+		values.emplace_back(i * 1.5);
+	cpplab::save(path, values);
+	std::cout << "vector " << values << " -> " << fs::file_size(path) << " bytes -> " << cpplab::load<cpplab::vector<double>>(path) << "\n";
+
+	cpplab::forward_list<int> flist = { 4, 8, 15, 16, 23, 42 };
+	cpplab::save(path, flist);
+	std::cout << "forward_list " << flist << " -> " << cpplab::load<cpplab::forward_list<int>>(path) << "\n";
+	std::cout << "the same file as a vector: " << cpplab::load<cpplab::vector<int>>(path) << "\n";
+
+	cpplab::bst<int> tree = { 6, 8, 4, 7, 5, 3, 9 };
+	cpplab::save(path, tree);
+	std::cout << "bst ";
+	tree.print_in_order();
+	std::cout << " -> ";
+	cpplab::load<cpplab::bst<int>>(path).print_in_order();
+	std::cout << "\n";
+
+	try
+	{
+		cpplab::load<cpplab::vector<float>>(path);
+	}
+	catch (const std::runtime_error& e)
+	{
+		std::cout << "load as floats: " << e.what() << "\n";
+	}
+
+	{
+		std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+		file.seekp(64);
+		file.put(99);
+	}
+	try
+	{
+		cpplab::load<cpplab::bst<int>>(path);
+	}
+	catch (const std::runtime_error& e)
+	{
+		std::cout << "flipped payload byte: " << e.what() << "\n";
+	}
+
+	// Large vector: text dump vs binary save, single-read load and mapped view
+	const size_t count = 1 << 22;
+	std::mt19937 generator(5);
+	std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+	cpplab::vector<double> big;
+	big.reserve(count);
+	for (size_t i = 0; i < count; i++)
+		big.emplace_back(uniform(generator));
+
+	const std::string text_path = (fs::temp_directory_path() / "cpplab_serialized.txt").string();
+	auto start = clock::now();
+	{
+		std::ofstream text(text_path);
+		text << big;
+	}
+	double text_ms = ms_since(start);
+
+	start = clock::now();
+	cpplab::save(path, big);
+	double save_ms = ms_since(start);
+
+	start = clock::now();
+	cpplab::vector<double> loaded = cpplab::load<cpplab::vector<double>>(path);
+	double load_ms = ms_since(start);
+
+	start = clock::now();
+	cpplab::serialized_view<double> view(path);
+	double open_ms = ms_since(start);
+
+	start = clock::now();
+	view.verify();
+	double dot = cpplab::simd::dot(view.begin(), loaded.data(), view.size());
+	double use_ms = ms_since(start);
+
+	std::cout << count << " doubles: text " << text_ms << " ms (" << fs::file_size(text_path) / (1 << 20) << " MiB), binary save "
+		<< save_ms << " ms (" << fs::file_size(path) / (1 << 20) << " MiB)\n";
+	std::cout << "load into a vector " << load_ms << " ms, open as a view " << open_ms << " ms, verify + dot " << use_ms << " ms ("
+		<< dot << ")\n";
+
+	fs::remove(text_path);
+	fs::remove(path);
+
+
+	return 0;
+}
@@ -0,0 +1,305 @@
+// Row kernels for 8-bit images: brightness/contrast, grayscale conversion, the weighted sums of rows that
+// separable filters are built from, and conversions between bytes and ints for file input and output.
+// Every kernel has a plain version and an AVX2 version, which is also used on AVX-512 machines
+// (the kernels are limited by memory, not by the width of the registers).
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "../Lista3/Simd_dot.h"
+
+
+namespace cpplab::simd
+{
+	/* Rounds to the nearest integer (ties to even, like the SIMD conversion) and clamps to a byte. */
+	inline std::uint8_t to_byte(float value)
+	{
+		return static_cast<std::uint8_t>(std::nearbyint(std::clamp(value, 0.0f, 255.0f)));
+	}
+
+	/* Luma in 7-bit fixed point, 38/128, 75/128 and 15/128 are the BT.601 weights 0.299, 0.587 and 0.114 rounded. */
+	inline std::uint8_t gray_value(std::uint8_t r, std::uint8_t g, std::uint8_t b)
+	{
+		return static_cast<std::uint8_t>((38 * r + 75 * g + 15 * b + 64) >> 7);
+	}
+
+	/* out[i] = contrast * in[i] + offset for n bytes, every fourth byte (alpha) is copied unchanged when keep_alpha is set. */
+	inline void adjust_row_scalar(const std::uint8_t* in, std::uint8_t* out, size_t n, float contrast, float offset, bool keep_alpha)
+	{
+		for (size_t i = 0; i < n; i++)
+			out[i] = keep_alpha && i % 4 == 3 ? in[i] : to_byte(std::fma(static_cast<float>(in[i]), contrast, offset));
+	}
+
+	/* Gray values of pixels with the given number of channels (3 or 4, the fourth one is ignored). */
+	inline void gray_row_scalar(const std::uint8_t* in, std::uint8_t* out, size_t pixels, size_t channels)
+	{
+		for (size_t x = 0; x < pixels; x++, in += channels)
+			out[x] = gray_value(in[0], in[1], in[2]);
+	}
+
+	/* out[i] = weights[0] * rows[0][i] + ... + weights[taps - 1] * rows[taps - 1][i] for n bytes. */
+	inline void weighted_sum_scalar(const std::uint8_t* const* rows, const float* weights, size_t taps, std::uint8_t* out, size_t n)
+	{
+		for (size_t i = 0; i < n; i++)
+		{
+			float acc = 0;
+			for (size_t k = 0; k < taps; k++)
+				acc = std::fma(static_cast<float>(rows[k][i]), weights[k], acc);
+
+			out[i] = to_byte(acc);
+		}
+	}
+
+	inline void widen_bytes_scalar(const std::uint8_t* in, std::int32_t* out, size_t n)
+	{
+		for (size_t i = 0; i < n; i++)
+			out[i] = in[i];
+	}
+
+	inline void narrow_to_bytes_scalar(const std::int32_t* in, std::uint8_t* out, size_t n)
+	{
+		for (size_t i = 0; i < n; i++)
+			out[i] = static_cast<std::uint8_t>(std::clamp(in[i], 0, 255));
+	}
+
+	inline void rgb_to_rgba_scalar(const std::uint8_t* in, std::uint8_t* out, size_t pixels)
+	{
+		for (size_t x = 0; x < pixels; x++, in += 3, out += 4)
+		{
+			out[0] = in[0];
+			out[1] = in[1];
+			out[2] = in[2];
+			out[3] = 255;
+		}
+	}
+
+#if CPPLAB_SIMD_X86
+	namespace avx2
+	{
+		/* 16 bytes widened to two registers of 8 floats. */
+		CPPLAB_TARGET_AVX2 inline void load_bytes16(const std::uint8_t* p, __m256& lo, __m256& hi)
+		{
+			__m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+			lo = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(bytes));
+			hi = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(bytes, 8)));
+		}
+
+		/* 16 floats clamped, rounded and narrowed to bytes, the same results as to_byte(). */
+		CPPLAB_TARGET_AVX2 inline __m128i to_bytes16(__m256 lo, __m256 hi)
+		{
+			const __m256 zero = _mm256_setzero_ps(), max = _mm256_set1_ps(255.0f);
+			__m256i a = _mm256_cvtps_epi32(_mm256_min_ps(_mm256_max_ps(lo, zero), max));
+			__m256i b = _mm256_cvtps_epi32(_mm256_min_ps(_mm256_max_ps(hi, zero), max));
+
+			// packs works inside 128-bit lanes, the permute puts the 16-bit values back in order
+			__m256i words = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xD8);
+			return _mm_packus_epi16(_mm256_castsi256_si128(words), _mm256_extracti128_si256(words, 1));
+		}
+
+		CPPLAB_TARGET_AVX2 inline void adjust_row(const std::uint8_t* in, std::uint8_t* out, size_t n, float contrast, float offset, bool keep_alpha)
+		{
+			const __m256 c = _mm256_set1_ps(contrast), o = _mm256_set1_ps(offset);
+			const __m128i alpha = keep_alpha ? _mm_set1_epi32(static_cast<int>(0xFF000000u)) : _mm_setzero_si128();
+			size_t i = 0;
+
+			for (; i + 16 <= n; i += 16)
+			{
+				__m256 lo, hi;
+				load_bytes16(in + i, lo, hi);
+				__m128i result = to_bytes16(_mm256_fmadd_ps(lo, c, o), _mm256_fmadd_ps(hi, c, o));
+
+				// Bytes where the alpha mask is set are taken from the input (i is a multiple of 16, so alpha is every fourth byte)
+				result = _mm_blendv_epi8(result, _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i)), alpha);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), result);
+			}
+
+			adjust_row_scalar(in + i, out + i, n - i, contrast, offset, keep_alpha);
+		}
+
+		/* Eight 3-byte pixels spread to 4 bytes each (the fourth byte is zero). Reads 28 bytes. */
+		CPPLAB_TARGET_AVX2 inline __m256i load_rgb8(const std::uint8_t* p)
+		{
+			__m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))),
+				_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 12)), 1);
+			const __m256i spread = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+				0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+
+			return _mm256_shuffle_epi8(v, spread);
+		}
+
+		/* maddubs multiplies the bytes by the weights and adds pairs (r, g) and (b, a), madd adds the pairs. */
+		CPPLAB_TARGET_AVX2 inline void gray8(__m256i pixels, std::uint8_t* out)
+		{
+			const __m256i weights = _mm256_set1_epi32(0x000F4B26);  // 38, 75, 15, 0
+			__m256i sums = _mm256_madd_epi16(_mm256_maddubs_epi16(pixels, weights), _mm256_set1_epi16(1));
+			sums = _mm256_srli_epi32(_mm256_add_epi32(sums, _mm256_set1_epi32(64)), 7);
+
+			__m256i bytes = _mm256_packus_epi16(_mm256_packus_epi32(sums, sums), _mm256_setzero_si256());
+			std::uint32_t lo = static_cast<std::uint32_t>(_mm_cvtsi128_si32(_mm256_castsi256_si128(bytes)));
+			std::uint32_t hi = static_cast<std::uint32_t>(_mm_cvtsi128_si32(_mm256_extracti128_si256(bytes, 1)));
+			std::memcpy(out, &lo, 4);
+			std::memcpy(out + 4, &hi, 4);
+		}
+
+		CPPLAB_TARGET_AVX2 inline void gray_row(const std::uint8_t* in, std::uint8_t* out, size_t pixels, size_t channels)
+		{
+			size_t x = 0;
+
+			if (channels == 4)
+			{
+				for (; x + 8 <= pixels; x += 8)
+					gray8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + 4 * x)), out + x);
+			}
+			else
+			{
+				// load_rgb8 reads 4 bytes past the 8 pixels, which must still belong to the row
+				for (; x + 10 <= pixels; x += 8)
+					gray8(load_rgb8(in + 3 * x), out + x);
+			}
+
+			gray_row_scalar(in + channels * x, out + x, pixels - x, channels);
+		}
+
+		CPPLAB_TARGET_AVX2 inline void weighted_sum(const std::uint8_t* const* rows, const float* weights, size_t taps, std::uint8_t* out, size_t n)
+		{
+			size_t i = 0;
+
+			for (; i + 16 <= n; i += 16)
+			{
+				__m256 acc_lo = _mm256_setzero_ps(), acc_hi = _mm256_setzero_ps();
+				for (size_t k = 0; k < taps; k++)
+				{
+					__m256 lo, hi, w = _mm256_set1_ps(weights[k]);
+					load_bytes16(rows[k] + i, lo, hi);
+					acc_lo = _mm256_fmadd_ps(lo, w, acc_lo);
+					acc_hi = _mm256_fmadd_ps(hi, w, acc_hi);
+				}
+
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), to_bytes16(acc_lo, acc_hi));
+			}
+
+			if (i < n)
+			{
+				const std::uint8_t* rest[64];
+				for (size_t k = 0; k < taps; k++)
+					rest[k] = rows[k] + i;
+				weighted_sum_scalar(rest, weights, taps, out + i, n - i);
+			}
+		}
+
+		CPPLAB_TARGET_AVX2 inline void widen_bytes(const std::uint8_t* in, std::int32_t* out, size_t n)
+		{
+			size_t i = 0;
+
+			for (; i + 16 <= n; i += 16)
+			{
+				__m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_cvtepu8_epi32(bytes));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i + 8), _mm256_cvtepu8_epi32(_mm_srli_si128(bytes, 8)));
+			}
+
+			widen_bytes_scalar(in + i, out + i, n - i);
+		}
+
+		/* Saturating packs clamp to [0, 255] on the way: int32 to int16 (signed, so large values stay large), then int16 to uint8. */
+		CPPLAB_TARGET_AVX2 inline void narrow_to_bytes(const std::int32_t* in, std::uint8_t* out, size_t n)
+		{
+			size_t i = 0;
+
+			for (; i + 16 <= n; i += 16)
+			{
+				__m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+				__m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i + 8));
+				__m256i words = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xD8);
+				__m128i bytes = _mm_packus_epi16(_mm256_castsi256_si128(words), _mm256_extracti128_si256(words, 1));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), bytes);
+			}
+
+			narrow_to_bytes_scalar(in + i, out + i, n - i);
+		}
+
+		CPPLAB_TARGET_AVX2 inline void rgb_to_rgba(const std::uint8_t* in, std::uint8_t* out, size_t pixels)
+		{
+			const __m256i alpha = _mm256_set1_epi32(static_cast<int>(0xFF000000u));
+			size_t x = 0;
+
+			// load_rgb8 reads 4 bytes past the 8 pixels
+			for (; x + 10 <= pixels; x += 8)
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 4 * x), _mm256_or_si256(load_rgb8(in + 3 * x), alpha));
+
+			rgb_to_rgba_scalar(in + 3 * x, out + 4 * x, pixels - x);
+		}
+	}
+#endif
+
+	/// <summary>
+	/// Brightness and contrast of n bytes: out = contrast * in + offset, rounded and clamped to [0, 255].
+	/// With keep_alpha every fourth byte is copied unchanged (the rows of an RGBA image).
+	/// </summary>
+	inline void adjust_row(const std::uint8_t* in, std::uint8_t* out, size_t n, float contrast, float offset, bool keep_alpha)
+	{
+#if CPPLAB_SIMD_X86
+		if (active_level() >= level::avx2)
+			return avx2::adjust_row(in, out, n, contrast, offset, keep_alpha);
+#endif
+		adjust_row_scalar(in, out, n, contrast, offset, keep_alpha);
+	}
+
+	/// <summary>Gray values of a row of RGB (channels = 3) or RGBA (channels = 4) pixels.</summary>
+	inline void gray_row(const std::uint8_t* in, std::uint8_t* out, size_t pixels, size_t channels)
+	{
+#if CPPLAB_SIMD_X86
+		if (active_level() >= level::avx2)
+			return avx2::gray_row(in, out, pixels, channels);
+#endif
+		gray_row_scalar(in, out, pixels, channels);
+	}
+
+	/// <summary>
+	/// Weighted sum of taps byte arrays (at most 64), rounded and clamped to bytes. One pass of a separable filter:
+	/// the rows above and below for the vertical pass, the same row shifted by whole pixels for the horizontal one.
+	/// </summary>
+	inline void weighted_sum(const std::uint8_t* const* rows, const float* weights, size_t taps, std::uint8_t* out, size_t n)
+	{
+#if CPPLAB_SIMD_X86
+		if (active_level() >= level::avx2)
+			return avx2::weighted_sum(rows, weights, taps, out, n);
+#endif
+		weighted_sum_scalar(rows, weights, taps, out, n);
+	}
+
+	/// <summary>Bytes widened to ints (e.g. the channels of a file into Pixels, which are three ints).</summary>
+	inline void widen_bytes(const std::uint8_t* in, std::int32_t* out, size_t n)
+	{
+#if CPPLAB_SIMD_X86
+		if (active_level() >= level::avx2)
+			return avx2::widen_bytes(in, out, n);
+#endif
+		widen_bytes_scalar(in, out, n);
+	}
+
+	/// <summary>Ints clamped to [0, 255] and narrowed to bytes.</summary>
+	inline void narrow_to_bytes(const std::int32_t* in, std::uint8_t* out, size_t n)
+	{
+#if CPPLAB_SIMD_X86
+		if (active_level() >= level::avx2)
+			return avx2::narrow_to_bytes(in, out, n);
+#endif
+		narrow_to_bytes_scalar(in, out, n);
+	}
+
+	/// <summary>RGB pixels spread to RGBA with an opaque alpha.</summary>
+	inline void rgb_to_rgba(const std::uint8_t* in, std::uint8_t* out, size_t pixels)
+	{
+#if CPPLAB_SIMD_X86
+		if (active_level() >= level::avx2)
+			return avx2::rgb_to_rgba(in, out, pixels);
+#endif
+		rgb_to_rgba_scalar(in, out, pixels);
+	}
+}
@@ -0,0 +1,384 @@
+// Vector with a small buffer optimization: the first N elements live inside the object itself
+
+#pragma once
+
+#include <iostream>
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <iterator>
+
+#include "Zadanie4_2.h"
+
+
+namespace cpplab
+{
+	template <typename T, size_t N>
+	class small_vector
+	{
+		static_assert(N > 0, "small_vector needs room for at least one inline element");
+
+	  public:
+		using value_type = T;
+		using iterator = T*;
+		using const_iterator = const T*;
+
+		// Default constructor
+		small_vector() {}
+
+		// Initializer list constructor
+		small_vector(std::initializer_list<T> list)
+		{
+			reserve(list.size());
+			copy_construct(list.size(), [&](size_t i) -> const T& { return list.begin()[i]; });
+		}
+
+		small_vector(size_t size, T default_value)
+		{
+			reserve(size);
+			copy_construct(size, [&](size_t) -> const T& { return default_value; });
+		}
+
+		// Copy constructor
+		small_vector(const small_vector& vec)
+		{
+			reserve(vec._size);
+			copy_construct(vec._size, [&](size_t i) -> const T& { return vec._data[i]; });
+		}
+
+		// Move constructor (inline elements are moved one by one, so it can throw when moving a T can)
+		small_vector(small_vector&& vec) noexcept(nothrow_take)
+		{
+			take(std::move(vec));
+		}
+
+		~small_vector()
+		{
+			clear();
+			release_heap();
+		}
+
+
+		size_t size() const { return _size; }
+		size_t capacity() const { return _capacity; }
+		bool empty() const { return _size == 0; }
+
+		/* True while the elements are stored inside the object (no heap memory is owned). */
+		bool is_inline() const { return _data == inline_data(); }
+
+		const T& at(size_t idx) const
+		{
+			if (idx >= _size) throw std::range_error("Provided index is out of bounds");
+			return _data[idx];
+		}
+
+		T& at(size_t idx)
+		{
+			if (idx >= _size) throw std::range_error("Provided index is out of bounds");
+			return _data[idx];
+		}
+
+		T* data() { return _data; }
+		const T* data() const { return _data; }
+
+		iterator begin() { return _data; }
+		iterator end() { return _data + _size; }
+		const_iterator begin() const { return _data; }
+		const_iterator end() const { return _data + _size; }
+
+		void resize(size_t new_size)
+		{
+			if (new_size < _size)  // Delete excess elements
+			{
+				destroy(new_size, _size);
+				_size = new_size;
+				return;
+			}
+
+			if (new_size > _capacity)
+				reserve(new_size);
+
+			for (; _size < new_size; _size++)
+				new (&_data[_size]) T();
+		}
+
+		void reserve(size_t new_capacity)
+		{
+			if (new_capacity <= _capacity) return;  // The inline buffer already counts as reserved memory
+
+			T* tmp = allocate(new_capacity);
+			relocate(_data, _size, tmp);
+			release_heap();
+
+			_data = tmp;
+			_capacity = new_capacity;
+		}
+
+		void pop_back()
+		{
+			destroy(_size - 1, _size);
+			_size--;
+		}
+
+		void push_back(T value)
+		{
+			emplace_back(std::move(value));
+		}
+
+		template <typename... Args>
+		void emplace_back(Args&&... args)
+		{
+			if (_size == _capacity)
+			{
+				// Spill to the heap, the new element is constructed first in case the arguments refer to this vector
+				size_t new_capacity = 2 * _capacity;
+				T* tmp = allocate(new_capacity);
+
+				try
+				{
+					new (&tmp[_size]) T(std::forward<Args>(args)...);
+				}
+				catch (...)
+				{
+					deallocate(tmp);
+					throw;
+				}
+
+				relocate(_data, _size, tmp);
+				release_heap();
+
+				_data = tmp;
+				_capacity = new_capacity;
+			}
+			else
+			{
+				new (&_data[_size]) T(std::forward<Args>(args)...);
+			}
+
+			_size++;
+		}
+
+		/* Inserts the value before the element with the given index (idx == size() appends). */
+		void insert(size_t idx, T value)
+		{
+			if (idx > _size) throw std::range_error("Provided index is out of bounds");
+
+			emplace_back(std::move(value));
+			for (size_t i = _size - 1; i > idx; i--)
+				std::swap(_data[i], _data[i - 1]);
+		}
+
+		/* Removes the element with the given index, the elements after it are shifted to the left. */
+		void erase(size_t idx)
+		{
+			if (idx >= _size) throw std::range_error("Provided index is out of bounds");
+
+			for (size_t i = idx; i + 1 < _size; i++)
+				_data[i] = std::move(_data[i + 1]);
+			pop_back();
+		}
+
+		void clear()
+		{
+			destroy(0, _size);
+			_size = 0;
+		}
+
+		// Unchecked access (use at() for bounds checking)
+		const T& operator[](size_t idx) const { return _data[idx]; }
+		T& operator[](size_t idx) { return _data[idx]; }
+
+		// Copy assignment operator
+		small_vector& operator=(const small_vector& vec)
+		{
+			if (this == &vec)
+			{
+				return *this;
+			}
+
+			clear();
+			reserve(vec._size);
+			copy_construct(vec._size, [&](size_t i) -> const T& { return vec._data[i]; });
+
+			return *this;
+		}
+
+		// Move assignment operator
+		small_vector& operator=(small_vector&& vec) noexcept(nothrow_take)
+		{
+			if (this == &vec)
+			{
+				return *this;
+			}
+
+			clear();
+			release_heap();
+			take(std::move(vec));
+
+			return *this;
+		}
+
+		friend std::ostream& operator<<(std::ostream& out, const small_vector& vec)
+		{
+			if (vec._size > 0)
+			{
+				out << "[" << vec[0];
+				for (size_t i = 1; i < vec._size; i++)
+				{
+					out << ", " << vec[i];
+				}
+				out << "]";
+			}
+			else
+			{
+				out << "[]";
+			}
+
+			return out;
+		}
+
+		void print_info() const
+		{
+			std::cout << "size=" << _size << "; capacity=" << _capacity << "; inline=" << is_inline() << "; data=" << *this;
+		}
+
+	  private:
+		T* inline_data() { return reinterpret_cast<T*>(_buffer); }
+		const T* inline_data() const { return reinterpret_cast<const T*>(_buffer); }
+
+		static T* allocate(size_t n)
+		{
+			return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(alignof(T))));
+		}
+
+		static void deallocate(T* ptr)
+		{
+			::operator delete(ptr, std::align_val_t(alignof(T)));
+		}
+
+		/* Frees the heap memory (if any) and points the vector back at its inline buffer. Elements must be destroyed already. */
+		void release_heap()
+		{
+			if (!is_inline())
+				deallocate(_data);
+
+			_data = inline_data();
+			_capacity = N;
+		}
+
+		/* Calls destructors of elements in the range [from, to). */
+		void destroy(size_t from, size_t to)
+		{
+			for (size_t i = from; i < to; i++)
+				_data[i].~T();
+		}
+
+		/* Copy-constructs the elements [_size, count) from source(i) into reserved memory. If a copy throws, the vector is left empty and inline. */
+		template <typename Source>
+		void copy_construct(size_t count, Source source)
+		{
+			try
+			{
+				for (; _size < count; _size++)
+					new (&_data[_size]) T(source(_size));
+			}
+			catch (...)
+			{
+				clear();
+				release_heap();
+				throw;
+			}
+		}
+
+		/* Moves count elements from src to the raw memory at dst and destroys the originals. */
+		static void relocate(T* src, size_t count, T* dst)
+		{
+			if constexpr (is_trivially_relocatable_v<T>)
+			{
+				if (count > 0)
+					std::memcpy(static_cast<void*>(dst), static_cast<const void*>(src), count * sizeof(T));
+				return;
+			}
+
+			for (size_t i = 0; i < count; i++)
+			{
+				new (&dst[i]) T(std::move(src[i]));
+				src[i].~T();
+			}
+		}
+
+		static constexpr bool nothrow_take = is_trivially_relocatable_v<T> || std::is_nothrow_move_constructible_v<T>;
+
+		/* Takes over the contents of vec, this vector must be empty and inline. If moving an element throws, vec is left whole. */
+		void take(small_vector&& vec) noexcept(nothrow_take)
+		{
+			if (vec.is_inline())
+			{
+				// Inline elements cannot be stolen, they are moved into our own buffer
+				if constexpr (nothrow_take)
+				{
+					relocate(vec._data, vec._size, _data);
+					_size = vec._size;
+				}
+				else
+				{
+					// The originals are destroyed only after every element was moved
+					try
+					{
+						for (; _size < vec._size; _size++)
+							new (&_data[_size]) T(std::move(vec._data[_size]));
+					}
+					catch (...)
+					{
+						clear();
+						throw;
+					}
+					vec.clear();
+				}
+			}
+			else
+			{
+				// Heap memory simply changes its owner
+				_data = vec._data;
+				_size = vec._size;
+				_capacity = vec._capacity;
+
+				vec._data = vec.inline_data();
+				vec._capacity = N;
+			}
+
+			vec._size = 0;
+		}
+
+		alignas(T) std::byte _buffer[N * sizeof(T)];
+		T* _data = inline_data();
+		size_t _size = 0;
+		size_t _capacity = N;
+	};
+}
+
+
+int small_vector_demo()
+{
+	namespace cpp = cpplab;
+
+	cpp::small_vector<int, 4> vec0 = { 1, 2, 3 };
+	std::cout << "vec0: "; vec0.print_info(); std::cout << "\n";
+
+	vec0.push_back(4);
+	std::cout << "vec0: "; vec0.print_info(); std::cout << "\n";
+
+	vec0.push_back(5);  // Exceeds the inline capacity and spills to the heap
+	std::cout << "vec0: "; vec0.print_info(); std::cout << "\n";
+
+	cpp::small_vector<int, 4> vec1 = { 7, 8 };
+	auto vec2 = std::move(vec1);  // Inline elements are moved one by one
+	std::cout << "vec2 = std::move(vec1): "; vec2.print_info(); std::cout << "\n";
+
+	auto vec3 = std::move(vec0);  // Heap memory is stolen
+	std::cout << "vec3 = std::move(vec0): "; vec3.print_info(); std::cout << "\n";
+	std::cout << "vec0: "; vec0.print_info(); std::cout << "\n";
+
+
+	return 0;
+}
@@ -0,0 +1,498 @@
+// Structure-of-arrays vector: every member of the element type is kept in its own contiguous array
+
+#pragma once
+
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <span>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "Zadanie4_2.h"
+#include "../Common/Bench_timer.h"
+
+
+namespace cpplab
+{
+	// Lists the members an element type is split into, specialize it as
+	// template <> struct soa_members<Pixel> { static constexpr auto pointers = std::make_tuple(&Pixel::r, &Pixel::g, &Pixel::b); };
+	// Members that are not listed are not stored (they get their default value when an element is read back).
+	template <typename T>
+	struct soa_members;
+
+	namespace detail
+	{
+		template <typename M>
+		struct member_pointer_traits;
+
+		template <typename C, typename V>
+		struct member_pointer_traits<V C::*>
+		{
+			using class_type = C;
+			using value_type = V;
+		};
+	}
+
+	template <typename T>
+	concept SoaElement = std::is_default_constructible_v<T> && requires { soa_members<T>::pointers; };
+
+	/// <summary>
+	/// Vector of T stored as one array per member (r r r ... g g g ... b b b ...) instead of one array of structures.
+	/// A loop over one member reads only that member's memory and, through column(), is a plain loop over a span
+	/// that the compiler vectorizes. Elements are reached through proxies that read or write all the members.
+	/// Members must be trivially copyable (numbers, enums, small PODs), so growing the vector is one memcpy per array.
+	/// </summary>
+	template <SoaElement T>
+	class soa_vector
+	{
+		static constexpr auto pointers = soa_members<T>::pointers;
+		static constexpr size_t member_count = std::tuple_size_v<std::remove_const_t<decltype(pointers)>>;
+
+		template <size_t I>
+		using member_t = typename detail::member_pointer_traits<std::tuple_element_t<I, std::remove_const_t<decltype(pointers)>>>::value_type;
+
+		static constexpr size_t alignment = 64;  // Every array starts on a cache line, which also suits the widest SIMD loads
+
+		template <size_t... I>
+		static consteval bool members_are_trivial(std::index_sequence<I...>) { return (std::is_trivially_copyable_v<member_t<I>> && ...); }
+
+		static_assert(member_count > 0, "soa_members must list at least one member");
+		static_assert(members_are_trivial(std::make_index_sequence<member_count>()), "soa_vector members must be trivially copyable");
+
+		// Position of the member pointer Member in soa_members<T>::pointers
+		template <auto Member, size_t... I>
+		static consteval size_t find_member(std::index_sequence<I...>)
+		{
+			size_t result = member_count;
+			((result = (result == member_count && same_member<Member>(std::get<I>(pointers))) ? I : result), ...);
+			return result;
+		}
+
+		template <auto Member, typename P>
+		static consteval bool same_member(P p)
+		{
+			if constexpr (std::is_same_v<P, decltype(Member)>)
+				return p == Member;
+			else
+				return false;
+		}
+
+		template <auto Member>
+		static constexpr size_t member_index = find_member<Member>(std::make_index_sequence<member_count>());
+
+		// Proxy for one element, Const selects read-only access
+		template <bool Const>
+		class basic_reference
+		{
+			using owner = std::conditional_t<Const, const soa_vector, soa_vector>;
+
+		  public:
+			basic_reference(owner& vec, size_t idx) : _vec(&vec), _idx(idx) {}
+
+			/* The member of this element, e.g. pixels[i].template get<&Pixel::r>() = 255. */
+			template <auto Member>
+			decltype(auto) get() const { return _vec->template column<Member>()[_idx]; }
+
+			operator T() const { return _vec->load(_idx); }
+
+			basic_reference& operator=(const T& value) requires (!Const)
+			{
+				_vec->store(_idx, value);
+				return *this;
+			}
+
+			// Assigning one proxy to another copies the element, it does not rebind the proxy
+			basic_reference& operator=(const basic_reference& other) requires (!Const) { return *this = static_cast<T>(other); }
+
+			friend std::ostream& operator<<(std::ostream& out, const basic_reference& ref) { return out << static_cast<T>(ref); }
+
+		  private:
+			owner* _vec;
+			size_t _idx;
+		};
+
+		// Iterator that produces proxies, enough for range-for and the simple algorithms
+		template <bool Const>
+		class basic_iterator
+		{
+			using owner = std::conditional_t<Const, const soa_vector, soa_vector>;
+
+		  public:
+			using value_type = T;
+			using difference_type = std::ptrdiff_t;
+
+			basic_iterator() = default;
+			basic_iterator(owner& vec, size_t idx) : _vec(&vec), _idx(idx) {}
+
+			basic_reference<Const> operator*() const { return basic_reference<Const>(*_vec, _idx); }
+
+			basic_iterator& operator++() { ++_idx; return *this; }
+			basic_iterator operator++(int) { return basic_iterator(*_vec, _idx++); }
+
+			friend bool operator==(const basic_iterator& a, const basic_iterator& b) { return a._idx == b._idx; }
+
+		  private:
+			owner* _vec = nullptr;
+			size_t _idx = 0;
+		};
+
+	  public:
+		using value_type = T;
+		using reference = basic_reference<false>;
+		using const_reference = basic_reference<true>;
+		using iterator = basic_iterator<false>;
+		using const_iterator = basic_iterator<true>;
+
+		// Default constructor
+		soa_vector() {}
+
+		// Initializer list constructor
+		soa_vector(std::initializer_list<T> list)
+		{
+			reserve(list.size());
+			for (const T& elem : list)
+				push_back(elem);
+		}
+
+		soa_vector(size_t size, const T& default_value)
+		{
+			reserve(size);
+			for (size_t i = 0; i < size; i++)
+				push_back(default_value);
+		}
+
+		// Copy constructor
+		soa_vector(const soa_vector& vec)
+		{
+			reserve(vec._size);
+			copy_columns(vec, std::make_index_sequence<member_count>());
+			_size = vec._size;
+		}
+
+		// Move constructor
+		soa_vector(soa_vector&& vec) noexcept
+		{
+			take(std::move(vec));
+		}
+
+		~soa_vector() { release(); }
+
+		// Copy assignment operator
+		soa_vector& operator=(const soa_vector& vec)
+		{
+			if (this == &vec)
+			{
+				return *this;
+			}
+
+			_size = 0;
+			if (vec._size > _capacity)
+				reserve(vec._size);
+			copy_columns(vec, std::make_index_sequence<member_count>());
+			_size = vec._size;
+
+			return *this;
+		}
+
+		// Move assignment operator
+		soa_vector& operator=(soa_vector&& vec) noexcept
+		{
+			if (this == &vec)
+			{
+				return *this;
+			}
+
+			release();
+			take(std::move(vec));
+
+			return *this;
+		}
+
+
+		size_t size() const { return _size; }
+		size_t capacity() const { return _capacity; }
+		bool empty() const { return _size == 0; }
+
+		/* All the values of one member, e.g. pixels.column<&Pixel::r>() is the span of red channels. */
+		template <auto Member>
+		std::span<typename detail::member_pointer_traits<decltype(Member)>::value_type> column()
+		{
+			static_assert(member_index<Member> < member_count, "Member is not listed in soa_members");
+			return { data<member_index<Member>>(), _size };
+		}
+
+		template <auto Member>
+		std::span<const typename detail::member_pointer_traits<decltype(Member)>::value_type> column() const
+		{
+			static_assert(member_index<Member> < member_count, "Member is not listed in soa_members");
+			return { data<member_index<Member>>(), _size };
+		}
+
+		reference operator[](size_t idx) { return reference(*this, idx); }
+		const_reference operator[](size_t idx) const { return const_reference(*this, idx); }
+
+		reference at(size_t idx)
+		{
+			if (idx >= _size) throw std::range_error("Provided index is out of bounds");
+			return (*this)[idx];
+		}
+
+		const_reference at(size_t idx) const
+		{
+			if (idx >= _size) throw std::range_error("Provided index is out of bounds");
+			return (*this)[idx];
+		}
+
+		iterator begin() { return iterator(*this, 0); }
+		iterator end() { return iterator(*this, _size); }
+		const_iterator begin() const { return const_iterator(*this, 0); }
+		const_iterator end() const { return const_iterator(*this, _size); }
+
+		void reserve(size_t new_capacity)
+		{
+			if (new_capacity <= _capacity)
+				return;
+
+			reallocate(new_capacity, std::make_index_sequence<member_count>());
+			_capacity = new_capacity;
+		}
+
+		void resize(size_t new_size)
+		{
+			reserve(new_size);
+			for (; _size < new_size; _size++)
+				store(_size, T());
+
+			_size = new_size;
+		}
+
+		void clear() { _size = 0; }
+
+		void pop_back()
+		{
+			if (_size == 0) throw std::out_of_range("pop_back() called on an empty soa_vector");
+			_size--;
+		}
+
+		void push_back(const T& value)
+		{
+			grow_if_full();
+			store(_size, value);
+			_size++;
+		}
+
+		/// <summary>
+		/// Adds an element. With one argument per listed member (e.g. emplace_back(r, g, b) for a Pixel) the arguments are
+		/// written straight into the arrays, in the order of soa_members, without constructing a T. Any other arguments
+		/// are passed to a constructor of T and the new element is split into its members.
+		/// </summary>
+		template <typename... Args>
+		reference emplace_back(Args&&... args)
+		{
+			// The arguments are converted before growing, which frees the old arrays they may refer to (e.g. emplace_back(r, r, r))
+			if constexpr (sizeof...(Args) == member_count && members_from<Args...>(std::make_index_sequence<member_count>()))
+			{
+				auto values = convert_members(std::make_index_sequence<member_count>(), std::forward<Args>(args)...);
+				grow_if_full();
+				store_members(_size, values, std::make_index_sequence<member_count>());
+			}
+			else
+			{
+				T value(std::forward<Args>(args)...);
+				grow_if_full();
+				store(_size, value);
+			}
+
+			return (*this)[_size++];
+		}
+
+		friend std::ostream& operator<<(std::ostream& out, const soa_vector& vec)
+		{
+			out << "[";
+			for (size_t i = 0; i < vec._size; i++)
+				out << (i > 0 ? ", " : "") << vec[i];
+			out << "]";
+
+			return out;
+		}
+
+	  private:
+		template <size_t I>
+		member_t<I>* data() { return static_cast<member_t<I>*>(_columns[I]); }
+
+		template <size_t I>
+		const member_t<I>* data() const { return static_cast<const member_t<I>*>(_columns[I]); }
+
+		T load(size_t idx) const { return load(idx, std::make_index_sequence<member_count>()); }
+
+		template <size_t... I>
+		T load(size_t idx, std::index_sequence<I...>) const
+		{
+			T value;
+			((value.*std::get<I>(pointers) = data<I>()[idx]), ...);
+			return value;
+		}
+
+		void store(size_t idx, const T& value) { store(idx, value, std::make_index_sequence<member_count>()); }
+
+		template <size_t... I>
+		void store(size_t idx, const T& value, std::index_sequence<I...>)
+		{
+			((data<I>()[idx] = value.*std::get<I>(pointers)), ...);
+		}
+
+		template <typename... Args, size_t... I>
+		static constexpr bool members_from(std::index_sequence<I...>) { return (std::is_constructible_v<member_t<I>, Args> && ...); }
+
+		template <size_t... I, typename... Args>
+		static std::tuple<member_t<I>...> convert_members(std::index_sequence<I...>, Args&&... args)
+		{
+			return std::tuple<member_t<I>...>(member_t<I>(std::forward<Args>(args))...);
+		}
+
+		template <size_t... I>
+		void store_members(size_t idx, const std::tuple<member_t<I>...>& values, std::index_sequence<I...>)
+		{
+			((data<I>()[idx] = std::get<I>(values)), ...);
+		}
+
+		void grow_if_full()
+		{
+			if (_size == _capacity)
+				reserve(_capacity == 0 ? 1 : 2 * _capacity);
+		}
+
+		// Allocates all the new arrays before touching the old ones, so a failed allocation leaves the vector unchanged
+		template <size_t... I>
+		void reallocate(size_t new_capacity, std::index_sequence<I...>)
+		{
+			void* fresh[member_count] = {};
+
+			try
+			{
+				((fresh[I] = ::operator new(new_capacity * sizeof(member_t<I>), std::align_val_t(alignment))), ...);
+			}
+			catch (...)
+			{
+				for (void* column : fresh)
+					::operator delete(column, std::align_val_t(alignment));
+				throw;
+			}
+
+			if (_size > 0)
+				((std::memcpy(fresh[I], _columns[I], _size * sizeof(member_t<I>))), ...);
+
+			release();
+			std::copy(std::begin(fresh), std::end(fresh), std::begin(_columns));
+		}
+
+		template <size_t... I>
+		void copy_columns(const soa_vector& vec, std::index_sequence<I...>)
+		{
+			if (vec._size > 0)
+				((std::memcpy(_columns[I], vec._columns[I], vec._size * sizeof(member_t<I>))), ...);
+		}
+
+		void take(soa_vector&& vec)
+		{
+			std::copy(std::begin(vec._columns), std::end(vec._columns), std::begin(_columns));
+			_size = vec._size;
+			_capacity = vec._capacity;
+
+			std::fill(std::begin(vec._columns), std::end(vec._columns), nullptr);
+			vec._size = 0;
+			vec._capacity = 0;
+		}
+
+		void release()
+		{
+			for (void*& column : _columns)
+			{
+				::operator delete(column, std::align_val_t(alignment));
+				column = nullptr;
+			}
+		}
+
+		void* _columns[member_count] = {};
+		size_t _size = 0;
+		size_t _capacity = 0;
+	};
+
+	template <>
+	struct soa_members<Pixel>
+	{
+		static constexpr auto pointers = std::make_tuple(&Pixel::r, &Pixel::g, &Pixel::b);
+	};
+}
+
+
+int soa_vector_demo()
+{
+	cpplab::soa_vector<Pixel> pixels;
+	pixels.emplace_back(50, 50, 50);
+	pixels.emplace_back(100, 100, 100);
+	pixels.push_back(Pixel());
+	pixels[2].get<&Pixel::g>() = 150;
+
+	// One channel is a plain array
+	for (int& red : pixels.column<&Pixel::r>())
+		red += 10;
+
+	Pixel first = pixels[0];
+	std::cout << pixels << "\n";
+	std::cout << "first = " << first << "\n";
+
+
+	return 0;
+}
+
+/// <summary>
+/// Brightens the red channel of a frame stored as vector&lt;Pixel&gt; and as soa_vector&lt;Pixel&gt;. The array of structures
+/// loop has to step over the green and blue values, the structure of arrays loop reads only the reds.
+/// </summary>
+int soa_vector_benchmark()
+{
+	using clock = cpplab::bench::clock;
+	using cpplab::bench::ms_since;
+
+	const size_t count = 1 << 22;
+	const int repeats = 20;
+
+	cpplab::vector<Pixel> aos;
+	aos.resize(count);
+	cpplab::soa_vector<Pixel> soa;
+	soa.resize(count);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		aos[i].r = aos[i].g = aos[i].b = static_cast<int>(i % 256);
+		soa[i] = aos[i];
+	}
+
+	auto start = clock::now();
+	for (int k = 0; k < repeats; k++)
+	{
+		for (size_t i = 0; i < aos.size(); i++)
+			aos[i].r = std::min(aos[i].r + 1, 255);
+	}
+	double aos_ms = ms_since(start) / repeats;
+
+	start = clock::now();
+	for (int k = 0; k < repeats; k++)
+	{
+		for (int& red : soa.column<&Pixel::r>())
+			red = std::min(red + 1, 255);
+	}
+	double soa_ms = ms_since(start) / repeats;
+
+	bool same = static_cast<Pixel>(soa[count - 1]).r == aos[count - 1].r;
+	std::cout << "Red channel pass over " << count << " pixels: vector<Pixel> " << aos_ms << " ms, soa_vector<Pixel> " << soa_ms << " ms"
+		<< (same ? "" : " (RESULTS DIFFER)") << "\n";
+
+
+	return 0;
+}
@@ -0,0 +1,248 @@
+// Vector with a fixed capacity that keeps all of its elements inside the object and never allocates
+
+#pragma once
+
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+
+
+namespace cpplab
+{
+	template <typename T, size_t N>
+	class static_vector
+	{
+	  public:
+		using value_type = T;
+		using iterator = T*;
+		using const_iterator = const T*;
+
+		// Default constructor (elements are not constructed until they are added)
+		constexpr static_vector() {}
+
+		// Initializer list constructor
+		constexpr static_vector(std::initializer_list<T> list)
+		{
+			if (list.size() > N) throw std::length_error("Initializer list does not fit into static_vector");
+
+			for (const T& elem : list)
+				std::construct_at(&_data[_size++], elem);
+		}
+
+		constexpr static_vector(size_t size, T default_value)
+		{
+			if (size > N) throw std::length_error("Requested size exceeds static_vector capacity");
+
+			for (; _size < size; _size++)
+				std::construct_at(&_data[_size], default_value);
+		}
+
+		// Copy and move operations as well as the destructor are trivial whenever they are trivial for T,
+		// which makes static_vector trivially copyable if T is
+
+		// Copy constructor
+		constexpr static_vector(const static_vector& vec) requires std::is_trivially_copy_constructible_v<T> = default;
+		constexpr static_vector(const static_vector& vec)
+		{
+			for (; _size < vec._size; _size++)
+				std::construct_at(&_data[_size], vec._data[_size]);
+		}
+
+		// Move constructor
+		constexpr static_vector(static_vector&& vec) noexcept requires std::is_trivially_move_constructible_v<T> = default;
+		constexpr static_vector(static_vector&& vec) noexcept(std::is_nothrow_move_constructible_v<T>)
+		{
+			for (; _size < vec._size; _size++)
+				std::construct_at(&_data[_size], std::move(vec._data[_size]));
+		}
+
+		constexpr ~static_vector() requires std::is_trivially_destructible_v<T> = default;
+		constexpr ~static_vector() { clear(); }
+
+		// Copy assignment operator
+		constexpr static_vector& operator=(const static_vector& vec) requires std::is_trivially_copy_assignable_v<T> && std::is_trivially_copy_constructible_v<T> && std::is_trivially_destructible_v<T> = default;
+		constexpr static_vector& operator=(const static_vector& vec)
+		{
+			if (this == &vec)
+			{
+				return *this;
+			}
+
+			clear();
+			for (; _size < vec._size; _size++)
+				std::construct_at(&_data[_size], vec._data[_size]);
+
+			return *this;
+		}
+
+		// Move assignment operator
+		constexpr static_vector& operator=(static_vector&& vec) noexcept requires std::is_trivially_move_assignable_v<T> && std::is_trivially_move_constructible_v<T> && std::is_trivially_destructible_v<T> = default;
+		constexpr static_vector& operator=(static_vector&& vec) noexcept(std::is_nothrow_move_constructible_v<T>)
+		{
+			if (this == &vec)
+			{
+				return *this;
+			}
+
+			clear();
+			for (; _size < vec._size; _size++)
+				std::construct_at(&_data[_size], std::move(vec._data[_size]));
+
+			return *this;
+		}
+
+
+		constexpr size_t size() const { return _size; }
+		static constexpr size_t capacity() { return N; }
+		constexpr bool empty() const { return _size == 0; }
+		constexpr bool full() const { return _size == N; }
+
+		constexpr const T& at(size_t idx) const
+		{
+			if (idx >= _size) throw std::range_error("Provided index is out of bounds");
+			return _data[idx];
+		}
+
+		constexpr T& at(size_t idx)
+		{
+			if (idx >= _size) throw std::range_error("Provided index is out of bounds");
+			return _data[idx];
+		}
+
+		constexpr T* data() { return _data; }
+		constexpr const T* data() const { return _data; }
+
+		constexpr iterator begin() { return _data; }
+		constexpr iterator end() { return _data + _size; }
+		constexpr const_iterator begin() const { return _data; }
+		constexpr const_iterator end() const { return _data + _size; }
+
+		constexpr void resize(size_t new_size)
+		{
+			if (new_size > N) throw std::length_error("Requested size exceeds static_vector capacity");
+
+			if (new_size < _size)  // Delete excess elements
+			{
+				destroy(new_size, _size);
+				_size = new_size;
+				return;
+			}
+
+			for (; _size < new_size; _size++)
+				std::construct_at(&_data[_size]);
+		}
+
+		constexpr void pop_back()
+		{
+			destroy(_size - 1, _size);
+			_size--;
+		}
+
+		constexpr void push_back(T value)
+		{
+			emplace_back(std::move(value));
+		}
+
+		template <typename... Args>
+		constexpr void emplace_back(Args&&... args)
+		{
+			if (_size == N) throw std::length_error("static_vector is full");
+
+			std::construct_at(&_data[_size], std::forward<Args>(args)...);
+			_size++;
+		}
+
+		constexpr void clear()
+		{
+			destroy(0, _size);
+			_size = 0;
+		}
+
+		// Unchecked access (use at() for bounds checking)
+		constexpr const T& operator[](size_t idx) const { return _data[idx]; }
+		constexpr T& operator[](size_t idx) { return _data[idx]; }
+
+		friend std::ostream& operator<<(std::ostream& out, const static_vector& vec)
+		{
+			if (vec._size > 0)
+			{
+				out << "[" << vec[0];
+				for (size_t i = 1; i < vec._size; i++)
+				{
+					out << ", " << vec[i];
+				}
+				out << "]";
+			}
+			else
+			{
+				out << "[]";
+			}
+
+			return out;
+		}
+
+		void print_info() const
+		{
+			std::cout << "size=" << _size << "; capacity=" << N << "; data=" << *this;
+		}
+
+	  private:
+		/* Calls destructors of elements in the range [from, to). */
+		constexpr void destroy(size_t from, size_t to)
+		{
+			for (size_t i = from; i < to; i++)
+				std::destroy_at(&_data[i]);
+		}
+
+		// Wrapping the array in a union keeps its elements unconstructed until they are added
+		union
+		{
+			T _data[N];
+		};
+		size_t _size = 0;
+	};
+}
+
+
+int static_vector_demo()
+{
+	namespace cpp = cpplab;
+
+	cpp::static_vector<int, 4> vec0 = { 1, 2 };
+	vec0.push_back(3);
+	vec0.emplace_back(4);
+	std::cout << "vec0: "; vec0.print_info(); std::cout << "\n";
+
+	try
+	{
+		vec0.push_back(5);
+	}
+	catch (const std::length_error& e)
+	{
+		std::cout << "vec0.push_back(5): " << e.what() << "\n";
+	}
+
+	auto vec1 = vec0;  // Plain copy of the bytes, int is trivially copyable
+	vec1.pop_back();
+	std::cout << "vec1: "; vec1.print_info(); std::cout << "\n";
+	static_assert(std::is_trivially_copyable_v<decltype(vec1)>);
+
+	// static_vector can also be used inside constant expressions
+	constexpr int sum = []()
+		{
+			cpp::static_vector<int, 8> vec = { 1, 2, 3 };
+			vec.push_back(4);
+			vec.pop_back();
+			vec.resize(5);  // New elements are value-initialized
+
+			int result = 0;
+			for (size_t i = 0; i < vec.size(); i++)
+				result += vec[i];
+			return result;
+		}();
+	std::cout << "Sum computed at compile time: " << sum << "\n";
+
+
+	return 0;
+}
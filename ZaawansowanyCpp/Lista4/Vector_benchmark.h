@@ -0,0 +1,189 @@
+// Micro-benchmarks of cpplab::vector growth
+
+#pragma once
+
+#include <iostream>
+#include <utility>
+
+#include "Zadanie4_2.h"
+#include "Small_vector.h"
+#include "../Common/Bench_timer.h"
+
+
+namespace cpplab::bench
+{
+	/* Builds, fills and destroys many vectors with the given number of elements. Returns a checksum so nothing is optimized away. */
+	template <typename Vector>
+	long long build_many(size_t count, size_t elements)
+	{
+		long long checksum = 0;
+
+		for (size_t i = 0; i < count; i++)
+		{
+			Vector vec;
+			for (size_t j = 0; j < elements; j++)
+				vec.emplace_back(static_cast<int>(i + j));
+
+			checksum += vec[elements - 1];
+		}
+
+		return checksum;
+	}
+
+	// Growth step the way cpplab::vector did it before it switched to raw storage:
+	// new T[] default-constructs the whole capacity and then the old elements are assigned over it
+	template <typename T>
+	struct legacy_buffer
+	{
+		T* data = nullptr;
+		size_t size = 0;
+		size_t capacity = 0;
+
+		~legacy_buffer() { delete[] data; }
+
+		void resize(size_t new_size)
+		{
+			reserve(new_size);
+			size = new_size;
+		}
+
+		void reserve(size_t new_capacity)
+		{
+			T* tmp = new T[new_capacity];
+
+			for (size_t i = 0; i < size; i++)
+				tmp[i] = std::move(data[i]);
+
+			delete[] data;
+			data = tmp;
+			capacity = new_capacity;
+		}
+	};
+}
+
+
+int vector_growth_bench()
+{
+	namespace bench = cpplab::bench;
+
+	std::cout << "Cost of one growth step (reserve(2 * size)) of a full vector<Pixel>\n";
+	std::cout << "size\t\tnew T[] [ns]\traw storage [ns]\tspeedup\n";
+
+	for (size_t size = 1 << 10; size <= (1 << 22); size <<= 2)
+	{
+		double legacy = 0;
+		double raw = 0;
+
+		// Only the reserve() call is timed, filling the vector is done outside of the measured region
+		for (int r = 0; r < 5; r++)
+		{
+			bench::legacy_buffer<Pixel> old_vec;
+			old_vec.resize(size);
+			double t0 = bench::min_time_ns([&]() { old_vec.reserve(2 * size); }, 1);
+
+			cpplab::vector<Pixel> new_vec;
+			new_vec.resize(size);
+			double t1 = bench::min_time_ns([&]() { new_vec.reserve(2 * size); }, 1);
+
+			legacy = (r == 0 || t0 < legacy) ? t0 : legacy;
+			raw = (r == 0 || t1 < raw) ? t1 : raw;
+		}
+
+		std::cout << size << "\t\t" << legacy << "\t" << raw << "\t\t" << legacy / raw << "x\n";
+	}
+
+
+	return 0;
+}
+
+int small_vector_bench()
+{
+	namespace bench = cpplab::bench;
+
+	constexpr size_t count = 100'000;
+	long long checksum = 0;
+
+	std::cout << "Building " << count << " short-lived vectors<int> of the given size\n";
+	std::cout << "size\tvector [ns/vec]\tsmall_vector<int, 16> [ns/vec]\tspeedup\n";
+
+	for (size_t elements : { 1, 2, 4, 8, 12, 16, 24 })
+	{
+		double heap = bench::min_time_ns([&]() { checksum += bench::build_many<cpplab::vector<int>>(count, elements); });
+		double small = bench::min_time_ns([&]() { checksum += bench::build_many<cpplab::small_vector<int, 16>>(count, elements); });
+
+		std::cout << elements << "\t" << heap / count << "\t\t" << small / count << "\t\t\t\t" << heap / small << "x\n";
+	}
+
+	std::cout << "(checksum " << checksum << ")\n";
+
+
+	return 0;
+}
+
+int vector_bulk_bench()
+{
+	namespace bench = cpplab::bench;
+
+	const size_t count = 1 << 20;
+	std::vector<int> source(count);
+	for (size_t i = 0; i < count; i++)
+		source[i] = static_cast<int>(i);
+
+	long long checksum = 0;
+
+	double one_by_one = bench::min_time_ns([&]()
+	{
+		cpplab::vector<int> vec;
+		for (int value : source)
+			vec.push_back(value);
+		checksum += vec.back();
+	});
+	double ranged = bench::min_time_ns([&]()
+	{
+		cpplab::vector<int> vec;
+		vec.append_range(source);
+		checksum += vec.back();
+	});
+	std::cout << "Appending " << count << " ints: push_back " << one_by_one / 1e6 << " ms, append_range " << ranged / 1e6
+		<< " ms (" << one_by_one / ranged << "x)\n";
+
+	const size_t front = 1000;
+	double single_inserts = bench::min_time_ns([&]()
+	{
+		cpplab::vector<int> vec;
+		vec.append_range(source);
+		for (size_t i = 0; i < front; i++)
+			vec.insert(vec.cbegin(), source[i]);
+		checksum += vec[0];
+	});
+	double range_insert = bench::min_time_ns([&]()
+	{
+		cpplab::vector<int> vec;
+		vec.append_range(source);
+		vec.insert(vec.cbegin(), source.begin(), source.begin() + front);
+		checksum += vec[0];
+	});
+	std::cout << "Inserting " << front << " ints at the front of " << count << ": one by one " << single_inserts / 1e6
+		<< " ms, one range " << range_insert / 1e6 << " ms (" << single_inserts / range_insert << "x)\n";
+
+	cpplab::vector<int> small(1000, 7);
+	cpplab::vector<int> target(1000, 1);
+	const int* before = target.data();
+	const size_t copies = 100'000;
+	double assignments = bench::min_time_ns([&]()
+	{
+		for (size_t i = 0; i < copies; i++)
+		{
+			small[0] = static_cast<int>(i);
+			target = small;
+		}
+		checksum += target[0];
+	});
+	std::cout << "Copy assignment of 1000 ints: " << assignments / copies << " ns each, memory "
+		<< (target.data() == before ? "reused" : "reallocated") << "\n";
+
+	std::cout << "(checksum " << checksum << ")\n";
+
+
+	return 0;
+}
@@ -1,57 +1,139 @@
 #pragma once
 
 #include <iostream>
+#include <algorithm>
+#include <functional>
 #include <vector>
 #include <type_traits>
+#include <memory>
+#include <memory_resource>
+#include <cstring>
+#include <iterator>
+#include <ranges>
 
 
 namespace cpplab {
 
+	// A type is trivially relocatable if moving an object to a new address and destroying the original
+	// is equivalent to copying its bytes. Trivially copyable types are, other types can opt in by specializing this trait
+	// (but only if they don't keep pointers into themselves, e.g. std::string with the small string optimization in libstdc++).
 	template <typename T>
+	struct is_trivially_relocatable : std::is_trivially_copyable<T> {};
+
+	template <typename T, typename Deleter>
+	struct is_trivially_relocatable<std::unique_ptr<T, Deleter>> : is_trivially_relocatable<Deleter> {};
+
+	template <typename T>
+	struct is_trivially_relocatable<std::shared_ptr<T>> : std::true_type {};
+
+	template <typename T>
+	inline constexpr bool is_trivially_relocatable_v = is_trivially_relocatable<T>::value;
+
+	// Iterator over elements stored contiguously in memory. It is a thin wrapper around a pointer,
+	// so it compiles down to pointer arithmetic, but unlike a raw pointer it cannot be confused with an index.
+	template <typename T>
+	class contiguous_iterator
+	{
+	public:
+		using iterator_concept = std::contiguous_iterator_tag;
+		using iterator_category = std::random_access_iterator_tag;
+		using value_type = std::remove_cv_t<T>;
+		using element_type = T;
+		using difference_type = std::ptrdiff_t;
+		using pointer = T*;
+		using reference = T&;
+
+		contiguous_iterator() = default;
+		explicit contiguous_iterator(T* ptr) : _ptr(ptr) {}
+
+		// Allows converting an iterator into a const_iterator
+		template <typename U> requires std::is_convertible_v<U*, T*>
+		contiguous_iterator(const contiguous_iterator<U>& it) : _ptr(it.operator->()) {}
+
+		T& operator*() const { return *_ptr; }
+		T* operator->() const { return _ptr; }
+		T& operator[](difference_type n) const { return _ptr[n]; }
+
+		contiguous_iterator& operator++() { ++_ptr; return *this; }
+		contiguous_iterator operator++(int) { return contiguous_iterator(_ptr++); }
+		contiguous_iterator& operator--() { --_ptr; return *this; }
+		contiguous_iterator operator--(int) { return contiguous_iterator(_ptr--); }
+
+		contiguous_iterator& operator+=(difference_type n) { _ptr += n; return *this; }
+		contiguous_iterator& operator-=(difference_type n) { _ptr -= n; return *this; }
+
+		friend contiguous_iterator operator+(contiguous_iterator it, difference_type n) { return it += n; }
+		friend contiguous_iterator operator+(difference_type n, contiguous_iterator it) { return it += n; }
+		friend contiguous_iterator operator-(contiguous_iterator it, difference_type n) { return it -= n; }
+		friend difference_type operator-(const contiguous_iterator& a, const contiguous_iterator& b) { return a._ptr - b._ptr; }
+
+		friend bool operator==(const contiguous_iterator& a, const contiguous_iterator& b) = default;
+		friend auto operator<=>(const contiguous_iterator& a, const contiguous_iterator& b) = default;
+
+	private:
+		T* _ptr = nullptr;
+	};
+
+	template <typename T, typename Allocator = std::allocator<T>>
 	class vector
 	{
+		using alloc_traits = std::allocator_traits<Allocator>;
+
 	public:
+		using value_type = T;
+		using allocator_type = Allocator;
+		using size_type = size_t;
+		using difference_type = std::ptrdiff_t;
+		using reference = T&;
+		using const_reference = const T&;
+		using pointer = T*;
+		using const_pointer = const T*;
+
+		using iterator = contiguous_iterator<T>;
+		using const_iterator = contiguous_iterator<const T>;
+		using reverse_iterator = std::reverse_iterator<iterator>;
+		using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
 		// Default constructor
 		vector() {}
 
+		explicit vector(const Allocator& alloc) : _alloc(alloc) {}
+
 		// Initializer list constructor
-		vector(std::initializer_list<T> list)
-			: _size(list.size()), _capacity(list.size())
+		vector(std::initializer_list<T> list, const Allocator& alloc = Allocator())
+			: _alloc(alloc)
 		{
-			_data = new T[_capacity];
+			// The destructor does not run when a constructor throws, construct_in cleans up instead
+			T* tmp = allocate(list.size());
+			const T* elem = list.begin();
+			construct_in(tmp, list.size(), 0, list.size(), [&](T* p) { alloc_traits::construct(_alloc, p, *elem++); });
 
-			size_t idx = 0;
-			for (const T& elem : list)
-			{
-				_data[idx++] = elem;
-			}
+			_data = tmp;
+			_size = list.size();
+			_capacity = list.size();
 		}
 
-		vector(size_t size, T default_value)
-			: _size(size), _capacity(size)
+		vector(size_t size, T default_value, const Allocator& alloc = Allocator())
+			: _alloc(alloc)
 		{
-			_data = new T[_capacity];
+			T* tmp = allocate(size);
+			construct_in(tmp, size, 0, size, [&](T* p) { alloc_traits::construct(_alloc, p, default_value); });
 
-			for (size_t i = 0; i < _size; i++)
-			{
-				_data[i] = default_value;
-			}
+			_data = tmp;
+			_size = size;
+			_capacity = size;
 		}
 
 		// Copy constructor
-		vector(const vector<T>& vec)
-			: _size(vec._size), _capacity(vec._capacity)
+		vector(const vector& vec)
+			: _alloc(alloc_traits::select_on_container_copy_construction(vec._alloc))
 		{
-			_data = new T[_capacity];
-
-			for (size_t i = 0; i < _size; i++)
-			{
-				_data[i] = vec[i];
-			}
+			copy_from(vec);
 		}
 
 		// Move constructor
-		vector(vector<T>&& vec) noexcept
+		vector(vector&& vec) noexcept
+			: _alloc(std::move(vec._alloc))
 		{
 			_size = vec._size;
 			_capacity = vec._capacity;
@@ -64,160 +146,429 @@ namespace cpplab {
 
 		~vector() 
 		{
-			// Manually call the destructor for each element, because delete[] won't destruct objects created via placement new operator
-			for (size_t i = 0; i < _size; i++)
-				_data[i].~T();
+			// Manually call the destructor for each element, the allocator only hands out raw memory
+			destroy(0, _size);
 
-			// Delete the block of raw memory
-			delete[] _data;
+			// Give the block of raw memory back to the allocator
+			deallocate(_data, _capacity);
 		}
 
 
-		using value_type = T;
-
 		size_t size() const { return _size; }
 		size_t capacity() const { return _capacity; }
 		bool empty() const { return _size == 0; }
+		allocator_type get_allocator() const { return _alloc; }
 
-		T at(size_t idx) const
+		const T& at(size_t idx) const
 		{
-			if (idx < 0 || idx >= _size) throw std::range_error("Provided index is out of bounds");
+			if (idx >= _size) throw std::range_error("Provided index is out of bounds");
 			return _data[idx];
 		}
 
 		T& at(size_t idx)
 		{
-			if (idx < 0 || idx >= _size) throw std::range_error("Provided index is out of bounds");
+			if (idx >= _size) throw std::range_error("Provided index is out of bounds");
 			return _data[idx];
 		}
 
+		// With an allocator that guarantees a larger alignment (e.g. cpplab::aligned_allocator) the compiler is told about it,
+		// so loops over data() can use aligned loads without checking the address first
+		T* data() { return std::assume_aligned<storage_alignment>(_data); }
+		const T* data() const { return std::assume_aligned<storage_alignment>(_data); }
+
+		T& front() { return _data[0]; }
+		const T& front() const { return _data[0]; }
+		T& back() { return _data[_size - 1]; }
+		const T& back() const { return _data[_size - 1]; }
+
+		iterator begin() { return iterator(_data); }
+		iterator end() { return iterator(_data + _size); }
+		const_iterator begin() const { return const_iterator(_data); }
+		const_iterator end() const { return const_iterator(_data + _size); }
+		const_iterator cbegin() const { return begin(); }
+		const_iterator cend() const { return end(); }
+
+		reverse_iterator rbegin() { return reverse_iterator(end()); }
+		reverse_iterator rend() { return reverse_iterator(begin()); }
+		const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+		const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
+
 		void resize(size_t new_size)
 		{
 			if (new_size < _size)  // Delete excess elements
 			{
-				for (size_t i = new_size; i < _size; i++)
-					_data[i].~T();
+				destroy(new_size, _size);
+				_size = new_size;
+				return;
 			}
-			else if (new_size <= _capacity)  // Construct new elements using default constructor
+
+			if (new_size > _capacity)  // Reserve more memory
+				reserve(new_size);
+
+			// Construct new elements using default constructor
+			for (; _size < new_size; _size++)
+				construct(_size);
+		}
+
+		/* Appends copies of value. Grows with a single allocation, the copies are made before the old elements move. */
+		void resize(size_t new_size, const T& value)
+		{
+			if (new_size <= _size)
 			{
-				for (size_t i = _size; i < new_size; i++)
-					new (&_data[i]) T();
+				destroy(new_size, _size);
+				_size = new_size;
+				return;
 			}
-			else  // Reserve more memory and construct new elements using default constructor
+
+			if (new_size > _capacity)
 			{
-				reserve(new_size);
-				for (size_t i = _size; i < new_size; i++)
-					new (&_data[i]) T();
+				T* tmp = allocate(new_size);
+				construct_in(tmp, new_size, _size, new_size - _size, [&](T* p) { alloc_traits::construct(_alloc, p, value); });
+
+				relocate(_data, _size, tmp);
+				deallocate(_data, _capacity);
+
+				_data = tmp;
+				_capacity = new_size;
+				_size = new_size;
+				return;
 			}
 
-			_size = new_size;
+			for (; _size < new_size; _size++)
+				construct(_size, value);
 		}
 
 		void reserve(size_t new_capacity)
 		{
 			if (new_capacity < _capacity) throw std::invalid_argument("Cannot reserve a smaller amount than already reserved");
+			if (new_capacity == _capacity) return;
 
-			T* tmp = new T[new_capacity];
+			T* tmp = allocate(new_capacity);
 
-			// Move the data to the new memory using placement new and delete old memory
-			for (size_t i = 0; i < _size; i++)
-			{
-				new (&tmp[i]) T(std::move(_data[i]));  // Moving data to the exact memory location
-				_data[i].~T();
-			}
+			// Move the data to the new memory and give the old memory back to the allocator
+			relocate(_data, _size, tmp);
+			deallocate(_data, _capacity);
 
 			_capacity = new_capacity;
-
-			delete[] _data;  //  Freeing the memory block allocated with new[]
 			_data = tmp;
 		}
 
 		void pop_back()
 		{
-			resize(_size - 1);
+			destroy(_size - 1, _size);
+			_size--;
 		}
 
-		void push_back(T value)
+		/* Inserts the value before the element with the given index (idx == size() appends). */
+		void insert(size_t idx, T value)
 		{
+			if (idx > _size) throw std::range_error("Provided index is out of bounds");
+
 			if (_size == _capacity)
 			{
-				if (empty())
+				// Build the new layout directly in the new memory, so no element is moved twice
+				size_t new_capacity = _capacity == 0 ? 1 : 2 * _size;
+				T* tmp = allocate(new_capacity);
+
+				try
 				{
-					resize(1);
-					_data[0] = value;
+					alloc_traits::construct(_alloc, tmp + idx, std::move(value));
 				}
-				else
+				catch (...)
+				{
+					deallocate(tmp, new_capacity);
+					throw;
+				}
+
+				relocate(_data, idx, tmp);
+				relocate(_data + idx, _size - idx, tmp + idx + 1);
+				deallocate(_data, _capacity);
+
+				_data = tmp;
+				_capacity = new_capacity;
+			}
+			else if constexpr (is_trivially_relocatable_v<T>)
+			{
+				// Shift the tail with a single memmove, the slot at idx is then treated as raw memory
+				std::memmove(static_cast<void*>(_data + idx + 1), static_cast<const void*>(_data + idx), (_size - idx) * sizeof(T));
+
+				try
+				{
+					construct(idx, std::move(value));
+				}
+				catch (...)
 				{
-					reserve(2 * _size);
-					_data[_size++] = value;
+					std::memmove(static_cast<void*>(_data + idx), static_cast<const void*>(_data + idx + 1), (_size - idx) * sizeof(T));
+					throw;
 				}
 			}
+			else if (idx == _size)
+			{
+				construct(_size, std::move(value));
+			}
+			else
+			{
+				// Move the last element into the raw slot past the end, then shift the rest by assignment
+				construct(_size, std::move(_data[_size - 1]));
+				for (size_t i = _size - 1; i > idx; i--)
+					_data[i] = std::move(_data[i - 1]);
+				_data[idx] = std::move(value);
+			}
+
+			_size++;
+		}
+
+		iterator insert(const_iterator pos, T value)
+		{
+			size_t idx = pos - cbegin();
+			insert(idx, std::move(value));
+			return begin() + idx;
+		}
+
+		/* Removes the element with the given index, the elements after it are shifted to the left. */
+		void erase(size_t idx)
+		{
+			if (idx >= _size) throw std::range_error("Provided index is out of bounds");
+
+			if constexpr (is_trivially_relocatable_v<T>)
+			{
+				destroy(idx, idx + 1);
+				std::memmove(static_cast<void*>(_data + idx), static_cast<const void*>(_data + idx + 1), (_size - idx - 1) * sizeof(T));
+			}
+			else
+			{
+				for (size_t i = idx; i + 1 < _size; i++)
+					_data[i] = std::move(_data[i + 1]);
+				destroy(_size - 1, _size);
+			}
+
+			_size--;
+		}
+
+		iterator erase(const_iterator pos)
+		{
+			size_t idx = pos - cbegin();
+			erase(idx);
+			return begin() + idx;
+		}
+
+		/// <summary>
+		/// Inserts copies of [first, last) before pos, returns the iterator to the first inserted element. The number of new
+		/// elements is known before anything moves, so the vector allocates at most once and shifts its tail only once.
+		/// </summary>
+		template <std::input_iterator It, std::sentinel_for<It> S>
+		iterator insert(const_iterator pos, It first, S last)
+		{
+			size_t idx = pos - cbegin();
+			if (idx > _size) throw std::range_error("Provided index is out of bounds");
+
+			if constexpr (std::forward_iterator<It>)
+			{
+				insert_n(idx, first, static_cast<size_t>(std::ranges::distance(first, last)));
+			}
+			else
+			{
+				// A single-pass input can only be counted by reading it
+				vector tmp(_alloc);
+				for (; first != last; ++first)
+					tmp.emplace_back(*first);
+				insert_n(idx, std::make_move_iterator(tmp.begin()), tmp.size());
+			}
+
+			return begin() + idx;
+		}
+
+		/* Appends the elements of a range, with at most one allocation when its size can be known up front. */
+		template <std::ranges::input_range R>
+		void append_range(R&& range)
+		{
+			if constexpr (std::ranges::forward_range<R>)
+			{
+				insert_n(_size, std::ranges::begin(range), static_cast<size_t>(std::ranges::distance(range)));
+			}
+			else
+			{
+				if constexpr (std::ranges::sized_range<R>)
+					if (_size + std::ranges::size(range) > _capacity)
+						reserve(_size + std::ranges::size(range));
+
+				for (auto&& elem : range)
+					emplace_back(std::forward<decltype(elem)>(elem));
+			}
+		}
+
+		/* Replaces the contents with [first, last). Existing elements are assigned over and the memory is reused if it fits. */
+		template <std::input_iterator It, std::sentinel_for<It> S>
+		void assign(It first, S last)
+		{
+			if constexpr (std::forward_iterator<It>)
+			{
+				const size_t n = static_cast<size_t>(std::ranges::distance(first, last));
+
+				if (n > _capacity)
+				{
+					T* tmp = allocate(n);
+					construct_in(tmp, n, 0, n, [&](T* p) { alloc_traits::construct(_alloc, p, *first); ++first; });
+
+					clear_and_deallocate();
+					_data = tmp;
+					_capacity = n;
+					_size = n;
+					return;
+				}
+
+				const size_t common = std::min(n, _size);
+				for (size_t i = 0; i < common; i++, ++first)
+					_data[i] = *first;
+
+				if (n < _size)
+					destroy(n, _size);
+				for (; _size < n; _size++, ++first)
+					construct(_size, *first);
+				_size = n;
+			}
+			else
+			{
+				destroy(0, _size);
+				_size = 0;
+				for (; first != last; ++first)
+					emplace_back(*first);
+			}
+		}
+
+		/* Removes the elements [first, last), the tail is shifted to the left once. */
+		iterator erase(const_iterator first, const_iterator last)
+		{
+			size_t from = first - cbegin();
+			size_t to = last - cbegin();
+			if (from > to || to > _size) throw std::range_error("Provided index is out of bounds");
+
+			const size_t n = to - from;
+			if (n == 0)
+				return begin() + from;
+
+			if constexpr (is_trivially_relocatable_v<T>)
+			{
+				destroy(from, to);
+				std::memmove(static_cast<void*>(_data + from), static_cast<const void*>(_data + to), (_size - to) * sizeof(T));
+			}
 			else
 			{
-				_data[_size++] = value;
+				std::move(_data + to, _data + _size, _data + from);
+				destroy(_size - n, _size);
 			}
+
+			_size -= n;
+			return begin() + from;
+		}
+
+		void push_back(T value)
+		{
+			emplace_back(std::move(value));
 		}
 
 		template <typename... Args>
 		void emplace_back(Args&&... args)
 		{
-			// Allocate new memory if vector is out of space
 			if (_capacity == _size)
-				reserve(_capacity == 0 ? 1 : 2 * _size);
+			{
+				// Allocate new memory if vector is out of space. The new element is constructed before the old ones
+				// are moved, so the arguments may safely refer to elements of this vector.
+				size_t new_capacity = _capacity == 0 ? 1 : 2 * _size;
+				T* tmp = allocate(new_capacity);
+
+				try
+				{
+					alloc_traits::construct(_alloc, tmp + _size, std::forward<Args>(args)...);
+				}
+				catch (...)
+				{
+					deallocate(tmp, new_capacity);
+					throw;
+				}
 
-			// Construct new object in a specified location by forwarding arguments from parameter pack
-			new (&_data[_size]) T(std::forward<Args>(args)...);
+				relocate(_data, _size, tmp);
+				deallocate(_data, _capacity);
+
+				_data = tmp;
+				_capacity = new_capacity;
+			}
+			else
+			{
+				// Construct new object in a specified location by forwarding arguments from parameter pack
+				construct(_size, std::forward<Args>(args)...);
+			}
 
 			_size++;
 		}
 
-		T operator[](size_t idx) const { return this->at(idx); }
-		T& operator[](size_t idx) { return this->at(idx); }
+		// Unchecked access (use at() for bounds checking), compiles down to a plain pointer dereference
+		const T& operator[](size_t idx) const { return _data[idx]; }
+		T& operator[](size_t idx) { return _data[idx]; }
 
 		// Copy assignment operator
-		vector& operator=(const vector<T>& vec)
+		vector& operator=(const vector& vec)
 		{
 			if (this == &vec)
 			{
 				return *this;
 			}
 
-			_size = vec._size;
-			_capacity = vec._capacity;
-
-			delete[] _data;
-			_data = new T[_capacity];
-
-			for (size_t i = 0; i < _size; i++)
+			if constexpr (alloc_traits::propagate_on_container_copy_assignment::value)
 			{
-				_data[i] = vec[i];
+				// Memory from the old allocator has to go back to it before the new one is taken over
+				if (_alloc != vec._alloc)
+					clear_and_deallocate();
+
+				_alloc = vec._alloc;
 			}
 
+			// Reuses the memory (and assigns over the existing elements) when the copy fits
+			assign(vec._data, vec._data + vec._size);
+
 			return *this;
 		}
 
 		// Move assignment operator
-		vector& operator=(vector<T>&& vec) noexcept
+		vector& operator=(vector&& vec) noexcept(alloc_traits::propagate_on_container_move_assignment::value || alloc_traits::is_always_equal::value)
 		{
 			if (this == &vec)
 			{
 				return *this;
 			}
 
-			_size = vec._size;
-			_capacity = vec._capacity;
+			if (alloc_traits::propagate_on_container_move_assignment::value || _alloc == vec._alloc)
+			{
+				clear_and_deallocate();
 
-			delete[] _data;
-			_data = vec._data;
+				if constexpr (alloc_traits::propagate_on_container_move_assignment::value)
+					_alloc = std::move(vec._alloc);
 
-			vec._size = 0;
-			vec._capacity = 0;
-			vec._data = nullptr;
+				_size = vec._size;
+				_capacity = vec._capacity;
+				_data = vec._data;
+
+				vec._size = 0;
+				vec._capacity = 0;
+				vec._data = nullptr;
+			}
+			else
+			{
+				// Memory owned by a different allocator cannot be adopted, so the elements are moved one by one
+				clear_and_deallocate();
+
+				_data = allocate(vec._size);
+				_capacity = vec._size;
+				for (; _size < vec._size; _size++)
+					construct(_size, std::move(vec._data[_size]));
+
+				vec.clear_and_deallocate();
+			}
 
 			return *this;
 		}
 
-		friend std::ostream& operator<<(std::ostream& out, const vector<T>& vec)
+		friend std::ostream& operator<<(std::ostream& out, const vector& vec)
 		{
 			if (vec._size > 0)
 			{
@@ -242,11 +593,211 @@ namespace cpplab {
 		}
 
 	private:
+		static constexpr size_t allocator_alignment()
+		{
+			if constexpr (requires { { Allocator::alignment } -> std::convertible_to<size_t>; })
+				return std::max<size_t>(alignof(T), Allocator::alignment);
+			else
+				return alignof(T);
+		}
+
+		static constexpr size_t storage_alignment = allocator_alignment();
+
+		T* allocate(size_t n)
+		{
+			return n == 0 ? nullptr : alloc_traits::allocate(_alloc, n);
+		}
+
+		void deallocate(T* ptr, size_t n)
+		{
+			if (ptr != nullptr)
+				alloc_traits::deallocate(_alloc, ptr, n);
+		}
+
+		template <typename... Args>
+		void construct(size_t idx, Args&&... args)
+		{
+			alloc_traits::construct(_alloc, _data + idx, std::forward<Args>(args)...);
+		}
+
+		/* Calls destructors of elements in the range [from, to). */
+		void destroy(size_t from, size_t to)
+		{
+			for (size_t i = from; i < to; i++)
+				alloc_traits::destroy(_alloc, _data + i);
+		}
+
+		/* Moves count elements from src to the raw memory at dst and destroys the originals. */
+		void relocate(T* src, size_t count, T* dst)
+		{
+			if constexpr (is_trivially_relocatable_v<T>)
+			{
+				// Objects of such types can be moved around as plain bytes
+				if (count > 0)
+					std::memcpy(static_cast<void*>(dst), static_cast<const void*>(src), count * sizeof(T));
+				return;
+			}
+
+			for (size_t i = 0; i < count; i++)
+			{
+				alloc_traits::construct(_alloc, dst + i, std::move_if_noexcept(src[i]));  // Moving data to the exact memory location
+				alloc_traits::destroy(_alloc, src + i);
+			}
+		}
+
+		/* Constructs n elements in the fresh block (of block_capacity elements) from index offset on, make(p) constructs one
+		   at p. On an exception the elements made so far are destroyed and the block is deallocated. */
+		template <typename Make>
+		void construct_in(T* block, size_t block_capacity, size_t offset, size_t n, Make make)
+		{
+			size_t built = 0;
+			try
+			{
+				for (; built < n; built++)
+					make(block + offset + built);
+			}
+			catch (...)
+			{
+				for (size_t i = 0; i < built; i++)
+					alloc_traits::destroy(_alloc, block + offset + i);
+				deallocate(block, block_capacity);
+				throw;
+			}
+		}
+
+		/* Inserts n elements read from first before the element with index idx. The input may be read twice, so It is a forward
+		   iterator or a move_iterator over one (which C++20 only calls an input iterator). */
+		template <std::input_iterator It>
+		void insert_n(size_t idx, It first, size_t n)
+		{
+			if (n == 0)
+				return;
+
+			if (_size + n > _capacity)
+			{
+				// The new elements are built in the new memory first, so the input may be elements of this vector
+				size_t new_capacity = std::max(_size + n, 2 * _capacity);
+				T* tmp = allocate(new_capacity);
+				construct_in(tmp, new_capacity, idx, n, [&](T* p) { alloc_traits::construct(_alloc, p, *first); ++first; });
+
+				relocate(_data, idx, tmp);
+				relocate(_data + idx, _size - idx, tmp + idx + n);
+				deallocate(_data, _capacity);
+
+				_data = tmp;
+				_capacity = new_capacity;
+				_size += n;
+				return;
+			}
+
+			if (overlaps(first, n))
+			{
+				// Shifting the tail would move the input, so it is copied out first
+				vector tmp(_alloc);
+				tmp.insert_n(0, first, n);
+				insert_n(idx, std::make_move_iterator(tmp.begin()), n);
+				return;
+			}
+
+			if constexpr (is_trivially_relocatable_v<T>)
+			{
+				// Shift the tail with a single memmove, the gap is then treated as raw memory
+				std::memmove(static_cast<void*>(_data + idx + n), static_cast<const void*>(_data + idx), (_size - idx) * sizeof(T));
+
+				size_t built = 0;
+				try
+				{
+					for (; built < n; built++, ++first)
+						construct(idx + built, *first);
+				}
+				catch (...)
+				{
+					destroy(idx, idx + built);
+					std::memmove(static_cast<void*>(_data + idx), static_cast<const void*>(_data + idx + n), (_size - idx) * sizeof(T));
+					throw;
+				}
+
+				_size += n;
+			}
+			else
+			{
+				// _size grows with every element constructed past the end, so an exception leaves a valid vector
+				const size_t old_size = _size;
+				const size_t after = old_size - idx;
+
+				if (after > n)
+				{
+					// The last n elements move into the raw memory past the end, the rest of the tail shifts by assignment
+					for (size_t i = old_size - n; i < old_size; i++, _size++)
+						construct(_size, std::move(_data[i]));
+					std::move_backward(_data + idx, _data + old_size - n, _data + old_size);
+					std::copy_n(first, n, _data + idx);
+				}
+				else
+				{
+					// New elements that land past the old end are constructed there, then the tail moves behind them
+					It mid = std::next(first, after);
+					for (It it = mid; _size < idx + n; ++it, _size++)
+						construct(_size, *it);
+					for (size_t i = idx; i < old_size; i++, _size++)
+						construct(_size, std::move(_data[i]));
+					std::copy(first, mid, _data + idx);
+				}
+			}
+		}
+
+		/* True if the n elements at first are elements of this vector. */
+		template <typename It>
+		bool overlaps(It first, size_t n) const
+		{
+			if constexpr (std::contiguous_iterator<It> && std::is_same_v<std::iter_value_t<It>, T>)
+			{
+				const T* p = std::to_address(first);
+				return n > 0 && std::less<const T*>()(p, _data + _size) && std::less<const T*>()(_data, p + n);
+			}
+			else
+			{
+				return false;
+			}
+		}
+
+		/* Copies elements of vec into freshly allocated memory (the vector must not own any memory). */
+		void copy_from(const vector& vec)
+		{
+			T* tmp = allocate(vec._size);
+			const T* src = vec._data;
+			construct_in(tmp, vec._size, 0, vec._size, [&](T* p) { alloc_traits::construct(_alloc, p, *src++); });
+
+			_data = tmp;
+			_size = vec._size;
+			_capacity = vec._size;
+		}
+
+		void clear_and_deallocate()
+		{
+			destroy(0, _size);
+			deallocate(_data, _capacity);
+
+			_size = 0;
+			_capacity = 0;
+			_data = nullptr;
+		}
+
+		[[no_unique_address]] Allocator _alloc = Allocator();
 		size_t _size = 0;
 		size_t _capacity = 0;
 		T* _data = nullptr;
 	};
 
+	static_assert(std::ranges::contiguous_range<vector<int>>);
+	static_assert(std::contiguous_iterator<vector<int>::iterator>);
+
+	namespace pmr {
+		// Vector which takes its memory from a std::pmr::memory_resource (e.g. cpplab::arena_resource or cpplab::pool_resource)
+		template <typename T>
+		using vector = cpplab::vector<T, std::pmr::polymorphic_allocator<T>>;
+	}
+
 	// Scalar multiplacation operator
 	template <typename V, typename U>
 	auto operator*(const V& v, const U& u)
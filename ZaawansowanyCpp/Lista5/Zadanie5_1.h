@@ -2,6 +2,7 @@
 
 #include <iostream>
 #include <memory>
+#include <vector>
 
 
 namespace cpplab
@@ -32,6 +33,8 @@ namespace cpplab
 		std::shared_ptr<Node> root;
 
 	  public:
+		using value_type = T;
+
 		bst() {}
 		bst(T value) : root(std::make_shared<Node>(value, nullptr, nullptr, nullptr)) {}
 		bst(std::initializer_list<T> inilist)
@@ -69,6 +72,30 @@ namespace cpplab
 			}
 		}
 
+		/// <summary>
+		/// Calls f with every value in pre-order (a node before its subtrees). Adding the values again in this order
+		/// rebuilds a tree of the same shape. Uses its own stack, so a degenerate tree cannot overflow the call stack.
+		/// </summary>
+		template <typename F>
+		void for_each_pre_order(F f) const
+		{
+			std::vector<Node*> pending;
+			if (root != nullptr)
+				pending.push_back(root.get());
+
+			while (!pending.empty())
+			{
+				Node* node = pending.back();
+				pending.pop_back();
+				f(node->value);
+
+				if (node->right != nullptr)
+					pending.push_back(node->right.get());
+				if (node->left != nullptr)
+					pending.push_back(node->left.get());
+			}
+		}
+
 		void print_in_order()
 		{
 			std::cout << "[";
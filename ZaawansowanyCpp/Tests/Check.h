@@ -0,0 +1,69 @@
+// Minimal checks for the test executables: a failed check is reported and counted, the run goes on
+
+#pragma once
+
+#include <iostream>
+#include <exception>
+
+
+namespace cpplab::test
+{
+	inline int& failures()
+	{
+		static int count = 0;
+		return count;
+	}
+
+	inline void check(bool passed, const char* expression, const char* file, int line)
+	{
+		if (passed)
+			return;
+
+		std::cerr << file << ":" << line << ": check failed: " << expression << "\n";
+		failures()++;
+	}
+
+	/* Runs one demo, an exception or a non-zero result counts as a failure. */
+	template <typename F>
+	void run_demo(const char* name, F demo)
+	{
+		std::cout << "--- " << name << "\n";
+		try
+		{
+			if (demo() != 0)
+			{
+				std::cerr << name << " returned an error\n";
+				failures()++;
+			}
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << name << " threw: " << e.what() << "\n";
+			failures()++;
+		}
+	}
+
+	/* Exit code of the test executable. */
+	inline int report()
+	{
+		if (failures() == 0)
+			std::cout << "All checks passed\n";
+		else
+			std::cerr << failures() << " check(s) failed\n";
+
+		return failures() == 0 ? 0 : 1;
+	}
+}
+
+#define CPPLAB_CHECK(expression) cpplab::test::check(static_cast<bool>(expression), #expression, __FILE__, __LINE__)
+
+// Checks that the statement throws an exception of the given type
+#define CPPLAB_CHECK_THROWS(statement, exception_type) \
+	do \
+	{ \
+		bool thrown = false; \
+		try { statement; } \
+		catch (const exception_type&) { thrown = true; } \
+		catch (...) {} \
+		cpplab::test::check(thrown, #statement " throws " #exception_type, __FILE__, __LINE__); \
+	} while (false)
@@ -0,0 +1,77 @@
+// Demos and behaviour checks of the Lista1 cpplab::vector and the zero-filled memory it grows with
+
+#include <iostream>
+#include <cstring>
+#include <string>
+
+#include "Check.h"
+#include "../Lista1/Zadanie1_3.h"
+#include "../Lista1/Zeroed_memory.h"
+
+
+namespace
+{
+	void zeroed_memory_checks()
+	{
+		namespace zeroed = cpplab::zeroed;
+
+		// Small blocks come from calloc, large ones are mapped, both start as zeros and keep their contents when grown
+		for (size_t bytes : { size_t(64), zeroed::map_threshold })
+		{
+			auto* p = static_cast<unsigned char*>(zeroed::allocate(bytes));
+			CPPLAB_CHECK(p[0] == 0 && p[bytes - 1] == 0);
+			p[0] = 42;
+
+			p = static_cast<unsigned char*>(zeroed::grow(p, bytes, 4 * bytes));
+			CPPLAB_CHECK(p[0] == 42 && p[bytes] == 0 && p[4 * bytes - 1] == 0);
+			zeroed::deallocate(p, 4 * bytes);
+		}
+
+		CPPLAB_CHECK(zeroed::allocate(0) == nullptr);
+	}
+
+	void lazy_vector_checks()
+	{
+		// Elements written after vector(size, 0) must be cleared when the vector shrinks and grows again
+		cpplab::vector<int> v(10, 0);
+		v[5] = 7;
+		v.resize(3);
+		v.resize(10);
+		CPPLAB_CHECK(v[5] == 0);
+
+		// The same through push_back and pop_back
+		cpplab::vector<double> w;
+		for (int i = 0; i < 100; i++)
+			w.push_back(i + 1.0);
+		w.resize(10);
+		w.resize(100);
+		CPPLAB_CHECK(w[9] == 10.0 && w[10] == 0.0 && w[99] == 0.0);
+
+		// Growing keeps the elements
+		cpplab::vector<long> big(1 << 18, 3);
+		big.reserve(1 << 20);
+		big.resize(1 << 19);
+		CPPLAB_CHECK(big.size() == (1 << 19) && big[(1 << 18) - 1] == 3 && big[1 << 18] == 0);
+
+		// Types that are not zero-fillable are constructed as before
+		cpplab::vector<std::string> s(3, "abc");
+		s.push_back("d");
+		s.resize(2);
+		s.resize(4);
+		CPPLAB_CHECK(s[1] == "abc" && s[2].empty() && s[3].empty());
+
+		CPPLAB_CHECK_THROWS(v.at(10), std::range_error);
+		CPPLAB_CHECK_THROWS(v.reserve(1), std::invalid_argument);
+	}
+}
+
+
+int main()
+{
+	zeroed_memory_checks();
+	lazy_vector_checks();
+
+	cpplab::test::run_demo("main1_3", main1_3);
+
+	return cpplab::test::report();
+}
@@ -0,0 +1,214 @@
+// Demos and behaviour checks of the Lista3 numeric cpplab::vector, its SIMD kernels and the types built on it
+
+#include <iostream>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "Check.h"
+#include "../Lista3/Zadanie3_1.h"
+#include "../Lista3/Simd_dot.h"
+#include "../Lista3/Accumulators.h"
+#include "../Lista3/Simd_quantized.h"
+#include "../Lista3/Thread_pool.h"
+#include "../Lista3/Parallel_reduce.h"
+#include "../Lista3/Vector_expressions.h"
+#include "../Lista3/Matrix.h"
+#include "../Lista3/Sparse_vector.h"
+#include "../Lista3/Quantized_vector.h"
+#include "../Lista3/Topk_search.h"
+
+
+namespace
+{
+	template <typename V>
+	bool bits_are(const V& v, std::initializer_list<bool> expected)
+	{
+		if (v.size() != expected.size())
+			return false;
+
+		size_t i = 0;
+		for (bool bit : expected)
+			if (static_cast<bool>(v[i++]) != bit)
+				return false;
+
+		return true;
+	}
+
+	/* Every instruction set the CPU has must give the scalar results, also for lengths that leave a tail. */
+	void simd_kernel_checks()
+	{
+		namespace simd = cpplab::simd;
+		const simd::level detected = simd::detect_level();
+
+		for (size_t n : { size_t(0), size_t(1), size_t(7), size_t(64), size_t(100), size_t(1027) })
+		{
+			std::vector<float> a(n), b(n);
+			std::vector<std::int32_t> ints(n);
+			std::vector<std::uint64_t> mask((n + 63) / 64 + 1, ~std::uint64_t(0));  // Bits past n are set on purpose
+			for (size_t i = 0; i < n; i++)
+			{
+				a[i] = static_cast<float>(i % 13) * 0.5f;
+				b[i] = static_cast<float>(i % 7) - 3.0f;
+				ints[i] = static_cast<std::int32_t>(i % 11) - 5;
+			}
+
+			const float dot_expected = simd::dot_scalar<float>(a.data(), b.data(), n);
+			const std::int64_t masked_expected = simd::masked_sum_scalar<std::int64_t>(mask.data(), ints.data(), n);
+
+			std::int64_t plain_sum = 0;
+			for (size_t i = 0; i < n; i++)
+				plain_sum += ints[i];
+			CPPLAB_CHECK(masked_expected == plain_sum);
+
+			for (int l = 0; l <= static_cast<int>(detected); l++)
+			{
+				simd::force_level(static_cast<simd::level>(l));
+				CPPLAB_CHECK(std::abs(simd::dot(a.data(), b.data(), n) - dot_expected) <= 1e-3f * (1 + std::abs(dot_expected)));
+				CPPLAB_CHECK((simd::masked_sum_as<std::int64_t>(mask.data(), ints.data(), n)) == masked_expected);
+			}
+			simd::force_level(detected);
+		}
+	}
+
+	void parallel_checks()
+	{
+		using cpplab::operator*;
+
+		std::vector<float> values(10'001, 0.5f);
+		std::vector<float> ones(10'001, 1.0f);
+		CPPLAB_CHECK(cpplab::parallel_dot(values, ones) == values * ones);
+
+		// Nested loops: every worker is busy with an outer call while the inner helpers wait in the queue
+		cpplab::thread_pool pool(2);
+		std::atomic<size_t> sum = 0;
+		pool.parallel_for(4, [&](size_t)
+			{
+				pool.parallel_for(8, [&](size_t j) { sum += j; });
+			});
+		CPPLAB_CHECK(sum == 4 * 28);
+
+		CPPLAB_CHECK_THROWS(pool.parallel_for(100, [](size_t i) { if (i == 42) throw std::runtime_error("failed"); }), std::runtime_error);
+	}
+
+	void conversion_checks()
+	{
+		// Containers convert only explicitly, expressions also implicitly
+		static_assert(!std::is_convertible_v<std::vector<double>, cpplab::vector<double>>);
+		static_assert(std::is_constructible_v<cpplab::vector<double>, std::vector<double>>);
+
+		cpplab::vector<double> a = { 1, 2, 3 };
+		cpplab::vector<double> b = { 1, 1, 1 };
+		cpplab::vector<double> sum = a + b;
+		cpplab::vector<double> copy(std::vector<double>{ 4, 5, 6 });
+		CPPLAB_CHECK(sum[2] == 4.0 && copy[0] == 4.0);
+
+		// An expression that reads the vector it is assigned to
+		a = a - 2.0 * b;
+		CPPLAB_CHECK(a[0] == -1.0 && a[2] == 1.0);
+	}
+
+	void accumulator_checks()
+	{
+		cpplab::vector<int> big(4, 50'000);
+		CPPLAB_CHECK(cpplab::dot<cpplab::accumulate::widen>(big, big) == std::int64_t(10'000'000'000));
+		CPPLAB_CHECK(cpplab::dot<cpplab::accumulate::saturate>(big, big) == std::numeric_limits<int>::max());
+
+		cpplab::fp16_vector h = { 1, 2, 3 };
+		cpplab::fp16_vector g = { 4, 5, 6 };
+		static_assert(std::is_same_v<decltype(cpplab::dot<cpplab::accumulate::widen>(h, g)), double>);
+		static_assert(std::is_same_v<decltype(cpplab::dot(h, g)), float>);
+		CPPLAB_CHECK(cpplab::dot(h, g) == 32.0f && cpplab::dot<cpplab::accumulate::widen>(h, g) == 32.0);
+
+		cpplab::int8_vector q = { 1, 2, 3 };
+		CPPLAB_CHECK(std::abs(cpplab::dot<cpplab::accumulate::widen>(q, q) - 14.0) < 0.1);
+	}
+
+	void matrix_checks()
+	{
+		cpplab::matrix<int> a = { { 1, 2, 3 }, { 4, 5, 6 } };
+		cpplab::vector<int> x = { 1, 1, 1 };
+		auto y = cpplab::gemv(a, x);
+		CPPLAB_CHECK(y.size() == 2 && y[0] == 6 && y[1] == 15);
+
+		auto t = a.transposed();
+		CPPLAB_CHECK(t.rows() == 3 && t(2, 1) == 6);
+		CPPLAB_CHECK_THROWS(a.at(2, 0), std::range_error);
+
+		cpplab::matrix<int> copy = a;
+		auto product = cpplab::gemm(a, t);
+		CPPLAB_CHECK(copy(1, 2) == 6 && product(0, 0) == 14 && product(1, 1) == 77);
+	}
+
+	void sparse_checks()
+	{
+		cpplab::sparse_vector<double> s(10, { { 7, 2.0 }, { 1, 0.5 }, { 4, -1.0 } });
+		std::vector<double> dense(10, 1.0);
+		CPPLAB_CHECK(s.nnz() == 3 && s.at(7) == 2.0 && s.at(0) == 0.0);
+		CPPLAB_CHECK(cpplab::dot(s, dense) == 1.5);
+
+		// Listed zeros are dropped like in the dense constructor, repeated indices are still rejected
+		cpplab::sparse_vector<double> with_zeros(10, { { 2, 0.0 }, { 5, 3.0 } });
+		CPPLAB_CHECK(with_zeros.nnz() == 1 && with_zeros.at(2) == 0.0 && with_zeros.at(5) == 3.0);
+		CPPLAB_CHECK_THROWS((cpplab::sparse_vector<double>(10, { { 2, 0.0 }, { 2, 1.0 } })), std::invalid_argument);
+	}
+
+	void bool_vector_checks()
+	{
+		using cpplab::operator*;
+
+		cpplab::vector<bool> m = { true, false, true, true };
+		cpplab::vector<bool> x = { true, true, false, true };
+		CPPLAB_CHECK(m.count() == 3 && (m & x).count() == 2 && (m | x).all());
+		CPPLAB_CHECK(m * x == 2);
+
+		// The right-hand side reads the vector it is assigned to
+		m = hadamard(m, x);
+		CPPLAB_CHECK(bits_are(m, { true, false, false, true }));
+
+		cpplab::vector<int> ints = { 5, 6, 7, 8 };
+		CPPLAB_CHECK(m * ints == 13);
+
+		// Bit-packed vectors have no data(), gemv evaluates them into a plain buffer
+		cpplab::matrix<int> a = { { 1, 2, 3, 4 }, { 5, 6, 7, 8 } };
+		auto y = cpplab::gemv(a, x);
+		CPPLAB_CHECK(y.size() == 2 && y[0] == 7 && y[1] == 19);
+	}
+
+	void search_checks()
+	{
+		cpplab::flat_index<float> index(2);
+		index.add(std::vector<float>{ 1, 0 });
+		index.add(std::vector<float>{ 0, 1 });
+		index.add(std::vector<float>{ 2, 2 });
+		auto hits = index.search(std::vector<float>{ 1, 0 }, 2);
+		CPPLAB_CHECK(hits.size() == 2 && hits[0].index == 2 && hits[1].index == 0);
+	}
+}
+
+
+int main()
+{
+	simd_kernel_checks();
+	parallel_checks();
+	conversion_checks();
+	accumulator_checks();
+	matrix_checks();
+	sparse_checks();
+	bool_vector_checks();
+	search_checks();
+
+	cpplab::test::run_demo("main3_1", main3_1);
+	cpplab::test::run_demo("vector_expressions_demo", vector_expressions_demo);
+	cpplab::test::run_demo("parallel_reduce_demo", parallel_reduce_demo);
+	cpplab::test::run_demo("matrix_demo", matrix_demo);
+	cpplab::test::run_demo("sparse_vector_demo", sparse_vector_demo);
+	cpplab::test::run_demo("quantized_vector_demo", quantized_vector_demo);
+	cpplab::test::run_demo("topk_search_demo", topk_search_demo);
+
+	return cpplab::test::report();
+}
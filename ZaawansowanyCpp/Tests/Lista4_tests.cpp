@@ -0,0 +1,449 @@
+// Demos and behaviour checks of the Lista4 allocator-aware cpplab::vector and the containers and files built around it
+
+#include <iostream>
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Check.h"
+#include "../Lista4/Zadanie4_2.h"
+#include "../Lista4/Memory_resource.h"
+#include "../Lista4/Small_vector.h"
+#include "../Lista4/Static_vector.h"
+#include "../Lista4/Soa_vector.h"
+#include "../Lista4/Image.h"
+#include "../Lista4/Mapped_file.h"
+#include "../Lista4/Pnm_io.h"
+#include "../Lista4/Mapped_vector.h"
+#include "../Lista4/Serialization.h"
+#include "../Lista4/Concurrent_vector.h"
+#include "../Lista4/Hive.h"
+#include "../Lista4/Aligned_allocator.h"
+
+
+namespace
+{
+	// Counts the live objects, copying or moving throws once the budget runs out
+	struct counted
+	{
+		static inline int live = 0;
+		static inline int copies_left = 1'000'000;
+
+		int value = 0;
+
+		counted(int value) : value(value) { live++; }
+		counted(const counted& other) : value(other.value)
+		{
+			if (copies_left-- <= 0) throw std::runtime_error("copy failed");
+			live++;
+		}
+		counted(counted&& other) : value(other.value)
+		{
+			if (copies_left-- <= 0) throw std::runtime_error("move failed");
+			live++;
+		}
+		counted& operator=(const counted&) = default;
+		~counted() { live--; }
+	};
+
+	void vector_checks()
+	{
+		// Reserved capacity holds no objects, growing moves only the live ones (counted has no default constructor)
+		{
+			cpplab::vector<counted> v;
+			v.reserve(100);
+			CPPLAB_CHECK(v.capacity() >= 100 && counted::live == 0);
+
+			for (int i = 0; i < 50; i++)
+				v.push_back(counted(i));
+			v.reserve(1000);
+			CPPLAB_CHECK(v.size() == 50 && counted::live == 50 && v[0].value == 0 && v[49].value == 49);
+		}
+		CPPLAB_CHECK(counted::live == 0);
+
+		{
+			cpplab::vector<counted> source(5, counted(1));
+
+			// Every constructor must destroy what it built when an element constructor throws
+			counted::copies_left = 2;
+			CPPLAB_CHECK_THROWS((cpplab::vector<counted>(5, counted(2))), std::runtime_error);
+			counted::copies_left = 2;
+			CPPLAB_CHECK_THROWS((cpplab::vector<counted>{ counted(1), counted(2), counted(3) }), std::runtime_error);
+			counted::copies_left = 2;
+			CPPLAB_CHECK_THROWS(cpplab::vector<counted> copy(source), std::runtime_error);
+			counted::copies_left = 1'000'000;
+
+			CPPLAB_CHECK(counted::live == 5);
+		}
+		CPPLAB_CHECK(counted::live == 0);
+
+		cpplab::vector<int> v = { 1, 2, 3 };
+		std::vector<int> more = { 7, 8, 9 };
+		v.insert(v.begin() + 1, more.begin(), more.end());
+		v.append_range(more);
+		v.erase(v.begin(), v.begin() + 2);
+		CPPLAB_CHECK(v.size() == 7 && v[0] == 8 && v[6] == 9);
+
+		v.resize(10, 42);
+		CPPLAB_CHECK(v[9] == 42 && v[6] == 9);
+	}
+
+	std::string temp_path(const char* name) { return (std::filesystem::temp_directory_path() / name).string(); }
+
+	template <typename A, typename B>
+	concept equality_comparable_with = requires (const A& a, const B& b) { a == b; };
+
+	void allocator_checks()
+	{
+		using allocator = cpplab::aligned_allocator<float, 64>;
+		using rebound = std::allocator_traits<allocator>::rebind_alloc<double>;
+		static_assert(rebound::alignment == 64, "rebinding keeps the alignment");
+		static_assert(equality_comparable_with<allocator, rebound>);
+		static_assert(!equality_comparable_with<allocator, cpplab::aligned_allocator<float, 128>>);
+		CPPLAB_CHECK(allocator() == rebound());
+
+		cpplab::aligned_vector<float> aligned;
+		aligned.resize(100);
+		CPPLAB_CHECK(reinterpret_cast<std::uintptr_t>(aligned.data()) % 64 == 0);
+	}
+
+	void small_vector_checks()
+	{
+		static_assert(std::is_nothrow_move_constructible_v<cpplab::small_vector<int, 4>>);
+		static_assert(!std::is_nothrow_move_constructible_v<cpplab::small_vector<counted, 4>>);
+
+		// A move of inline elements that throws leaves the source whole
+		{
+			cpplab::small_vector<counted, 4> source;
+			source.emplace_back(1);
+			source.emplace_back(2);
+			source.emplace_back(3);
+
+			counted::copies_left = 1;
+			CPPLAB_CHECK_THROWS((cpplab::small_vector<counted, 4>(std::move(source))), std::runtime_error);
+			counted::copies_left = 1'000'000;
+			CPPLAB_CHECK(source.size() == 3 && counted::live == 3);
+
+			cpplab::small_vector<counted, 4> moved(std::move(source));
+			CPPLAB_CHECK(source.empty() && moved.size() == 3 && moved[2].value == 3 && counted::live == 3);
+		}
+		CPPLAB_CHECK(counted::live == 0);
+
+		// Copies that throw destroy the elements built so far and free the heap memory
+		{
+			cpplab::small_vector<counted, 2> source;
+			source.emplace_back(1);
+			source.emplace_back(2);
+			source.emplace_back(3);
+
+			counted::copies_left = 2;
+			CPPLAB_CHECK_THROWS((cpplab::small_vector<counted, 2>(source)), std::runtime_error);
+			counted::copies_left = 1;
+			CPPLAB_CHECK_THROWS((cpplab::small_vector<counted, 2>{ counted(1), counted(2) }), std::runtime_error);
+			counted::copies_left = 2;
+			CPPLAB_CHECK_THROWS((cpplab::small_vector<counted, 2>(3, counted(7))), std::runtime_error);
+
+			cpplab::small_vector<counted, 2> target;
+			target.emplace_back(9);
+			counted::copies_left = 2;
+			CPPLAB_CHECK_THROWS(target = source, std::runtime_error);
+			counted::copies_left = 1'000'000;
+
+			CPPLAB_CHECK(target.empty() && target.is_inline() && counted::live == 3);
+		}
+		CPPLAB_CHECK(counted::live == 0);
+	}
+
+	void soa_vector_checks()
+	{
+		cpplab::soa_vector<Pixel> pixels = { Pixel(1, 2, 3), Pixel(4, 5, 6) };
+		pixels.emplace_back(7, 8, 9);
+		for (int& green : pixels.column<&Pixel::g>())
+			green *= 10;
+
+		Pixel last = pixels[2];
+		CPPLAB_CHECK(pixels.size() == 3 && last.r == 7 && last.g == 80 && last.b == 9);
+
+		cpplab::soa_vector<Pixel> copy = pixels;
+		copy.pop_back();
+		CPPLAB_CHECK(copy.size() == 2 && static_cast<Pixel>(copy[1]).g == 50 && pixels.size() == 3);
+
+		// Arguments that refer to the vector itself are read before it grows
+		cpplab::soa_vector<Pixel> full;
+		full.emplace_back(11, 12, 13);
+		CPPLAB_CHECK(full.size() == full.capacity());
+		const int& red = full[0].get<&Pixel::r>();
+		full.emplace_back(red, red, red);
+		Pixel second = full[1];
+		CPPLAB_CHECK(second.r == 11 && second.g == 11 && second.b == 11);
+
+		copy.clear();
+		CPPLAB_CHECK_THROWS(copy.pop_back(), std::out_of_range);
+		CPPLAB_CHECK_THROWS(copy.at(0), std::range_error);
+	}
+
+	/* Every image kernel must give the results of its scalar version at every instruction set, also for lengths that leave a tail. */
+	void image_kernel_checks()
+	{
+		namespace simd = cpplab::simd;
+		const simd::level detected = simd::detect_level();
+
+		for (size_t n : { size_t(0), size_t(1), size_t(15), size_t(16), size_t(33), size_t(100), size_t(1027) })
+		{
+			std::vector<std::uint8_t> a(4 * n), b(4 * n), c(4 * n);
+			unsigned seed = 12345;
+			for (size_t i = 0; i < a.size(); i++)
+			{
+				seed = seed * 1103515245u + 12345u;
+				a[i] = static_cast<std::uint8_t>(seed >> 16);
+				b[i] = static_cast<std::uint8_t>(seed >> 8);
+				c[i] = static_cast<std::uint8_t>(seed >> 24);
+			}
+			const std::uint8_t* rows[3] = { a.data(), b.data(), c.data() };
+			const float weights[3] = { 0.25f, 0.5f, 0.25f };
+
+			std::vector<std::uint8_t> adjusted(n), rgba_adjusted(4 * n), gray3(n), gray4(n), summed(n), rgba(4 * n);
+			std::vector<std::int32_t> widened(n);
+			simd::adjust_row_scalar(a.data(), adjusted.data(), n, 1.3f, -20.0f, false);
+			simd::adjust_row_scalar(a.data(), rgba_adjusted.data(), 4 * n, 0.7f, 15.5f, true);
+			simd::gray_row_scalar(a.data(), gray3.data(), n, 3);
+			simd::gray_row_scalar(a.data(), gray4.data(), n, 4);
+			simd::weighted_sum_scalar(rows, weights, 3, summed.data(), n);
+			simd::widen_bytes_scalar(a.data(), widened.data(), n);
+			simd::rgb_to_rgba_scalar(a.data(), rgba.data(), n);
+
+			for (int l = 0; l <= static_cast<int>(detected); l++)
+			{
+				simd::force_level(static_cast<simd::level>(l));
+
+				std::vector<std::uint8_t> bytes(4 * n);
+				std::vector<std::int32_t> ints(n);
+
+				simd::adjust_row(a.data(), bytes.data(), n, 1.3f, -20.0f, false);
+				CPPLAB_CHECK(std::equal(adjusted.begin(), adjusted.end(), bytes.begin()));
+				simd::adjust_row(a.data(), bytes.data(), 4 * n, 0.7f, 15.5f, true);
+				CPPLAB_CHECK(bytes == rgba_adjusted);
+				simd::gray_row(a.data(), bytes.data(), n, 3);
+				CPPLAB_CHECK(std::equal(gray3.begin(), gray3.end(), bytes.begin()));
+				simd::gray_row(a.data(), bytes.data(), n, 4);
+				CPPLAB_CHECK(std::equal(gray4.begin(), gray4.end(), bytes.begin()));
+				simd::weighted_sum(rows, weights, 3, bytes.data(), n);
+				CPPLAB_CHECK(std::equal(summed.begin(), summed.end(), bytes.begin()));
+				simd::widen_bytes(a.data(), ints.data(), n);
+				CPPLAB_CHECK(ints == widened);
+				simd::rgb_to_rgba(a.data(), bytes.data(), n);
+				CPPLAB_CHECK(bytes == rgba);
+			}
+			simd::force_level(detected);
+		}
+
+		// Narrowing clamps to [0, 255], also values past the 16-bit range
+		const std::int32_t wide[] = { -5, 300, 40000, 255, 0, 128, -40000, 70000, 65535, 32768, 1, 254, 256, -1, 100000, 7, 40000, -5 };
+		const std::uint8_t narrow[] = { 0, 255, 255, 255, 0, 128, 0, 255, 255, 255, 1, 254, 255, 0, 255, 7, 255, 0 };
+		for (int l = 0; l <= static_cast<int>(detected); l++)
+		{
+			simd::force_level(static_cast<simd::level>(l));
+
+			std::uint8_t bytes[std::size(wide)];
+			simd::narrow_to_bytes(wide, bytes, std::size(wide));
+			CPPLAB_CHECK(std::equal(std::begin(bytes), std::end(bytes), std::begin(narrow)));
+		}
+		simd::force_level(detected);
+	}
+
+	void file_checks()
+	{
+		const std::string path = temp_path("cpplab_tests.bin");
+
+		// A closed writer can be closed again
+		{
+			cpplab::buffered_writer out(path);
+			out.write("abc");
+			out.close();
+			out.close();
+		}
+
+		// Pixels survive a PPM round trip, channels are clamped
+		cpplab::vector<Pixel> pixels;
+		pixels.resize(5000);
+		pixels[1].g = 7;
+		pixels[4999].r = 300;
+		pixels[4998].b = 40000;
+		cpplab::write_pnm(path, pixels, 100, 50);
+		auto read = cpplab::pnm_reader(path).to_pixels();
+		CPPLAB_CHECK(read.size() == 5000 && read[1].g == 7 && read[4999].r == 255 && read[4998].b == 255);
+
+#if CPPLAB_HAS_MMAP
+		{
+			cpplab::mapped_vector<int> vec(path, cpplab::map_mode::create);
+			for (int i = 0; i < 1000; i++)
+				vec.push_back(i);
+			vec.pop_back();
+
+			// Opened while the file still has its full capacity, as after a process that never called close()
+			cpplab::mapped_vector<int> reopened(path, cpplab::map_mode::read_only);
+			CPPLAB_CHECK(reopened.size() == 999 && reopened.capacity() > 999 && reopened[998] == 998);
+
+			const auto& view = reopened;
+			static_assert(std::is_same_v<decltype(view.at(0)), const int&>);
+			CPPLAB_CHECK_THROWS(view.at(999), std::range_error);
+		}
+		CPPLAB_CHECK(std::filesystem::file_size(path) == cpplab::mapped_vector<int>::header_bytes + 999 * sizeof(int));
+		CPPLAB_CHECK_THROWS(cpplab::mapped_vector<double> opened(path), std::runtime_error);
+
+		// Popped elements come back as zeros, whether or not resize() has to grow the file
+		{
+			cpplab::mapped_vector<int> vec(path, cpplab::map_mode::create);
+			for (int i = 1; i <= 100; i++)
+				vec.push_back(i);
+			size_t capacity = vec.capacity();
+
+			for (int i = 0; i < 50; i++)
+				vec.pop_back();
+			vec.resize(80);
+			CPPLAB_CHECK(vec[49] == 50 && vec[50] == 0 && vec[79] == 0);
+
+			for (int i = 0; i < 70; i++)
+				vec.pop_back();
+			vec.resize(capacity + 10);
+			CPPLAB_CHECK(vec[9] == 10 && vec[10] == 0 && vec[99] == 0 && vec[capacity + 9] == 0);
+		}
+#endif
+
+		std::filesystem::remove(path);
+	}
+
+	void serialization_checks()
+	{
+		const std::string path = temp_path("cpplab_tests_serialized.bin");
+
+		cpplab::vector<double> values = { 1.5, 2.5, 3.5 };
+		cpplab::save(path, values);
+		auto loaded = cpplab::load<cpplab::vector<double>>(path);
+		CPPLAB_CHECK(loaded.size() == 3 && loaded[2] == 3.5);
+		CPPLAB_CHECK_THROWS(cpplab::load<cpplab::vector<float>>(path), std::runtime_error);
+
+		// A forward list keeps its order
+		cpplab::forward_list<int> flist = { 4, 8, 15, 16, 23, 42 };
+		cpplab::save(path, flist);
+		std::vector<int> saved_list, loaded_list;
+		flist.for_each([&](int value) { saved_list.push_back(value); });
+		cpplab::load<cpplab::forward_list<int>>(path).for_each([&](int value) { loaded_list.push_back(value); });
+		CPPLAB_CHECK(loaded_list == saved_list && loaded_list.size() == 6);
+
+		// A tree keeps its shape (the same pre-order)
+		cpplab::bst<int> tree = { 6, 8, 4, 7, 5, 3, 9 };
+		cpplab::save(path, tree);
+		std::vector<int> saved_tree, loaded_tree;
+		tree.for_each_pre_order([&](int value) { saved_tree.push_back(value); });
+		cpplab::load<cpplab::bst<int>>(path).for_each_pre_order([&](int value) { loaded_tree.push_back(value); });
+		CPPLAB_CHECK(loaded_tree == saved_tree && loaded_tree.size() == 7);
+
+		auto as_vector = cpplab::load<cpplab::vector<int>>(path);
+		CPPLAB_CHECK(as_vector.size() == 7 && as_vector[0] == 6);
+
+		// A damaged payload fails the checksum
+		{
+			std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+			file.seekp(64);
+			file.put(99);
+		}
+		CPPLAB_CHECK_THROWS(cpplab::load<cpplab::bst<int>>(path), std::runtime_error);
+
+		std::filesystem::remove(path);
+	}
+
+	void concurrent_vector_checks()
+	{
+		cpplab::concurrent_vector<int> c;
+		std::vector<std::thread> threads;
+		for (int t = 0; t < 4; t++)
+			threads.emplace_back([&c]() { for (int i = 0; i < 1000; i++) c.push_back(1); });
+		for (auto& thread : threads)
+			thread.join();
+		CPPLAB_CHECK(c.size() == 4000 && std::accumulate(c.begin(), c.end(), 0) == 4000);
+
+		// One batch spanning several segments
+		using sizes = cpplab::concurrent_vector<size_t>;
+		sizes batched;
+		size_t first = batched.grow_by(3 * sizes::first_segment + 5, 7);
+		CPPLAB_CHECK(first == 0 && batched.size() == 3 * sizes::first_segment + 5 && batched.capacity() >= batched.size());
+		CPPLAB_CHECK(batched[0] == 7 && batched[batched.size() - 1] == 7 && batched.grow_by(0) == batched.size());
+
+		// Batches of different lengths from several threads, every value must be there exactly once
+		const size_t per_thread = 5000;
+		sizes shared;
+		threads.clear();
+		for (size_t t = 0; t < 4; t++)
+			threads.emplace_back([&shared, t, per_thread]()
+				{
+					for (size_t i = 0, batch = 1; i < per_thread; i += batch, batch = batch % 97 + 1)
+					{
+						size_t n = std::min(batch, per_thread - i);
+						size_t idx = shared.grow_by(n);
+						for (size_t j = 0; j < n; j++)
+							shared[idx + j] = t * per_thread + i + j;
+					}
+				});
+		for (auto& thread : threads)
+			thread.join();
+
+		std::vector<int> seen(4 * per_thread, 0);
+		for (size_t value : shared)
+			seen[value]++;
+		CPPLAB_CHECK(shared.size() == 4 * per_thread && std::all_of(seen.begin(), seen.end(), [](int n) { return n == 1; }));
+	}
+
+	void container_checks()
+	{
+		cpplab::hive<int> h = { 1, 2, 3, 4, 5 };
+		const int* three = nullptr;
+		for (const int& e : h)
+			if (e == 3)
+				three = &e;
+
+		for (auto it = h.begin(); it != h.end();)
+			it = (*it % 2 == 0) ? h.erase(it) : std::next(it);
+		h.insert(10);
+		CPPLAB_CHECK(h.size() == 4 && *three == 3 && std::accumulate(h.begin(), h.end(), 0) == 19);
+
+		cpplab::static_vector<int, 2> s = { 1, 2 };
+		CPPLAB_CHECK_THROWS(s.push_back(3), std::length_error);
+	}
+}
+
+
+int main()
+{
+	vector_checks();
+	allocator_checks();
+	small_vector_checks();
+	soa_vector_checks();
+	image_kernel_checks();
+	file_checks();
+	serialization_checks();
+	concurrent_vector_checks();
+	container_checks();
+
+	cpplab::test::run_demo("main4_2", main4_2);
+	cpplab::test::run_demo("memory_resource_demo", memory_resource_demo);
+	cpplab::test::run_demo("small_vector_demo", small_vector_demo);
+	cpplab::test::run_demo("static_vector_demo", static_vector_demo);
+	cpplab::test::run_demo("soa_vector_demo", soa_vector_demo);
+	cpplab::test::run_demo("image_demo", image_demo);
+	cpplab::test::run_demo("pnm_io_demo", pnm_io_demo);
+	cpplab::test::run_demo("serialization_demo", serialization_demo);
+	cpplab::test::run_demo("concurrent_vector_demo", concurrent_vector_demo);
+	cpplab::test::run_demo("hive_demo", hive_demo);
+
+	return cpplab::test::report();
+}